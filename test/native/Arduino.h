@@ -0,0 +1,55 @@
+#pragma once
+// Host stand-in for the parts of the Arduino core used by the code under test
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include "WString.h"
+
+typedef uint8_t byte;
+
+#define PROGMEM
+#define F(s) (s)
+#define FPSTR(s) (s)
+#define IRAM_ATTR
+
+using std::max;
+using std::min;
+#define constrain(amt, low, high) \
+  ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+// esp_timer_get_time(), micros() and millis() count from the first call
+inline int64_t esp_timer_get_time() {
+  static const auto start = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+inline unsigned long micros() { return (unsigned long)esp_timer_get_time(); }
+inline unsigned long millis() { return esp_timer_get_time() / 1000; }
+inline void delay(uint32_t ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+inline void yield() { std::this_thread::yield(); }
+
+#ifndef __GLIBC_PREREQ
+#define __GLIBC_PREREQ(a, b) 0
+#endif
+#if !__GLIBC_PREREQ(2, 38)
+inline size_t strlcpy(char *dst, const char *src, size_t size) {
+  size_t len = strlen(src);
+  if (size) {
+    size_t n = len < size - 1 ? len : size - 1;
+    memcpy(dst, src, n);
+    dst[n] = '\0';
+  }
+  return len;
+}
+#endif
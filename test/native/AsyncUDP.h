@@ -0,0 +1,8 @@
+#pragma once
+// Host stand-in for AsyncUDP, no packets are ever received
+
+#include "WiFi.h"
+
+class AsyncUDPPacket {};
+
+class AsyncUDP {};
@@ -0,0 +1,89 @@
+#pragma once
+// Host stand-in for the parts of ESPAsyncWebServer and AsyncTCP the code
+// under test uses. A test fills in the arguments of a request and reads back
+// what was sent and how the TCP receive window was handled.
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <string>
+
+#include "Arduino.h"
+
+class AsyncClient {
+public:
+  size_t ack(size_t len) {
+    acked += len;
+    held = false;
+    return len;
+  }
+  void ackLater() { held = true; }
+
+  // test side, ack() may come from another task
+  std::atomic<size_t> acked{0};
+  std::atomic<bool> held{false}; // ackLater() until the next ack()
+};
+
+class AsyncWebServerResponse {
+public:
+  void addHeader(const String &name, const String &value) {
+    headers[name.c_str()] = value.c_str();
+  }
+
+  int code = 200;
+  String contentType;
+  String content;
+  std::map<std::string, std::string> headers;
+};
+
+typedef std::function<size_t(uint8_t *buffer, size_t maxLen, size_t index)>
+    AwsResponseFiller;
+
+class AsyncWebServerRequest {
+public:
+  AsyncClient *client() { return &tcp; }
+  void onDisconnect(std::function<void()> fn) { disconnected = fn; }
+
+  bool hasArg(const char *name) const { return args.count(name) > 0; }
+  String arg(const char *name) const {
+    auto it = args.find(name);
+    return it == args.end() ? String() : String(it->second);
+  }
+
+  AsyncWebServerResponse *beginResponse(int code, const String &contentType,
+                                        const String &content) {
+    auto *response = new AsyncWebServerResponse;
+    response->code = code;
+    response->contentType = contentType;
+    response->content = content;
+    return response;
+  }
+  // the whole body is produced at once
+  AsyncWebServerResponse *beginChunkedResponse(const String &contentType,
+                                               AwsResponseFiller filler) {
+    auto *response = beginResponse(200, contentType, "");
+    uint8_t buffer[1024];
+    size_t len;
+    while ((len = filler(buffer, sizeof(buffer), response->content.length())))
+      response->content += std::string((char *)buffer, len);
+    return response;
+  }
+  void send(AsyncWebServerResponse *response) {
+    sent = *response;
+    sentCount++;
+    delete response;
+  }
+  void send(int code, const String &contentType = "",
+            const String &content = "") {
+    send(beginResponse(code, contentType, content));
+  }
+
+  void *_tempObject = nullptr;
+
+  // test side
+  std::map<std::string, std::string> args;
+  AsyncClient tcp;
+  std::function<void()> disconnected;
+  AsyncWebServerResponse sent;
+  int sentCount = 0;
+};
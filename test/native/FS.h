@@ -0,0 +1,186 @@
+#pragma once
+// Host stand-in for the Arduino ESP32 file system API: files live in memory,
+// a test can install a delay model to make reads and writes cost what they
+// cost on an SD card
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Arduino.h"
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+class FS;
+
+struct FileImpl {
+  FS *fs;
+  std::string path;
+  std::shared_ptr<std::vector<uint8_t>> data; // nullptr for a directory
+  std::vector<std::string> entries;           // directory listing
+  size_t next = 0;
+  size_t pos = 0;
+  bool writable = false;
+};
+
+class File {
+public:
+  File() {}
+  explicit File(std::shared_ptr<FileImpl> impl) : impl(impl) {}
+
+  size_t read(uint8_t *buf, size_t len);
+  int read() {
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+  }
+  size_t write(const uint8_t *buf, size_t len);
+  size_t write(uint8_t c) { return write(&c, 1); }
+  bool seek(uint32_t pos, SeekMode mode = SeekSet) {
+    if (!impl || !impl->data)
+      return false;
+    size_t base = mode == SeekSet   ? 0
+                  : mode == SeekCur ? impl->pos
+                                    : impl->data->size();
+    if (base + pos > impl->data->size())
+      return false;
+    impl->pos = base + pos;
+    return true;
+  }
+  size_t position() const { return impl ? impl->pos : 0; }
+  size_t size() const {
+    return impl && impl->data ? impl->data->size() : 0;
+  }
+  int available() { return size() - position(); }
+  void flush() {}
+  void close() { impl.reset(); }
+  explicit operator bool() const { return (bool)impl; }
+
+  const char *path() const { return impl ? impl->path.c_str() : nullptr; }
+  const char *name() const {
+    if (!impl)
+      return nullptr;
+    size_t slash = impl->path.rfind('/');
+    return impl->path.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+  }
+  bool isDirectory() const { return impl && !impl->data; }
+  File openNextFile();
+  time_t getLastWrite() { return 0; }
+
+private:
+  std::shared_ptr<FileImpl> impl;
+};
+
+class FS {
+public:
+  File open(const char *path, const char *mode = FILE_READ,
+            bool create = false) {
+    std::lock_guard<std::mutex> guard(lock);
+    std::string p(path);
+    auto impl = std::make_shared<FileImpl>();
+    impl->fs = this;
+    impl->path = p;
+    if (p == "/") {
+      for (auto &file : files)
+        impl->entries.push_back(file.first);
+      return File(impl);
+    }
+    auto it = files.find(p);
+    if (mode[0] == 'r') {
+      if (it == files.end())
+        return File();
+      impl->data = it->second;
+      impl->writable = mode[1] == '+';
+    } else {
+      if (it == files.end() || mode[0] == 'w')
+        files[p] = std::make_shared<std::vector<uint8_t>>();
+      impl->data = files[p];
+      impl->writable = true;
+      if (mode[0] == 'a')
+        impl->pos = impl->data->size();
+    }
+    return File(impl);
+  }
+  File open(const String &path, const char *mode = FILE_READ,
+            bool create = false) {
+    return open(path.c_str(), mode, create);
+  }
+  bool exists(const char *path) {
+    std::lock_guard<std::mutex> guard(lock);
+    return files.count(path) > 0;
+  }
+  bool exists(const String &path) { return exists(path.c_str()); }
+  bool remove(const char *path) {
+    std::lock_guard<std::mutex> guard(lock);
+    return files.erase(path) > 0;
+  }
+  bool remove(const String &path) { return remove(path.c_str()); }
+  bool rename(const char *from, const char *to) {
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = files.find(from);
+    if (it == files.end())
+      return false;
+    auto data = it->second;
+    files.erase(it);
+    files[to] = data;
+    return true;
+  }
+  bool rename(const String &from, const String &to) {
+    return rename(from.c_str(), to.c_str());
+  }
+
+  // test side: contents of a file, nullptr if it does not exist
+  std::shared_ptr<std::vector<uint8_t>> contents(const char *path) {
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = files.find(path);
+    return it == files.end() ? nullptr : it->second;
+  }
+  // called before every read and write with its file position and length
+  std::function<void(bool write, size_t pos, size_t len)> delay;
+
+private:
+  std::mutex lock;
+  std::map<std::string, std::shared_ptr<std::vector<uint8_t>>> files;
+};
+
+inline size_t File::read(uint8_t *buf, size_t len) {
+  if (!impl || !impl->data)
+    return 0;
+  len = std::min(len, impl->data->size() - impl->pos);
+  if (impl->fs->delay)
+    impl->fs->delay(false, impl->pos, len);
+  memcpy(buf, impl->data->data() + impl->pos, len);
+  impl->pos += len;
+  return len;
+}
+
+inline size_t File::write(const uint8_t *buf, size_t len) {
+  if (!impl || !impl->data || !impl->writable)
+    return 0;
+  if (impl->fs->delay)
+    impl->fs->delay(true, impl->pos, len);
+  if (impl->pos + len > impl->data->size())
+    impl->data->resize(impl->pos + len);
+  memcpy(impl->data->data() + impl->pos, buf, len);
+  impl->pos += len;
+  return len;
+}
+
+inline File File::openNextFile() {
+  if (!impl || impl->data || impl->next >= impl->entries.size())
+    return File();
+  return impl->fs->open(impl->entries[impl->next++].c_str(), FILE_READ);
+}
+
+} // namespace fs
+
+using fs::File;
+using fs::FS;
@@ -0,0 +1,6 @@
+#pragma once
+// Host stand-in for LittleFS, an in-memory file system, see FS.h
+
+#include "FS.h"
+
+inline fs::FS LittleFS;
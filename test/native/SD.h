@@ -0,0 +1,29 @@
+#pragma once
+// Host stand-in for the ESP32 SD library: an in-memory card, see FS.h
+
+#include "FS.h"
+#include "SPI.h"
+
+typedef enum { CARD_NONE, CARD_MMC, CARD_SD, CARD_SDHC, CARD_UNKNOWN } sdcard_type_t;
+
+namespace fs {
+
+class SDFS : public FS {
+public:
+  bool begin(uint8_t ssPin = SS, SPIClass &spi = SPI,
+             uint32_t frequency = 4000000, const char *mountpoint = "/sd",
+             uint8_t maxFiles = 5, bool formatIfEmpty = false) {
+    mounted = true;
+    return true;
+  }
+  void end() { mounted = false; }
+  sdcard_type_t cardType() { return mounted ? CARD_SDHC : CARD_NONE; }
+  uint64_t totalBytes() { return 1ULL << 32; }
+  uint64_t usedBytes() { return 0; }
+
+  bool mounted = true;
+};
+
+} // namespace fs
+
+inline fs::SDFS SD;
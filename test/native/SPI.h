@@ -0,0 +1,22 @@
+#pragma once
+// Host stand-in for the ESP32 SPI driver, the bus is never touched
+
+#include "Arduino.h"
+
+#define VSPI 3
+#define HSPI 2
+
+static const int8_t SS = 5;
+static const int8_t SCK = 18;
+static const int8_t MISO = 19;
+static const int8_t MOSI = 23;
+
+class SPIClass {
+public:
+  SPIClass(uint8_t bus = HSPI) {}
+  void begin(int8_t sck = -1, int8_t miso = -1, int8_t mosi = -1,
+             int8_t ss = -1) {}
+  void end() {}
+};
+
+inline SPIClass SPI;
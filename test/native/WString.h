@@ -0,0 +1,142 @@
+#pragma once
+// Host stand-in for the Arduino String class, backed by std::string
+
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <strings.h>
+
+class String {
+public:
+  String(const char *s = "") : str(s ? s : "") {}
+  String(const std::string &s) : str(s) {}
+  String(char c) : str(1, c) {}
+  String(int v) : str(std::to_string(v)) {}
+  String(unsigned v) : str(std::to_string(v)) {}
+  String(long v) : str(std::to_string(v)) {}
+  String(unsigned long v) : str(std::to_string(v)) {}
+  String(long long v) : str(std::to_string(v)) {}
+  String(unsigned long long v) : str(std::to_string(v)) {}
+  String(float v, unsigned decimals = 2) { setFloat(v, decimals); }
+  String(double v, unsigned decimals = 2) { setFloat(v, decimals); }
+
+  const char *c_str() const { return str.c_str(); }
+  unsigned length() const { return str.length(); }
+  bool isEmpty() const { return str.empty(); }
+  char operator[](unsigned i) const { return i < str.length() ? str[i] : 0; }
+  char charAt(unsigned i) const { return (*this)[i]; }
+
+  bool concat(const char *s) {
+    str += s;
+    return true;
+  }
+  bool concat(const String &s) {
+    str += s.str;
+    return true;
+  }
+  bool concat(char c) {
+    str += c;
+    return true;
+  }
+  String &operator+=(const String &s) {
+    str += s.str;
+    return *this;
+  }
+  String &operator+=(const char *s) {
+    str += s;
+    return *this;
+  }
+  String &operator+=(char c) {
+    str += c;
+    return *this;
+  }
+
+  bool equals(const String &s) const { return str == s.str; }
+  bool equalsIgnoreCase(const String &s) const {
+    return strcasecmp(c_str(), s.c_str()) == 0;
+  }
+  bool operator==(const String &s) const { return str == s.str; }
+  bool operator==(const char *s) const { return str == (s ? s : ""); }
+  bool operator!=(const String &s) const { return str != s.str; }
+  bool operator!=(const char *s) const { return !(*this == s); }
+  bool operator<(const String &s) const { return str < s.str; }
+
+  bool startsWith(const String &s) const {
+    return str.compare(0, s.str.length(), s.str) == 0;
+  }
+  bool endsWith(const String &s) const {
+    return str.length() >= s.str.length() &&
+           str.compare(str.length() - s.str.length(), s.str.length(),
+                       s.str) == 0;
+  }
+  int indexOf(char c, unsigned from = 0) const {
+    size_t i = str.find(c, from);
+    return i == std::string::npos ? -1 : (int)i;
+  }
+  int indexOf(const String &s, unsigned from = 0) const {
+    size_t i = str.find(s.str, from);
+    return i == std::string::npos ? -1 : (int)i;
+  }
+  int lastIndexOf(char c) const {
+    size_t i = str.rfind(c);
+    return i == std::string::npos ? -1 : (int)i;
+  }
+  String substring(unsigned from) const {
+    return from < str.length() ? String(str.substr(from)) : String();
+  }
+  String substring(unsigned from, unsigned to) const {
+    return from < to && from < str.length()
+               ? String(str.substr(from, to - from))
+               : String();
+  }
+  void toLowerCase() {
+    for (char &c : str)
+      c = tolower((unsigned char)c);
+  }
+  void trim() {
+    size_t b = str.find_first_not_of(" \t\r\n");
+    size_t e = str.find_last_not_of(" \t\r\n");
+    str = b == std::string::npos ? "" : str.substr(b, e - b + 1);
+  }
+  long toInt() const { return strtol(c_str(), nullptr, 10); }
+  float toFloat() const { return strtof(c_str(), nullptr); }
+
+private:
+  void setFloat(double v, unsigned decimals) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.*f", (int)decimals, v);
+    str = buf;
+  }
+
+  std::string str;
+};
+
+// result type of String concatenation, ArduinoJson checks for it
+class StringSumHelper : public String {
+public:
+  StringSumHelper(const String &s) : String(s) {}
+};
+
+inline StringSumHelper operator+(const String &a, const String &b) {
+  String s(a);
+  s += b;
+  return s;
+}
+inline StringSumHelper operator+(const String &a, const char *b) {
+  String s(a);
+  s += b;
+  return s;
+}
+inline StringSumHelper operator+(const char *a, const String &b) {
+  String s(a);
+  s += b;
+  return s;
+}
+inline StringSumHelper operator+(const String &a, char b) {
+  String s(a);
+  s += b;
+  return s;
+}
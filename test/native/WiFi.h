@@ -0,0 +1,24 @@
+#pragma once
+// Host stand-in for the WiFi library, only IPAddress is used
+
+#include "Arduino.h"
+
+class IPAddress {
+public:
+  IPAddress() : IPAddress(0, 0, 0, 0) {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : bytes{a, b, c, d} {}
+  uint8_t operator[](int i) const { return bytes[i]; }
+  bool operator==(const IPAddress &ip) const {
+    return memcmp(bytes, ip.bytes, 4) == 0;
+  }
+  bool operator!=(const IPAddress &ip) const { return !(*this == ip); }
+  String toString() const {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%u.%u.%u.%u", bytes[0], bytes[1], bytes[2],
+             bytes[3]);
+    return buf;
+  }
+
+private:
+  uint8_t bytes[4];
+};
@@ -0,0 +1,32 @@
+#pragma once
+// Host stand-in for the ESP-IDF partition API: there is no flash, no
+// partition is ever found
+
+#include <cstddef>
+#include <cstdint>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+
+#define SPI_FLASH_SEC_SIZE 4096
+
+typedef enum { ESP_PARTITION_TYPE_APP = 0, ESP_PARTITION_TYPE_DATA = 1 } esp_partition_type_t;
+typedef int esp_partition_subtype_t;
+typedef enum { SPI_FLASH_MMAP_DATA, SPI_FLASH_MMAP_INST } spi_flash_mmap_memory_t;
+typedef uint32_t spi_flash_mmap_handle_t;
+
+typedef struct {
+  esp_partition_type_t type;
+  esp_partition_subtype_t subtype;
+  uint32_t address;
+  uint32_t size;
+  char label[17];
+} esp_partition_t;
+
+inline const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype, const char *label) { return nullptr; }
+inline esp_err_t esp_partition_read(const esp_partition_t *partition, size_t offset, void *dst, size_t size) { return ESP_FAIL; }
+inline esp_err_t esp_partition_write(const esp_partition_t *partition, size_t offset, const void *src, size_t size) { return ESP_FAIL; }
+inline esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size) { return ESP_FAIL; }
+inline esp_err_t esp_partition_mmap(const esp_partition_t *partition, size_t offset, size_t size, spi_flash_mmap_memory_t memory, const void **out_ptr, spi_flash_mmap_handle_t *out_handle) { return ESP_FAIL; }
+inline void spi_flash_munmap(spi_flash_mmap_handle_t handle) {}
@@ -0,0 +1,4 @@
+#pragma once
+// esp_timer_get_time() is provided by the Arduino.h stand-in
+
+#include "Arduino.h"
@@ -0,0 +1,217 @@
+#pragma once
+// Host stand-in for the FreeRTOS queues, semaphores, tasks and task
+// notifications, built on std::thread; one tick is one millisecond
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define pdFAIL 0
+#define portMAX_DELAY 0xffffffffUL
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define portTICK_PERIOD_MS 1
+#define tskNO_AFFINITY 0x7fffffff
+
+namespace freertos_host {
+
+// wait on cv until ready() or ticks ran out
+template <typename Ready>
+bool waitFor(std::condition_variable &cv, std::unique_lock<std::mutex> &lock,
+             TickType_t ticks, Ready ready) {
+  if (ticks == portMAX_DELAY) {
+    cv.wait(lock, ready);
+    return true;
+  }
+  return cv.wait_for(lock, std::chrono::milliseconds(ticks), ready);
+}
+
+struct Queue {
+  Queue(UBaseType_t length, UBaseType_t itemSize)
+      : length(length), itemSize(itemSize), items(length * itemSize) {}
+
+  std::mutex lock;
+  std::condition_variable changed;
+  UBaseType_t length, itemSize;
+  std::vector<uint8_t> items; // ring, allocated once
+  UBaseType_t head = 0, count = 0;
+};
+
+struct Semaphore {
+  std::mutex lock;
+  std::condition_variable changed;
+  UBaseType_t count;
+};
+
+struct Task {
+  std::mutex lock;
+  std::condition_variable changed;
+  uint32_t notifications = 0;
+};
+
+inline Task *&currentTask() {
+  thread_local Task *task = nullptr;
+  if (!task)
+    task = new Task; // threads not started by xTaskCreate*
+  return task;
+}
+
+} // namespace freertos_host
+
+typedef freertos_host::Queue *QueueHandle_t;
+typedef freertos_host::Semaphore *SemaphoreHandle_t;
+typedef freertos_host::Task *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+inline QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+  return new freertos_host::Queue(length, itemSize);
+}
+
+inline BaseType_t xQueueSend(QueueHandle_t q, const void *item,
+                             TickType_t ticks) {
+  std::unique_lock<std::mutex> lock(q->lock);
+  if (!freertos_host::waitFor(q->changed, lock, ticks,
+                              [q] { return q->count < q->length; }))
+    return pdFALSE;
+  memcpy(&q->items[(q->head + q->count) % q->length * q->itemSize], item,
+         q->itemSize);
+  q->count++;
+  q->changed.notify_all();
+  return pdTRUE;
+}
+#define xQueueSendToBack xQueueSend
+
+// single item mailbox: replaces the item that is there
+inline BaseType_t xQueueOverwrite(QueueHandle_t q, const void *item) {
+  std::lock_guard<std::mutex> lock(q->lock);
+  memcpy(&q->items[q->head * q->itemSize], item, q->itemSize);
+  q->count = 1;
+  q->changed.notify_all();
+  return pdTRUE;
+}
+
+inline BaseType_t xQueueReceive(QueueHandle_t q, void *item,
+                                TickType_t ticks) {
+  std::unique_lock<std::mutex> lock(q->lock);
+  if (!freertos_host::waitFor(q->changed, lock, ticks,
+                              [q] { return q->count > 0; }))
+    return pdFALSE;
+  memcpy(item, &q->items[q->head * q->itemSize], q->itemSize);
+  q->head = (q->head + 1) % q->length;
+  q->count--;
+  q->changed.notify_all();
+  return pdTRUE;
+}
+
+inline BaseType_t xQueueReset(QueueHandle_t q) {
+  std::lock_guard<std::mutex> lock(q->lock);
+  q->head = q->count = 0;
+  q->changed.notify_all();
+  return pdPASS;
+}
+
+inline UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q) {
+  std::lock_guard<std::mutex> lock(q->lock);
+  return q->count;
+}
+
+inline UBaseType_t uxQueueSpacesAvailable(QueueHandle_t q) {
+  std::lock_guard<std::mutex> lock(q->lock);
+  return q->length - q->count;
+}
+
+inline SemaphoreHandle_t xSemaphoreCreateBinary() {
+  auto s = new freertos_host::Semaphore;
+  s->count = 0;
+  return s;
+}
+
+// no priority inheritance or owner check, good enough for tests
+inline SemaphoreHandle_t xSemaphoreCreateMutex() {
+  auto s = new freertos_host::Semaphore;
+  s->count = 1;
+  return s;
+}
+
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t ticks) {
+  std::unique_lock<std::mutex> lock(s->lock);
+  if (!freertos_host::waitFor(s->changed, lock, ticks,
+                              [s] { return s->count > 0; }))
+    return pdFALSE;
+  s->count--;
+  return pdTRUE;
+}
+
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t s) {
+  std::lock_guard<std::mutex> lock(s->lock);
+  s->count = 1;
+  s->changed.notify_all();
+  return pdTRUE;
+}
+
+inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name,
+                                          uint32_t stack, void *arg,
+                                          UBaseType_t priority,
+                                          TaskHandle_t *handle, BaseType_t core) {
+  TaskHandle_t task = new freertos_host::Task;
+  if (handle)
+    *handle = task;
+  std::thread([fn, arg, task] {
+    freertos_host::currentTask() = task;
+    fn(arg);
+  }).detach();
+  return pdPASS;
+}
+
+inline BaseType_t xTaskCreate(TaskFunction_t fn, const char *name,
+                              uint32_t stack, void *arg, UBaseType_t priority,
+                              TaskHandle_t *handle) {
+  return xTaskCreatePinnedToCore(fn, name, stack, arg, priority, handle,
+                                 tskNO_AFFINITY);
+}
+
+inline BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+  std::lock_guard<std::mutex> lock(task->lock);
+  task->notifications++;
+  task->changed.notify_all();
+  return pdPASS;
+}
+
+inline uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks) {
+  TaskHandle_t task = freertos_host::currentTask();
+  std::unique_lock<std::mutex> lock(task->lock);
+  freertos_host::waitFor(task->changed, lock, ticks,
+                         [task] { return task->notifications > 0; });
+  uint32_t value = task->notifications;
+  if (value)
+    task->notifications = clearOnExit ? 0 : value - 1;
+  return value;
+}
+
+inline TaskHandle_t xTaskGetCurrentTaskHandle() {
+  return freertos_host::currentTask();
+}
+
+inline void vTaskDelay(TickType_t ticks) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+// critical sections of the ESP32 port
+struct portMUX_TYPE {
+  std::mutex lock;
+};
+#define portMUX_INITIALIZER_UNLOCKED {}
+#define portENTER_CRITICAL(mux) (mux)->lock.lock()
+#define portEXIT_CRITICAL(mux) (mux)->lock.unlock()
+#define portENTER_CRITICAL_ISR portENTER_CRITICAL
+#define portEXIT_CRITICAL_ISR portEXIT_CRITICAL
@@ -0,0 +1,2 @@
+#pragma once
+// Host stand-in, nothing of lwIP is used
@@ -0,0 +1,17 @@
+#pragma once
+// Host stand-in for the CRC routines of the ESP32 ROM
+
+#include <cstddef>
+#include <cstdint>
+
+// CRC-32 (IEEE 802.3) like the ROM: crc32_le(0, data, len) is the CRC of data,
+// the result of one call continues the next
+inline uint32_t crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len) {
+  crc = ~crc;
+  while (len--) {
+    crc ^= *buf++;
+    for (int i = 0; i < 8; i++)
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+  }
+  return ~crc;
+}
@@ -0,0 +1,177 @@
+#pragma once
+// Host stand-in for wled.h: the globals, helpers and strip interface the
+// FSEQ usermod uses, on top of the Arduino and ESP-IDF stand-ins in this
+// directory. The strip is a plain pixel buffer.
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <vector>
+
+#include "Arduino.h"
+#include "FS.h"
+#include "LittleFS.h"
+#include "SD.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+#define ARDUINOJSON_ENABLE_ARDUINO_STRING 1
+#include "src/dependencies/json/ArduinoJson-v6.h"
+
+#include "ESPAsyncWebServer.h"
+#ifndef ESP32
+#define ESP32
+#endif
+#include "src/dependencies/e131/ESPAsyncE131.h"
+
+#define WLED_FS LittleFS
+
+#define DEBUG_PRINT(x)
+#define DEBUG_PRINTLN(x)
+#define DEBUG_PRINTF(x...)
+
+#define USERMOD_ID_UNSPECIFIED 1
+#define USERMOD_ID_SD_CARD 37
+
+#define REALTIME_MODE_INACTIVE 0
+#define REALTIME_MODE_GENERIC 1
+#define REALTIME_MODE_E131 4
+#define REALTIME_MODE_ARTNET 6
+#define REALTIME_MODE_DDP 8
+#define REALTIME_MODE_FSEQ 10
+#define REALTIME_OVERRIDE_NONE 0
+#define REALTIME_OVERRIDE_ONCE 1
+#define REALTIME_OVERRIDE_ALWAYS 2
+
+#define E131_MAX_UNIVERSE_COUNT 9
+
+// d_malloc() / p_malloc() calls, a test adds its own allocations to check
+// that a path does not allocate
+inline std::atomic<uint32_t> hostAllocations{0};
+inline void *d_malloc(size_t size) {
+  hostAllocations++;
+  return malloc(size);
+}
+inline void d_free(void *ptr) { free(ptr); }
+#define p_malloc d_malloc
+#define p_free d_free
+
+// --- realtime state (wled.h / udp.cpp) --------------------------------------
+
+inline byte realtimeMode = REALTIME_MODE_INACTIVE;
+inline byte realtimeOverride = REALTIME_OVERRIDE_NONE;
+inline IPAddress realtimeIP;
+inline uint16_t realtimeTimeoutMs = 2500;
+inline uint32_t realtimeTimeout = 0;
+inline uint16_t e131Universe = 1;
+inline uint16_t DMXAddress = 1;
+inline byte e131LastSequenceNumber[E131_MAX_UNIVERSE_COUNT];
+inline bool e131SkipOutOfSequence = false;
+
+inline void handleE131Packet(e131_packet_t *p, IPAddress clientIP,
+                             byte protocol) {}
+inline ESPAsyncE131::ESPAsyncE131(e131_packet_callback_function callback)
+    : _callback(callback) {}
+inline ESPAsyncE131 e131(handleE131Packet);
+inline ESPAsyncE131 ddp(handleE131Packet);
+
+// --- strip ------------------------------------------------------------------
+
+struct Segment {
+  uint16_t start;
+  uint16_t stop;
+};
+
+class WS2812FX {
+public:
+  void setLength(uint16_t length) { pixels.assign(length, 0); }
+  uint16_t getLengthTotal() const { return pixels.size(); }
+  uint16_t getLength() const { return pixels.size(); }
+  Segment getSegment(int id) const { return {0, getLength()}; }
+  void setPixelColor(unsigned i, uint32_t c) {
+    if (i < pixels.size())
+      pixels[i] = c;
+  }
+  uint32_t getPixelColorNoMap(unsigned i) const {
+    return i < pixels.size() ? pixels[i] : 0;
+  }
+  void show() { shows++; }
+  void trigger() {}
+
+  std::vector<uint32_t> pixels;
+  uint32_t shows = 0;
+};
+
+inline WS2812FX strip;
+
+inline void realtimeLock(uint32_t timeoutMs, byte md = REALTIME_MODE_GENERIC) {
+  realtimeMode = md;
+  realtimeTimeout = millis() + timeoutMs;
+}
+
+inline void exitRealtime() {
+  realtimeMode = REALTIME_MODE_INACTIVE;
+  realtimeIP = IPAddress();
+}
+
+inline void setRealtimePixel(uint16_t i, byte r, byte g, byte b, byte w) {
+  strip.setPixelColor(i, (uint32_t(w) << 24) | (uint32_t(r) << 16) |
+                             (uint32_t(g) << 8) | b);
+}
+
+inline void setRealtimePixels(uint16_t i, const byte *data, unsigned count,
+                              unsigned bytesPerPixel = 3) {
+  for (unsigned n = 0; n < count; n++, data += bytesPerPixel)
+    setRealtimePixel(i + n, data[0], data[1], data[2],
+                     bytesPerPixel > 3 ? data[3] : 0);
+}
+
+// --- usermods and pins ------------------------------------------------------
+
+class Usermod {
+public:
+  virtual ~Usermod() {}
+  virtual void setup() = 0;
+  virtual void loop() = 0;
+  virtual void addToJsonInfo(JsonObject &obj) {}
+  virtual void addToConfig(JsonObject &obj) {}
+  virtual bool readFromConfig(JsonObject &obj) { return true; }
+  virtual uint16_t getId() { return USERMOD_ID_UNSPECIFIED; }
+};
+
+enum struct PinOwner : uint8_t { None = 0, UM_SdCard = USERMOD_ID_SD_CARD };
+
+typedef struct PinManagerPinType {
+  int8_t pin;
+  bool isOutput;
+} managed_pin_type;
+
+namespace PinManager {
+inline bool allocateMultiplePins(const managed_pin_type *pins, byte count,
+                                 PinOwner tag) {
+  return true;
+}
+inline bool deallocatePin(byte gpio, PinOwner tag) { return true; }
+} // namespace PinManager
+
+#define WLED_O2_ATTR __attribute__((optimize("O2")))
+
+// copy of color_blend() in colors.cpp
+inline uint32_t color_blend(uint32_t color1, uint32_t color2, uint8_t blend) {
+  const uint32_t TWO_CHANNEL_MASK = 0x00FF00FF;
+  uint32_t rb1 = color1 & TWO_CHANNEL_MASK;
+  uint32_t wg1 = (color1 >> 8) & TWO_CHANNEL_MASK;
+  uint32_t rb2 = color2 & TWO_CHANNEL_MASK;
+  uint32_t wg2 = (color2 >> 8) & TWO_CHANNEL_MASK;
+  uint32_t rb3 = ((((rb1 << 8) | rb2) + (rb2 * blend) - (rb1 * blend)) >> 8) &
+                 TWO_CHANNEL_MASK;
+  uint32_t wg3 = ((((wg1 << 8) | wg2) + (wg2 * blend) - (wg1 * blend))) &
+                 ~TWO_CHANNEL_MASK;
+  return rb3 | wg3;
+}
+
+#define RGBW32(r, g, b, w) \
+  (uint32_t((byte(w) << 24) | (byte(r) << 16) | (byte(g) << 8) | (byte(b))))
+#define R(c) (byte((c) >> 16))
+#define G(c) (byte((c) >> 8))
+#define B(c) (byte(c))
+#define W(c) (byte((c) >> 24))
@@ -0,0 +1,145 @@
+// Segment blend modes (wled00/blend_modes.h): the RGBW32 kernels and row
+// loops must give the same pixels as the per-channel functions they replaced,
+// and the benchmark compares both for all 16 modes. Host timings only rank
+// the modes: the compiler vectorizes the row loops here, the ESP32 runs them
+// one pixel at a time.
+//
+//   pio test -e native -f test_blend_modes -v
+
+#include <chrono>
+#include <cstdio>
+#include <unity.h>
+
+#include "wled.h"
+#include "blend_modes.h"
+
+// per-channel functions of the blend modes before the RGBW32 kernels
+static uint8_t _top       (uint8_t a, uint8_t b) { return a; }
+static uint8_t _bottom    (uint8_t a, uint8_t b) { return b; }
+static uint8_t _add       (uint8_t a, uint8_t b) { unsigned t = a + b; return t > 255 ? 255 : t; }
+static uint8_t _subtract  (uint8_t a, uint8_t b) { return b > a ? (b - a) : 0; }
+static uint8_t _difference(uint8_t a, uint8_t b) { return b > a ? (b - a) : (a - b); }
+static uint8_t _average   (uint8_t a, uint8_t b) { return (a + b) >> 1; }
+static uint8_t _lighten   (uint8_t a, uint8_t b) { return a > b ? a : b; }
+static uint8_t _darken    (uint8_t a, uint8_t b) { return a < b ? a : b; }
+
+typedef uint8_t (*ChannelFunc)(uint8_t, uint8_t);
+// indexed by Segment::blendMode, like blendFuncs[]
+static const ChannelFunc channelFuncs[] = {
+  _top, _bottom,
+  _add, _subtract, _difference, _average,
+  _multiply, _divide, _lighten, _darken, _screen, _overlay,
+  _hardlight, _softlight, _dodge, _burn
+};
+static const unsigned MODES = sizeof(channelFuncs) / sizeof(ChannelFunc);
+
+// the blend of the per-pixel path before the kernels, see blendSegment()
+static uint32_t blendChannels(ChannelFunc f, uint32_t top, uint32_t bottom) {
+  return RGBW32(f(R(top),R(bottom)), f(G(top),G(bottom)), f(B(top),B(bottom)), f(W(top),W(bottom)));
+}
+
+static uint32_t rng = 1;
+static uint32_t random32() { rng ^= rng << 13; rng ^= rng >> 17; rng ^= rng << 5; return rng; }
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static void test_mode_tables_match(void) {
+  TEST_ASSERT_EQUAL(MODES, sizeof(blendFuncs) / sizeof(BlendFunc));
+  TEST_ASSERT_EQUAL(MODES, sizeof(blendRowFuncs) / sizeof(BlendRowFunc));
+}
+
+// every pair of channel values in every channel position, the other channels
+// random so carries and borrows between channels would show
+static void test_kernels_match_channel_functions(void) {
+  char msg[96];
+  for (unsigned mode = 0; mode < MODES; mode++) {
+    for (unsigned a = 0; a < 256; a++) {
+      for (unsigned b = 0; b < 256; b++) {
+        for (unsigned shift = 0; shift < 32; shift += 8) {
+          const uint32_t mask = 0xFFu << shift;
+          const uint32_t top    = (random32() & ~mask) | (a << shift);
+          const uint32_t bottom = (random32() & ~mask) | (b << shift);
+          const uint32_t want = blendChannels(channelFuncs[mode], top, bottom);
+          const uint32_t got  = blendFuncs[mode](top, bottom);
+          if (got != want) {
+            snprintf(msg, sizeof(msg), "mode %u: %08X on %08X gives %08X, expected %08X",
+                     mode, (unsigned)top, (unsigned)bottom, (unsigned)got, (unsigned)want);
+            TEST_FAIL_MESSAGE(msg);
+          }
+        }
+      }
+    }
+  }
+}
+
+// the row loops against the per-pixel path: color_blend() with opacity,
+// forwards and reversed segments
+static void test_rows_match_pixel_path(void) {
+  const unsigned N = 301;
+  static uint32_t src[N], dst[N], want[N];
+  const uint8_t opacities[] = { 0, 1, 77, 128, 254, 255 };
+  char msg[96];
+  for (unsigned mode = 0; mode < MODES; mode++) {
+    for (uint8_t opacity : opacities) {
+      for (int step : { 1, -1 }) {
+        for (unsigned i = 0; i < N; i++) { src[i] = random32(); dst[i] = want[i] = random32(); }
+        const uint32_t *first = step > 0 ? src : src + N - 1;
+        for (unsigned i = 0; i < N; i++) {
+          const uint32_t c = first[int(i) * step];
+          want[i] = color_blend(want[i], blendChannels(channelFuncs[mode], c, want[i]), opacity);
+        }
+        blendRowFuncs[mode](dst, first, step, N, opacity);
+        for (unsigned i = 0; i < N; i++) {
+          if (dst[i] != want[i]) {
+            snprintf(msg, sizeof(msg), "mode %u opacity %u step %d: pixel %u is %08X, expected %08X",
+                     mode, opacity, step, i, (unsigned)dst[i], (unsigned)want[i]);
+            TEST_FAIL_MESSAGE(msg);
+          }
+        }
+      }
+    }
+  }
+}
+
+// ns per pixel of a segment row blended the way blendSegment() did before
+// (channel function through a pointer, color_blend() on every pixel) and
+// with the row loop of the mode, at full and at half opacity
+static void benchmark_modes(void) {
+  const unsigned N = 1024, ROUNDS = 2000;
+  static uint32_t src[N], dst[N];
+  for (unsigned i = 0; i < N; i++) { src[i] = random32(); dst[i] = random32(); }
+  volatile uint32_t sink = 0;
+  char msg[128];
+  for (uint8_t opacity : { 255, 128 }) {
+    for (unsigned mode = 0; mode < MODES; mode++) {
+      volatile ChannelFunc f = channelFuncs[mode]; // not folded into the loop, like funcs[blendMode]
+      auto t0 = std::chrono::steady_clock::now();
+      for (unsigned r = 0; r < ROUNDS; r++) {
+        const ChannelFunc func = f;
+        for (unsigned i = 0; i < N; i++) dst[i] = color_blend(dst[i], blendChannels(func, src[i], dst[i]), opacity);
+        sink = sink + dst[r % N];
+      }
+      auto t1 = std::chrono::steady_clock::now();
+      for (unsigned r = 0; r < ROUNDS; r++) {
+        blendRowFuncs[mode](dst, src, 1, N, opacity);
+        sink = sink + dst[r % N];
+      }
+      auto t2 = std::chrono::steady_clock::now();
+      const double before = std::chrono::duration<double, std::nano>(t1 - t0).count() / (N * ROUNDS);
+      const double after  = std::chrono::duration<double, std::nano>(t2 - t1).count() / (N * ROUNDS);
+      snprintf(msg, sizeof(msg), "mode %2u opacity %3u: %6.2f ns/pixel per channel, %6.2f ns/pixel row kernel (%.1fx)",
+               mode, opacity, before, after, before / after);
+      TEST_MESSAGE(msg);
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_mode_tables_match);
+  RUN_TEST(test_kernels_match_channel_functions);
+  RUN_TEST(test_rows_match_pixel_path);
+  RUN_TEST(benchmark_modes);
+  return UNITY_END();
+}
@@ -0,0 +1,201 @@
+// Handing the frame to the buses in WS2812FX::show() (wled00/pixel_runs.h):
+// the runs must put the same pixels on the buses as one setPixelColor() per
+// pixel did, and the benchmark times both for 1, 4 and 10 buses with a
+// plain, a serpentine and a shuffled ledmap. The buses are stand-ins that
+// store RGB bytes like BusNetwork, so the timings show the cost of the bus
+// lookup and the virtual calls, not of a LED driver. On the host the runs
+// save 1.1x (1 bus) to 2.5x (10 buses) with plain and serpentine maps; a
+// shuffled map has no runs and stays at the speed of the per-pixel path.
+//
+//   pio test -e native -f test_bus_show -v
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <vector>
+#include <unity.h>
+
+#include "pixel_runs.h"
+
+// the parts of Bus that show() and BusManager use
+class TestBus {
+  public:
+    TestBus(uint16_t start, uint16_t len) : _start(start), _len(len), _data(len * 3) {}
+    virtual ~TestBus() {}
+    virtual uint16_t getLength() const { return _len; }
+    inline uint16_t getStart() const { return _start; }
+    inline bool containsPixel(uint16_t pix) const { return pix >= _start && pix < _start + _len; }
+    virtual void setPixelColor(unsigned pix, uint32_t c) {
+      if (pix >= _len) return;
+      _data[pix * 3] = c >> 16; _data[pix * 3 + 1] = c >> 8; _data[pix * 3 + 2] = c;
+    }
+    virtual void setPixels(unsigned pix, const uint32_t *c, unsigned count) {
+      for (unsigned i = 0; i < count; i++) TestBus::setPixelColor(pix + i, c[i]); // like BusNetwork::setPixels()
+    }
+    const std::vector<uint8_t> &data() const { return _data; }
+  private:
+    uint16_t _start, _len;
+    std::vector<uint8_t> _data;
+};
+
+typedef std::vector<std::unique_ptr<TestBus>> Busses;
+
+static const unsigned TOTAL = 4000;    // LEDs
+static const unsigned WIDTH = 50;      // of the serpentine matrix
+static const unsigned maxRun = 64;     // as in show()
+
+static uint8_t gammaT[256];
+static uint32_t gamma32(uint32_t c) {
+  return (uint32_t(gammaT[c >> 24]) << 24) | (gammaT[(c >> 16) & 0xFF] << 16) | (gammaT[(c >> 8) & 0xFF] << 8) | gammaT[c & 0xFF];
+}
+
+static uint32_t rng = 1;
+static uint32_t random32() { rng ^= rng << 13; rng ^= rng >> 17; rng ^= rng << 5; return rng; }
+
+static Busses makeBusses(unsigned count, bool overlap = false) {
+  Busses busses;
+  const unsigned len = TOTAL / count;
+  for (unsigned i = 0; i < count; i++) busses.emplace_back(new TestBus(i * len, len));
+  if (overlap) busses.emplace_back(new TestBus(len / 2, len)); // a second bus showing pixels of the first two
+  return busses;
+}
+
+enum MapType { PLAIN, SERPENTINE, SHUFFLED };
+static const char *mapNames[] = { "plain", "serpentine", "shuffled" };
+
+static std::vector<uint16_t> makeMap(MapType type) {
+  std::vector<uint16_t> map(TOTAL);
+  for (unsigned i = 0; i < TOTAL; i++) {
+    const unsigned row = i / WIDTH, col = i % WIDTH;
+    map[i] = type == SERPENTINE && (row & 1) ? row * WIDTH + WIDTH - 1 - col : i;
+  }
+  if (type == SHUFFLED) for (unsigned i = TOTAL - 1; i > 0; i--) std::swap(map[i], map[random32() % (i + 1)]);
+  return map;
+}
+
+// BusManager::setPixelColor()
+static void setPixelOnBusses(Busses &busses, unsigned pix, uint32_t c) {
+  for (auto &bus : busses) {
+    if (!bus->containsPixel(pix)) continue;
+    bus->setPixelColor(pix - bus->getStart(), c);
+  }
+}
+
+// show() before the runs: BusManager::setPixelColor() for every pixel
+static void showPerPixel(Busses &busses, const uint32_t *pixels, const uint16_t *map) {
+  for (size_t i = 0; i < TOTAL; i++) {
+    uint32_t c = pixels[i];
+    if (c > 0) c = gamma32(c);
+    setPixelOnBusses(busses, map[i], c);
+  }
+}
+
+// show() with runs, pixelCCT may be nullptr
+static unsigned showRuns(Busses &busses, const uint32_t *pixels, const uint16_t *map, const uint8_t *pixelCCT) {
+  uint32_t run[maxRun];
+  unsigned runs = 0;
+  forEachPixelRun(TOTAL, maxRun, [map](size_t i) { return map[i]; },
+    [pixelCCT](size_t i) { return pixelCCT && pixelCCT[i-1] != pixelCCT[i]; },
+    [&](size_t i, unsigned first, unsigned len, int dir) {
+      for (unsigned n = 0; n < len; n++) {
+        uint32_t c = pixels[i + n];
+        if (c > 0) c = gamma32(c);
+        if (len == 1) setPixelOnBusses(busses, first, c);
+        else run[dir < 0 ? len - 1 - n : n] = c;
+      }
+      if (len > 1) setPixelsOnBusses(busses, dir < 0 ? first - (len - 1) : first, run, len);
+      runs++;
+    });
+  return runs;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static void test_runs_match_per_pixel(void) {
+  static uint32_t pixels[TOTAL];
+  static uint8_t pixelCCT[TOTAL];
+  for (unsigned i = 0; i < 256; i++) gammaT[i] = (i * i + 255) >> 8;
+  for (unsigned i = 0; i < TOTAL; i++) pixels[i] = random32() & (i % 7 ? 0xFFFFFFFF : 0); // some black
+  uint8_t cct = 0;
+  for (unsigned i = 0; i < TOTAL; i++) { if (random32() % 37 == 0) cct++; pixelCCT[i] = cct; }
+
+  char msg[96];
+  for (MapType type : { PLAIN, SERPENTINE, SHUFFLED }) {
+    const std::vector<uint16_t> map = makeMap(type);
+    for (unsigned count : { 1, 4, 10 }) {
+      for (bool overlap : { false, true }) {
+        for (bool withCCT : { false, true }) {
+          Busses want = makeBusses(count, overlap), got = makeBusses(count, overlap);
+          showPerPixel(want, pixels, map.data());
+          showRuns(got, pixels, map.data(), withCCT ? pixelCCT : nullptr);
+          for (size_t b = 0; b < want.size(); b++) {
+            snprintf(msg, sizeof(msg), "%s map, %u buses%s%s: bus %u differs", mapNames[type], count,
+                     overlap ? " + overlap" : "", withCCT ? ", CCT" : "", (unsigned)b);
+            TEST_ASSERT_TRUE_MESSAGE(want[b]->data() == got[b]->data(), msg);
+          }
+        }
+      }
+    }
+  }
+}
+
+// a run never crosses a CCT change, is at most maxRun long and covers
+// consecutive mapped pixels
+static void test_run_bounds(void) {
+  static uint8_t pixelCCT[TOTAL];
+  for (unsigned i = 0; i < TOTAL; i++) pixelCCT[i] = i / 100;
+  const std::vector<uint16_t> map = makeMap(SERPENTINE);
+  size_t next = 0;
+  forEachPixelRun(TOTAL, maxRun, [&map](size_t i) { return map[i]; },
+    [](size_t i) { return pixelCCT[i-1] != pixelCCT[i]; },
+    [&](size_t i, unsigned first, unsigned len, int dir) {
+      TEST_ASSERT_EQUAL(next, i);
+      TEST_ASSERT_TRUE(len >= 1 && len <= maxRun);
+      TEST_ASSERT_EQUAL(pixelCCT[i], pixelCCT[i + len - 1]);
+      for (unsigned n = 0; n < len; n++) TEST_ASSERT_EQUAL(first + int(n) * dir, map[i + n]);
+      next = i + len;
+    });
+  TEST_ASSERT_EQUAL(TOTAL, next);
+}
+
+// best of several batches, the host is not quiet
+template<typename Fn>
+static double bestUs(Fn fn) {
+  const unsigned BATCHES = 7, ROUNDS = 300;
+  double best = 1e9;
+  for (unsigned b = 0; b < BATCHES; b++) {
+    auto t0 = std::chrono::steady_clock::now();
+    for (unsigned r = 0; r < ROUNDS; r++) fn();
+    auto t1 = std::chrono::steady_clock::now();
+    best = std::min(best, std::chrono::duration<double, std::micro>(t1 - t0).count() / ROUNDS);
+  }
+  return best;
+}
+
+static void benchmark_show(void) {
+  static uint32_t pixels[TOTAL];
+  for (unsigned i = 0; i < TOTAL; i++) pixels[i] = random32();
+  char msg[160];
+  for (MapType type : { PLAIN, SERPENTINE, SHUFFLED }) {
+    const std::vector<uint16_t> map = makeMap(type);
+    for (unsigned count : { 1, 4, 10 }) {
+      Busses busses = makeBusses(count);
+      unsigned runs = 0;
+      const double before = bestUs([&] { showPerPixel(busses, pixels, map.data()); });
+      const double after  = bestUs([&] { runs = showRuns(busses, pixels, map.data(), nullptr); });
+      snprintf(msg, sizeof(msg), "%4u LEDs, %-10s map, %2u buses: %7.1f us pixel by pixel, %7.1f us in %4u runs (%.1fx)",
+               TOTAL, mapNames[type], count, before, after, runs, before / after);
+      TEST_MESSAGE(msg);
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_runs_match_per_pixel);
+  RUN_TEST(test_run_bounds);
+  RUN_TEST(benchmark_show);
+  return UNITY_END();
+}
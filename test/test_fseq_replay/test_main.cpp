@@ -0,0 +1,218 @@
+// Replay of a synthetic sequence from the SD card (usermods/FSEQ): the
+// player parses the header, maps the channel window onto read runs and
+// keeps its read-ahead ring filled from loop(), here from an in-memory card
+// with the delay of an SD card on a 20 MHz SPI bus. Every frame shown must
+// carry the right channel data; the benchmark prints the read time per frame
+// that /api/fseq/metrics reports, as percentiles.
+//
+//   pio test -e native -f test_fseq_replay -v
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+#include <unity.h>
+
+#include "fseq_cache.cpp"
+#include "fseq_decoder.cpp"
+#include "fseq_flash.cpp"
+#include "fseq_header.cpp"
+#include "fseq_index.cpp"
+#include "fseq_io.cpp"
+#include "fseq_manager.cpp"
+#include "fseq_metrics.cpp"
+#include "fseq_player.cpp"
+#include "fseq_upload.cpp"
+#include "sd_manager.cpp"
+
+static const uint16_t LEDS = 1500;    // 4500 channels, two read chunks
+static const uint8_t STEP_MS = 25;    // 40 fps
+static const uint32_t FRAMES = 120;   // 3 s
+
+// --- synthetic sequence -------------------------------------------------------
+
+// channel data: the first three channels hold the frame number, so a shown
+// frame can be identified from its first LED
+static uint8_t channelValue(uint32_t frame, uint32_t channel) {
+  if (channel < 3)
+    return frame >> (16 - 8 * channel);
+  return frame * 131 + channel * 7 + (channel >> 8);
+}
+
+static void put(std::vector<uint8_t> &file, uint32_t value, uint8_t bytes) {
+  for (uint8_t i = 0; i < bytes; i++)
+    file.push_back(value >> (8 * i));
+}
+
+struct Range {
+  uint32_t start, length;
+};
+
+// v2 uncompressed sequence of channelCount channels, of which only the
+// sparse ranges are stored if there are any; the header then counts the
+// stored channels, like FPP writes it
+static void writeSequence(const char *path, uint32_t channelCount,
+                          const std::vector<Range> &ranges) {
+  std::vector<Range> stored = ranges;
+  if (stored.empty())
+    stored.push_back({0, channelCount});
+  uint32_t frameSize = 0;
+  for (const Range &range : stored)
+    frameSize += range.length;
+
+  const char media[] = "show.mp3";
+  const uint16_t headerLength = 32 + ranges.size() * 6;
+  const uint16_t dataOffset = (headerLength + 4 + sizeof(media) + 3) & ~3;
+  std::vector<uint8_t> file;
+  file.insert(file.end(), {'P', 'S', 'E', 'Q'});
+  put(file, dataOffset, 2);
+  file.push_back(0); // minor version
+  file.push_back(2); // major version
+  put(file, headerLength, 2);
+  put(file, frameSize, 4);
+  put(file, FRAMES, 4);
+  file.push_back(STEP_MS);
+  file.push_back(0);                 // flags
+  file.push_back(0);                 // no compression, no blocks
+  file.push_back(0);
+  file.push_back(ranges.size());
+  file.push_back(0);
+  put(file, 0x12345678, 4);          // unique id
+  put(file, 0, 4);
+  for (const Range &range : ranges) {
+    put(file, range.start, 3);
+    put(file, range.length, 3);
+  }
+  put(file, 4 + sizeof(media), 2);   // 'mf' variable header
+  file.insert(file.end(), {'m', 'f'});
+  file.insert(file.end(), media, media + sizeof(media));
+  file.resize(dataOffset, 0);
+
+  for (uint32_t frame = 0; frame < FRAMES; frame++)
+    for (const Range &range : stored)
+      for (uint32_t ch = range.start; ch < range.start + range.length; ch++)
+        file.push_back(channelValue(frame, ch));
+
+  File out = SD.open(path, FILE_WRITE);
+  out.write(file.data(), file.size());
+  out.close();
+}
+
+// --- SD card delay --------------------------------------------------------------
+
+// 20 MHz SPI moves about 2 MB/s; a read costs a command round trip, more
+// after a seek, and now and then the card stalls for internal work
+static uint32_t cardReads = 0;
+static size_t cardPos = 0;
+
+static void spinUntil(int64_t us) {
+  while (esp_timer_get_time() < us) {
+  }
+}
+
+static void sdCardDelay(bool write, size_t pos, size_t len) {
+  uint32_t us = (pos == cardPos ? 100 : 400) + len / 2;
+  if (++cardReads % 64 == 0)
+    us += 6000;
+  cardPos = pos + len;
+  spinUntil(esp_timer_get_time() + us);
+}
+
+// --- replay -----------------------------------------------------------------------
+
+// loop() until the sequence ends, checking each frame shown
+static uint32_t replay(const char *path, const std::vector<Range> &ranges,
+                       uint32_t &wrongFrames) {
+  FSEQPlayer &player = FSEQPlayerManager::primary();
+  uint32_t shown = 0, lastShows = strip.shows;
+  int32_t lastFrame = -1;
+  wrongFrames = 0;
+
+  auto check = [&] {
+    if (strip.shows == lastShows)
+      return;
+    lastShows = strip.shows;
+    shown++;
+    const uint32_t p0 = strip.pixels[0];
+    const int32_t frame = (p0 >> 16 & 0xFF) << 16 | (p0 >> 8 & 0xFF) << 8 | (p0 & 0xFF);
+    bool ok = frame > lastFrame && frame < (int32_t)FRAMES;
+    for (uint32_t led = 1; ok && led < LEDS; led++) {
+      uint8_t rgb[3];
+      for (uint32_t c = 0; c < 3; c++) {
+        const uint32_t ch = led * 3 + c;
+        bool storedChannel = ranges.empty();
+        for (const Range &range : ranges)
+          storedChannel |= ch >= range.start && ch < range.start + range.length;
+        rgb[c] = storedChannel ? channelValue(frame, ch) : 0; // not in the file: black
+      }
+      ok = strip.pixels[led] == (uint32_t(rgb[0]) << 16 | rgb[1] << 8 | rgb[2]);
+    }
+    if (!ok)
+      wrongFrames++;
+    lastFrame = frame;
+  };
+
+  player.loadRecording(path, 0, LEDS);
+  check();
+  while (FSEQPlayerManager::isAnyActive()) {
+    FSEQPlayerManager::handle();
+    check();
+  }
+  return shown;
+}
+
+static void report(const char *name) {
+  char msg[200];
+  const FSEQLatency &read = FSEQMetrics::sdRead;
+  snprintf(msg, sizeof(msg),
+           "%s: read per frame p50 %u us, p90 %u us, p99 %u us, max %u us "
+           "(%u frames, avg %u us); open %u us; %u late, %u skipped, %u underruns",
+           name, read.getPercentile(50), read.getPercentile(90),
+           read.getPercentile(99), read.getMax(), read.getCount(),
+           read.getAvg(), FSEQMetrics::fileOpen.getMax(),
+           FSEQMetrics::lateFrames, FSEQMetrics::skippedFrames,
+           FSEQMetrics::underruns);
+  TEST_MESSAGE(msg);
+}
+
+void setUp(void) {
+  strip.setLength(LEDS);
+  FSEQMetrics::reset();
+  cardReads = 0;
+  SD.delay = sdCardDelay;
+}
+void tearDown(void) { SD.delay = nullptr; }
+
+static void test_replay_full_frames(void) {
+  SD.delay = nullptr;
+  writeSequence("/full.fseq", LEDS * 3, {});
+  SD.delay = sdCardDelay;
+
+  uint32_t wrong;
+  const uint32_t shown = replay("/full.fseq", {}, wrong);
+  report("full frames");
+  TEST_ASSERT_EQUAL_MESSAGE(0, wrong, "frames with wrong channel data");
+  TEST_ASSERT_EQUAL(FRAMES, shown + FSEQMetrics::skippedFrames);
+  TEST_ASSERT_EQUAL_STRING("show.mp3", FSEQPlayerManager::primary().getMediaFileName().c_str());
+}
+
+// two sparse ranges with a gap the player leaves black, the second one
+// reaches past the strip: two read runs, the last one cut at the window
+static void test_replay_sparse_ranges(void) {
+  const std::vector<Range> ranges = {{0, 1500}, {3000, 3000}};
+  SD.delay = nullptr;
+  writeSequence("/sparse.fseq", 6000, ranges);
+  SD.delay = sdCardDelay;
+
+  uint32_t wrong;
+  const uint32_t shown = replay("/sparse.fseq", ranges, wrong);
+  report("sparse ranges");
+  TEST_ASSERT_EQUAL_MESSAGE(0, wrong, "frames with wrong channel data");
+  TEST_ASSERT_EQUAL(FRAMES, shown + FSEQMetrics::skippedFrames);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_replay_full_frames);
+  RUN_TEST(test_replay_sparse_ranges);
+  return UNITY_END();
+}
@@ -0,0 +1,211 @@
+// FPP sync packets handed from the UDP task to loop() (FSEQSyncQueue in
+// usermods/FSEQ/fseq_sync.cpp): a producer thread pushes thousands of sync
+// packets per second while a consumer thread runs handle() like loop().
+// Every command must arrive whole and in order, lost packets must be counted
+// as dropped, and the UDP side must not allocate. The node is in FPP remote
+// mode, so the commands end in FSEQRemoteBuffer::sync() / stop(), which this
+// test defines to check them instead of linking fseq_remote.cpp.
+//
+//   pio test -e native -f test_sync_queue -v
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <new>
+#include <thread>
+#include <unity.h>
+
+#include "fseq_cache.cpp"
+#include "fseq_decoder.cpp"
+#include "fseq_flash.cpp"
+#include "fseq_header.cpp"
+#include "fseq_index.cpp"
+#include "fseq_io.cpp"
+#include "fseq_manager.cpp"
+#include "fseq_metrics.cpp"
+#include "fseq_player.cpp"
+#include "fseq_sync.cpp"
+#include "fseq_upload.cpp"
+#include "sd_manager.cpp"
+
+// allocations of the calling thread, the producer checks its own
+static thread_local uint32_t threadAllocations = 0;
+void *operator new(size_t size) {
+  threadAllocations++;
+  if (void *ptr = malloc(size ? size : 1))
+    return ptr;
+  throw std::bad_alloc();
+}
+__attribute__((noinline)) void operator delete(void *ptr) noexcept { free(ptr); }
+__attribute__((noinline)) void operator delete(void *ptr, size_t) noexcept { free(ptr); }
+
+// --- FSEQRemoteBuffer: checks what loop() gets -------------------------------
+
+bool FSEQRemoteBuffer::enabled = false;
+
+static uint32_t lastFrame;   // frame number of the previous command
+static int64_t lastUs;       // its receive time
+static uint32_t syncs, stops;
+static uint32_t torn;        // fields from different packets, or out of order
+
+static float secondsOf(uint32_t frameNumber) { return frameNumber * 0.025f; }
+
+// the producer numbers its packets 1, 2, ...
+void FSEQRemoteBuffer::sync(uint32_t frameNumber, float secondsElapsed,
+                            int64_t receivedUs) {
+  if (secondsElapsed != secondsOf(frameNumber) || frameNumber <= lastFrame ||
+      receivedUs < lastUs)
+    torn++;
+  lastFrame = frameNumber;
+  lastUs = receivedUs;
+  syncs++;
+}
+
+// STOP and BLANK
+void FSEQRemoteBuffer::stop() { stops++; }
+
+// --- packets ------------------------------------------------------------------
+
+// FPP CTRL_PKT_SYNC packet of a sequence
+static size_t makeSyncPacket(uint8_t *data, uint8_t action,
+                             uint32_t frameNumber, const char *fileName) {
+  const float seconds = secondsOf(frameNumber);
+  const size_t nameLength = strlen(fileName) + 1;
+  memcpy(data, "FPPD", 4);
+  data[4] = 1;                       // CTRL_PKT_SYNC
+  data[5] = 10 + nameLength;         // extra data length
+  data[6] = 0;
+  data[7] = action;
+  data[8] = SYNC_FILE_SEQ;
+  memcpy(data + 9, &frameNumber, 4);
+  memcpy(data + 13, &seconds, 4);
+  memcpy(data + 17, fileName, nameLength);
+  return 17 + nameLength;
+}
+
+struct ProducerResult {
+  uint32_t pushed = 0;
+  uint32_t refused = 0;     // queue full
+  uint32_t allocations = 0;
+};
+
+// UDP task: count packets, interval 0 pushes as fast as possible and only
+// yields every 8 packets, so loop() runs in between on a single core too;
+// every 100th packet stops the sequence
+static ProducerResult pushAll(uint32_t count, std::chrono::microseconds interval) {
+  ProducerResult result;
+  uint8_t packet[96];
+  const uint32_t allocationsBefore = threadAllocations;
+  auto next = std::chrono::steady_clock::now();
+  for (uint32_t n = 1; n <= count; n++) {
+    const uint8_t action = n % 100 == 0 ? SYNC_PKT_STOP
+                           : n == 1    ? SYNC_PKT_START
+                                       : SYNC_PKT_SYNC;
+    const size_t length = makeSyncPacket(packet, action, n, "show.fseq");
+    if (FSEQSyncQueue::pushSync(packet, length))
+      result.pushed++;
+    else
+      result.refused++;
+    if (interval.count()) {
+      next += interval;
+      std::this_thread::sleep_until(next);
+    } else if (n % 8 == 0) {
+      std::this_thread::yield();
+    }
+  }
+  result.allocations = threadAllocations - allocationsBefore;
+  return result;
+}
+
+// loop(): apply the queue until the producer is done and the queue empty
+static void runLoop(std::atomic<bool> &producing) {
+  while (producing.load()) {
+    FSEQSyncQueue::handle();
+    std::this_thread::yield();
+  }
+  FSEQSyncQueue::handle();
+}
+
+void setUp(void) {
+  FSEQRemoteBuffer::setEnabled(true);
+  lastFrame = 0;
+  lastUs = 0;
+  syncs = stops = torn = 0;
+}
+void tearDown(void) {}
+
+static void runStress(uint32_t count, std::chrono::microseconds interval,
+                      const char *name) {
+  const uint32_t droppedBefore = FSEQSyncQueue::getDropped();
+  const uint32_t hostBefore = hostAllocations;
+  std::atomic<bool> producing{true};
+  ProducerResult result;
+
+  auto t0 = std::chrono::steady_clock::now();
+  std::thread udp([&] {
+    result = pushAll(count, interval);
+    producing.store(false);
+  });
+  runLoop(producing);
+  udp.join();
+  auto t1 = std::chrono::steady_clock::now();
+
+  const double seconds = std::chrono::duration<double>(t1 - t0).count();
+  const uint32_t dropped = FSEQSyncQueue::getDropped() - droppedBefore;
+  char msg[160];
+  snprintf(msg, sizeof(msg),
+           "%s: %u packets in %.2f s (%.0f/s), %u applied, %u dropped, %u torn",
+           name, (unsigned)count, seconds, count / seconds,
+           (unsigned)(syncs + stops), (unsigned)dropped, (unsigned)torn);
+  TEST_MESSAGE(msg);
+
+  TEST_ASSERT_EQUAL_MESSAGE(0, torn, "command fields from different packets or out of order");
+  TEST_ASSERT_EQUAL_MESSAGE(0, result.allocations, "pushSync() allocated");
+  TEST_ASSERT_EQUAL_MESSAGE(0, hostAllocations - hostBefore, "d_malloc() while syncing");
+  TEST_ASSERT_EQUAL(count, result.pushed + result.refused);
+  TEST_ASSERT_EQUAL_MESSAGE(result.refused, dropped, "refused packets not counted as dropped");
+  TEST_ASSERT_EQUAL_MESSAGE(result.pushed, syncs + stops, "pushed packets lost");
+}
+
+// 5000 packets/s, far above the 40 FPP sends; a few may still be dropped
+// when the scheduler holds loop() back for more than 15 packets
+static void test_paced_sync_packets(void) {
+  runStress(10000, std::chrono::microseconds(200), "paced");
+}
+
+// as fast as the producer can: packets beyond the queue are dropped and
+// counted, the rest still arrive whole and in order
+static void test_flooded_sync_packets(void) {
+  runStress(200000, std::chrono::microseconds(0), "flood");
+}
+
+// blank packets stop the sequence without a frame number
+static void test_blank_packets(void) {
+  const uint32_t before = stops;
+  TEST_ASSERT_TRUE(FSEQSyncQueue::pushBlank());
+  TEST_ASSERT_TRUE(FSEQSyncQueue::pushBlank());
+  FSEQSyncQueue::handle();
+  TEST_ASSERT_EQUAL(before + 2, stops);
+  TEST_ASSERT_EQUAL(0, syncs);
+}
+
+// media sync packets and packets without a file name are not queued
+static void test_malformed_packets(void) {
+  uint8_t packet[96];
+  size_t length = makeSyncPacket(packet, SYNC_PKT_SYNC, 1, "song.mp3");
+  packet[8] = SYNC_FILE_MEDIA;
+  TEST_ASSERT_FALSE(FSEQSyncQueue::pushSync(packet, length));
+  makeSyncPacket(packet, SYNC_PKT_SYNC, 1, "");
+  TEST_ASSERT_FALSE(FSEQSyncQueue::pushSync(packet, 17));
+  FSEQSyncQueue::handle();
+  TEST_ASSERT_EQUAL(0, syncs + stops);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_paced_sync_packets);
+  RUN_TEST(test_flooded_sync_packets);
+  RUN_TEST(test_blank_packets);
+  RUN_TEST(test_malformed_packets);
+  return UNITY_END();
+}
@@ -0,0 +1,119 @@
+// Upload throughput (FSEQUploadWriter in usermods/FSEQ/fseq_upload.cpp): the
+// web task hands 100 MB to write() in TCP segments while the writer task
+// puts the chunks on an in-memory card that takes as long as an SD card
+// writing about 8 MB/s, with a stall now and then. The client stops sending
+// while the writer keeps the receive window closed. The file must arrive
+// intact, and the benchmark prints the sustained MB/s next to what the
+// modeled card allows.
+//
+//   pio test -e native -f test_upload_writer -v
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <unity.h>
+
+#include "fseq_cache.cpp"
+#include "fseq_decoder.cpp"
+#include "fseq_flash.cpp"
+#include "fseq_header.cpp"
+#include "fseq_index.cpp"
+#include "fseq_io.cpp"
+#include "fseq_manager.cpp"
+#include "fseq_metrics.cpp"
+#include "fseq_player.cpp"
+#include "fseq_upload.cpp"
+#include "sd_manager.cpp"
+
+static const uint32_t UPLOAD_BYTES = 100000000;
+static const size_t SEGMENT = 1436; // TCP payload of a 1500 byte MTU
+
+static uint8_t byteAt(uint32_t pos) { return pos * 2654435761u >> 24; }
+
+// --- SD card delay --------------------------------------------------------------
+
+// a write costs a command round trip plus 10 bytes per us, every 256th
+// write waits 20 ms for the card to allocate and erase; the writer task
+// sleeps meanwhile, like it waits for the SPI / SDMMC DMA on the ESP32
+static std::atomic<uint64_t> cardModelUs{0}; // modeled write time
+static std::atomic<uint64_t> cardBusyUs{0};  // slept, with the host's overshoot
+static std::atomic<uint32_t> cardWrites{0};
+
+static void sdCardDelay(bool write, size_t pos, size_t len) {
+  if (!write)
+    return;
+  uint32_t us = 150 + len / 10;
+  if (++cardWrites % 256 == 0)
+    us += 20000;
+  cardModelUs += us;
+  const int64_t start = esp_timer_get_time();
+  std::this_thread::sleep_for(std::chrono::microseconds(us));
+  cardBusyUs += esp_timer_get_time() - start;
+}
+
+void setUp(void) {
+  // what UsermodFseq::setup() creates, commit() updates the index and cache
+  FSEQFileIndex::begin();
+  FSEQSequenceCache::begin();
+  cardModelUs = 0;
+  cardBusyUs = 0;
+  cardWrites = 0;
+  SD.delay = sdCardDelay;
+}
+void tearDown(void) { SD.delay = nullptr; }
+
+// the web task: body callbacks of one upload request, a segment at a time;
+// while the window is held the client has nothing in flight
+static void test_upload_100mb(void) {
+  AsyncWebServerRequest request;
+  uint8_t segment[SEGMENT];
+  uint32_t throttled = 0;
+
+  auto t0 = std::chrono::steady_clock::now();
+  TEST_ASSERT_TRUE(FSEQUploadWriter::begin("/big.fseq", &request));
+  for (uint32_t pos = 0; pos < UPLOAD_BYTES; pos += SEGMENT) {
+    if (request.tcp.held) {
+      throttled++;
+      while (request.tcp.held)
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    const size_t len = std::min(SEGMENT, (size_t)(UPLOAD_BYTES - pos));
+    for (size_t i = 0; i < len; i++)
+      segment[i] = byteAt(pos + i);
+    TEST_ASSERT_TRUE_MESSAGE(FSEQUploadWriter::write(segment, len), "write() failed");
+  }
+  TEST_ASSERT_TRUE(FSEQUploadWriter::end());
+  while (FSEQUploadWriter::getResult("/big.fseq") == FSEQUploadWriter::WRITING)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  auto t1 = std::chrono::steady_clock::now();
+
+  const double seconds = std::chrono::duration<double>(t1 - t0).count();
+  const double mb = UPLOAD_BYTES / 1e6;
+  char msg[200];
+  snprintf(msg, sizeof(msg),
+           "%.0f MB in %.2f s: %.2f MB/s sustained (getLastRate() %.2f MB/s), "
+           "modeled card %.2f MB/s, card busy %.0f%% of the time, %u writes, "
+           "window closed %u times",
+           mb, seconds, mb / seconds, FSEQUploadWriter::getLastRate() / 1e6,
+           mb / (cardModelUs / 1e6), cardBusyUs / 1e4 / seconds,
+           (unsigned)cardWrites, (unsigned)throttled);
+  TEST_MESSAGE(msg);
+
+  TEST_ASSERT_EQUAL(FSEQUploadWriter::DONE, FSEQUploadWriter::getResult("/big.fseq"));
+  TEST_ASSERT_FALSE(SD.exists("/big.fseq" FSEQ_UPLOAD_TEMP_SUFFIX));
+  auto data = SD.contents("/big.fseq");
+  TEST_ASSERT_NOT_NULL(data);
+  TEST_ASSERT_EQUAL(UPLOAD_BYTES, data->size());
+  for (uint32_t pos = 0; pos < UPLOAD_BYTES; pos++)
+    if ((*data)[pos] != byteAt(pos))
+      TEST_FAIL_MESSAGE("uploaded file differs");
+  // the chunk queue keeps the card busy while the client waits for the window
+  TEST_ASSERT_TRUE_MESSAGE(cardBusyUs / 1e6 > seconds * 0.9, "card idle for more than 10% of the upload");
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_upload_100mb);
+  return UNITY_END();
+}
@@ -0,0 +1,303 @@
+#include "fseq_cache.h"
+#include "fseq_flash.h"
+#include "fseq_metrics.h"
+#include "usermod_fseq.h"
+
+void FSEQCachedFile::attach(File f, uint8_t *prefixData, uint32_t length) {
+  close();
+  file = f;
+  prefix = prefixData;
+  prefixLength = length;
+  pos = 0;
+  fileSize = file ? file.size() : 0;
+  // a cache that was filled has moved the SD file away from 0
+  seekPending = prefixLength > 0;
+}
+
+void FSEQCachedFile::attachMapped(const uint8_t *data, uint32_t size,
+                                  spi_flash_mmap_handle_t handle) {
+  close();
+  prefix = data;
+  prefixLength = size;
+  fileSize = size;
+  mapped = true;
+  mapHandle = handle;
+}
+
+void FSEQCachedFile::close() {
+  if (file)
+    file.close();
+  file = File();
+#if FSEQ_SEEK_ANCHORS > 0
+  for (File &anchor : anchors) {
+    if (anchor)
+      anchor.close();
+    anchor = File();
+  }
+#endif
+  anchorsFailed = false;
+  if (mapped)
+    FSEQFlashStore::unmap(mapHandle);
+  else if (prefix)
+    p_free(const_cast<uint8_t *>(prefix));
+  prefix = nullptr;
+  mapped = false;
+  prefixLength = 0;
+  pos = 0;
+  fileSize = 0;
+  seekPending = false;
+}
+
+size_t FSEQCachedFile::read(uint8_t *dst, size_t len) {
+  size_t done = 0;
+  if (pos < prefixLength) {
+    done = min(len, (size_t)(prefixLength - pos));
+    memcpy(dst, prefix + pos, done);
+    pos += done;
+    seekPending = true;
+  }
+  if (done < len && file) {
+    if (seekPending) {
+      takeAnchor(pos);
+      if (!file.seek(pos))
+        return done;
+      seekPending = false;
+    }
+    size_t got = file.read(dst + done, len - done);
+    FSEQMetrics::bytesRead += got;
+    pos += got;
+    done += got;
+  }
+  return done;
+}
+
+int FSEQCachedFile::read() {
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+bool FSEQCachedFile::seek(uint32_t newPos) {
+  if (newPos > fileSize)
+    return false;
+  if (newPos != pos) {
+    pos = newPos;
+    seekPending = true;
+  }
+  return true;
+}
+
+// swap in the anchor the FAT walk to target is shortest from, the current
+// handle is parked in its place
+void FSEQCachedFile::takeAnchor(uint32_t target) {
+#if FSEQ_SEEK_ANCHORS > 0
+  uint32_t from = file.position();
+  if (from > target)
+    from = 0; // backwards, walks from the start
+  int8_t best = -1;
+  for (uint8_t i = 0; i < FSEQ_SEEK_ANCHORS; i++) {
+    if (!anchors[i])
+      continue;
+    uint32_t at = anchors[i].position();
+    if (at <= target && at > from) {
+      from = at;
+      best = i;
+    }
+  }
+  if (best >= 0)
+    std::swap(file, anchors[best]);
+#endif
+}
+
+bool FSEQCachedFile::buildSeekIndex() {
+#if FSEQ_SEEK_ANCHORS > 0
+  if (!file || mapped || anchorsFailed ||
+      fileSize < FSEQ_SEEK_INDEX_MIN_KB * 1024)
+    return false;
+  uint32_t spacing = fileSize / (FSEQ_SEEK_ANCHORS + 1);
+  for (uint8_t i = 0; i < FSEQ_SEEK_ANCHORS; i++) {
+    uint32_t offset = spacing * (i + 1);
+    if (!anchors[i]) {
+      anchors[i] = SD_ADAPTER.open(file.path(), FILE_READ);
+      if (!anchors[i]) {
+        DEBUG_PRINTLN(F("[FSEQ] Seek index: no file handle left"));
+        anchorsFailed = true;
+        return false;
+      }
+      return true;
+    }
+    // seeks leave handles anywhere, put them back in place one at a time
+    uint32_t at = anchors[i].position();
+    if (at + spacing / 2 < offset || at > offset + spacing / 2) {
+      anchors[i].seek(offset);
+      return true;
+    }
+  }
+#endif
+  return false;
+}
+
+uint8_t FSEQCachedFile::getSeekAnchors() const {
+  uint8_t count = 0;
+#if FSEQ_SEEK_ANCHORS > 0
+  for (const File &anchor : anchors)
+    count += (bool)anchor;
+#endif
+  return count;
+}
+
+volatile uint32_t FSEQSequenceCache::budget = FSEQ_CACHE_DEFAULT_KB * 1024;
+uint32_t FSEQSequenceCache::activeBudget = FSEQ_CACHE_DEFAULT_KB * 1024;
+QueueHandle_t FSEQSequenceCache::requests = nullptr;
+volatile bool FSEQSequenceCache::invalidateAll = false;
+portMUX_TYPE FSEQSequenceCache::nameLock = portMUX_INITIALIZER_UNLOCKED;
+char FSEQSequenceCache::fileName[FSEQ_CACHE_PATH_LEN] = "";
+bool FSEQSequenceCache::pending = false;
+File FSEQSequenceCache::file;
+uint8_t *FSEQSequenceCache::data = nullptr;
+volatile uint32_t FSEQSequenceCache::length = 0;
+volatile uint32_t FSEQSequenceCache::target = 0;
+uint32_t FSEQSequenceCache::hits = 0;
+uint32_t FSEQSequenceCache::misses = 0;
+
+void FSEQSequenceCache::begin() {
+  if (!requests)
+    requests = xQueueCreate(FSEQ_CACHE_QUEUE_SIZE, sizeof(Request));
+}
+
+String FSEQSequenceCache::getFileName() {
+  char name[FSEQ_CACHE_PATH_LEN];
+  portENTER_CRITICAL(&nameLock);
+  strcpy(name, fileName);
+  portEXIT_CRITICAL(&nameLock);
+  return String(name);
+}
+
+void FSEQSequenceCache::setFileName(const char *name) {
+  portENTER_CRITICAL(&nameLock);
+  strlcpy(fileName, name, sizeof(fileName));
+  portEXIT_CRITICAL(&nameLock);
+}
+
+// loop() only
+void FSEQSequenceCache::clear() {
+  if (file)
+    file.close();
+  file = File();
+  if (data)
+    p_free(data);
+  data = nullptr;
+  length = 0;
+  target = 0;
+  pending = false;
+  setFileName("");
+}
+
+bool FSEQSequenceCache::makeRequest(const char *filepath, bool invalidate,
+                                    Request &request) {
+  request.invalidate = invalidate;
+  size_t pos = 0;
+  if (filepath[0] != '/')
+    request.fileName[pos++] = '/';
+  if (strlen(filepath) + pos >= sizeof(request.fileName))
+    return false;
+  strcpy(request.fileName + pos, filepath);
+  return true;
+}
+
+// only queues the file, SD access happens in handleWarmup()
+bool FSEQSequenceCache::warm(const char *filepath) {
+  Request request;
+  if (budget == 0 || !requests || !makeRequest(filepath, false, request))
+    return false;
+  return xQueueSend(requests, &request, 0) == pdTRUE;
+}
+
+void FSEQSequenceCache::invalidate(const char *filepath) {
+  Request request;
+  // an invalidation must not get lost, drop everything instead
+  if (!requests || !makeRequest(filepath, true, request) ||
+      xQueueSend(requests, &request, 0) != pdTRUE)
+    invalidateAll = true;
+}
+
+// loop(): the only place the cached file and buffer change hands
+void FSEQSequenceCache::applyRequests() {
+  if (budget != activeBudget || invalidateAll) {
+    invalidateAll = false;
+    activeBudget = budget;
+    clear();
+  }
+  Request request;
+  while (requests && xQueueReceive(requests, &request, 0) == pdTRUE) {
+    if (strcmp(request.fileName, fileName) == 0) {
+      if (request.invalidate)
+        clear();
+    } else if (!request.invalidate && activeBudget > 0) {
+      clear();
+      setFileName(request.fileName);
+      pending = true;
+    }
+  }
+}
+
+void FSEQSequenceCache::handleWarmup(uint32_t budgetUs) {
+  applyRequests();
+  if (pending) {
+    pending = false;
+    if (SD_ADAPTER.cardType() == CARD_NONE || !SD_ADAPTER.exists(fileName)) {
+      DEBUG_PRINTF("[FSEQ] Cache: %s not found\n", fileName);
+      clear();
+      return;
+    }
+    file = SD_ADAPTER.open(fileName, "rb");
+    if (!file) {
+      clear();
+      return;
+    }
+    uint32_t size = min((uint32_t)file.size(), activeBudget);
+    data = static_cast<uint8_t *>(p_malloc(size));
+    if (!data) {
+      DEBUG_PRINTF("[FSEQ] Cache: failed to allocate %u bytes\n", size);
+      clear();
+      return;
+    }
+    length = 0;
+    target = size;
+    return; // opening used this iteration's time
+  }
+
+  if (!file || !data || length >= target)
+    return;
+  uint32_t start = micros();
+  do {
+    uint32_t want = min(target - length, (uint32_t)FSEQ_READ_CHUNK_SIZE);
+    size_t got = file.read(data + length, want);
+    length += got;
+    if (got < want) {
+      target = length; // file shorter than reported, keep what we have
+      break;
+    }
+  } while (length < target && micros() - start < budgetUs);
+  if (length >= target)
+    DEBUG_PRINTF("[FSEQ] Cached %u bytes of %s\n", length, fileName);
+}
+
+bool FSEQSequenceCache::take(const char *filepath, FSEQCachedFile &dst) {
+  applyRequests(); // a pending invalidation must not hand out stale data
+  Request request;
+  if (activeBudget == 0 || !makeRequest(filepath, false, request))
+    return false;
+  bool match = strcmp(request.fileName, fileName) == 0;
+  if (!match || pending || !file) {
+    misses++;
+    if (match)
+      clear(); // not opened yet, the player opens it itself
+    return false;
+  }
+  hits++;
+  dst.attach(file, data, length);
+  file = File();
+  data = nullptr; // owned by dst now
+  clear();
+  return true;
+}
@@ -0,0 +1,158 @@
+#ifndef FSEQ_CACHE_H
+#define FSEQ_CACHE_H
+
+#include "wled.h"
+#include <esp_partition.h>
+
+// default memory for the next-sequence cache (KB), 0 disables it
+#ifndef FSEQ_CACHE_DEFAULT_KB
+#ifdef BOARD_HAS_PSRAM
+#define FSEQ_CACHE_DEFAULT_KB 512
+#else
+#define FSEQ_CACHE_DEFAULT_KB 32
+#endif
+#endif
+
+// longest path the cache and flash store requests carry
+#ifndef FSEQ_CACHE_PATH_LEN
+#define FSEQ_CACHE_PATH_LEN 128
+#endif
+// warm / invalidate requests waiting for loop()
+#ifndef FSEQ_CACHE_QUEUE_SIZE
+#define FSEQ_CACHE_QUEUE_SIZE 4
+#endif
+
+// extra handles of an open sequence parked along the file for far seeks,
+// each one holds an SD file handle while the sequence plays and is counted
+// in FSEQ_SD_MAX_FILES; 0 disables
+#ifndef FSEQ_SEEK_ANCHORS
+#define FSEQ_SEEK_ANCHORS 2
+#endif
+// smaller files are seeked fast enough from their start
+#ifndef FSEQ_SEEK_INDEX_MIN_KB
+#define FSEQ_SEEK_INDEX_MIN_KB 1024
+#endif
+
+// Open sequence file whose first bytes may already be in memory. Reads
+// below the cached length are served from RAM, the SD file is only seeked
+// and read once data past the cached part is needed. A sequence mapped from
+// the flash partition is in memory as a whole and has no file behind it.
+//
+// Seeking an SD file walks the FAT cluster chain from the current position,
+// or from the start of the file when going backwards, which takes tens of
+// milliseconds in a large sequence. The seek index parks further handles of
+// the file at evenly spaced offsets; a seek continues from the handle
+// closest before the target, so no walk is longer than the distance between
+// two anchors.
+class FSEQCachedFile {
+public:
+  FSEQCachedFile() {}
+
+  // takes ownership of prefix (p_malloc'd, may be nullptr)
+  void attach(File f, uint8_t *prefix = nullptr, uint32_t prefixLength = 0);
+  // whole file mapped from flash, unmapped again on close()
+  void attachMapped(const uint8_t *data, uint32_t size,
+                    spi_flash_mmap_handle_t handle);
+  void close();
+
+  size_t read(uint8_t *dst, size_t len);
+  int read();
+  bool seek(uint32_t pos);
+  uint32_t position() const { return pos; }
+  uint32_t size() const { return fileSize; }
+  int available() const { return pos < fileSize ? fileSize - pos : 0; }
+  uint32_t cachedBytes() const { return prefixLength; }
+  bool isMapped() const { return mapped; }
+  // direct pointer to len bytes at offset if they are in memory
+  const uint8_t *peek(uint32_t offset, uint32_t len) const {
+    return (uint64_t)offset + len <= prefixLength ? prefix + offset : nullptr;
+  }
+  explicit operator bool() const { return mapped || (bool)file; }
+
+  // open or re-park one anchor of the seek index, called while playback has
+  // read slack; returns false once there is nothing left to do
+  bool buildSeekIndex();
+  uint8_t getSeekAnchors() const;
+
+private:
+  void takeAnchor(uint32_t target);
+
+  File file;
+#if FSEQ_SEEK_ANCHORS > 0
+  File anchors[FSEQ_SEEK_ANCHORS];
+#endif
+  bool anchorsFailed = false; // out of file handles, index stays as it is
+  const uint8_t *prefix = nullptr;
+  bool mapped = false;
+  spi_flash_mmap_handle_t mapHandle = 0;
+  uint32_t prefixLength = 0;
+  uint32_t pos = 0;
+  uint32_t fileSize = 0;
+  bool seekPending = false; // SD file position differs from pos
+};
+
+// Keeps the header and first frames of the sequence that is going to be
+// played next, so starting it does not wait for opening and reading the
+// file. The cache is filled from loop() while playback has time to spare.
+// warm(), invalidate() and setBudget() may be called from other tasks (web
+// server, upload writer); they only queue a request, the file and buffer
+// are opened, read and freed by loop() alone.
+class FSEQSequenceCache {
+public:
+  // setup(): create the request queue
+  static void begin();
+
+  // takes effect with the next handleWarmup()
+  static void setBudget(uint32_t bytes) { budget = bytes; }
+  static uint32_t getBudget() { return budget; }
+
+  // queue a file to be cached, false if the cache is disabled, the path is
+  // too long or the queue is full
+  static bool warm(const char *filepath);
+  // loop(): apply the requests, open / read the queued file, spending at
+  // most budgetUs
+  static void handleWarmup(uint32_t budgetUs);
+  // loop(): hand the cached file over to dst if it is filepath (counts hit /
+  // miss)
+  static bool take(const char *filepath, FSEQCachedFile &dst);
+  // drop the cached data of filepath (file changed or deleted)
+  static void invalidate(const char *filepath);
+  // loop(): close the file and drop the data, before the card is unmounted
+  static void end() { clear(); }
+
+  static String getFileName();
+  static uint32_t getCachedBytes() { return length; }
+  static bool isReady() { return target > 0 && length >= target; }
+  static uint32_t getHits() { return hits; }
+  static uint32_t getMisses() { return misses; }
+
+private:
+  FSEQSequenceCache() {}
+
+  struct Request {
+    bool invalidate;
+    char fileName[FSEQ_CACHE_PATH_LEN]; // with leading '/'
+  };
+
+  static bool makeRequest(const char *filepath, bool invalidate,
+                          Request &request);
+  static void applyRequests();
+  static void setFileName(const char *name);
+  static void clear();
+
+  static volatile uint32_t budget;
+  static uint32_t activeBudget;       // budget the cached data was sized with
+  static QueueHandle_t requests;
+  static volatile bool invalidateAll; // an invalidation did not fit the queue
+  static portMUX_TYPE nameLock;       // fileName is read by the status page
+  static char fileName[FSEQ_CACHE_PATH_LEN]; // with leading '/'
+  static bool pending;    // fileName still has to be opened
+  static File file;
+  static uint8_t *data;
+  static volatile uint32_t length; // bytes cached so far
+  static volatile uint32_t target; // bytes to cache, min(file size, budget)
+  static uint32_t hits;
+  static uint32_t misses;
+};
+
+#endif // FSEQ_CACHE_H
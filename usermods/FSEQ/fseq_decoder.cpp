@@ -0,0 +1,194 @@
+#include "fseq_decoder.h"
+
+bool FSEQBlockDecoder::isSupported(uint8_t compressionType) {
+  switch (compressionType) {
+  case FSEQ_COMPRESSION_NONE:
+    return true;
+#ifdef FSEQ_HAVE_ZLIB
+  case FSEQ_COMPRESSION_ZLIB:
+    return true;
+#endif
+#ifdef FSEQ_HAVE_ZSTD
+  case FSEQ_COMPRESSION_ZSTD:
+    return true;
+#endif
+  default:
+    return false;
+  }
+}
+
+bool FSEQBlockDecoder::begin(uint8_t compressionType) {
+  end();
+  if (compressionType == FSEQ_COMPRESSION_NONE ||
+      !isSupported(compressionType))
+    return false;
+  type = compressionType;
+
+  input = static_cast<uint8_t *>(p_malloc(FSEQ_DECODER_INPUT_SIZE));
+  bool ok = input != nullptr;
+
+#ifdef FSEQ_HAVE_ZLIB
+  if (type == FSEQ_COMPRESSION_ZLIB) {
+    inflator = static_cast<tinfl_decompressor *>(
+        p_malloc(sizeof(tinfl_decompressor)));
+    dict = static_cast<uint8_t *>(p_malloc(TINFL_LZ_DICT_SIZE));
+    ok = ok && inflator && dict;
+  }
+#endif
+#ifdef FSEQ_HAVE_ZSTD
+  if (type == FSEQ_COMPRESSION_ZSTD) {
+    zstream = ZSTD_createDStream();
+    scratch = static_cast<uint8_t *>(p_malloc(FSEQ_DECODER_INPUT_SIZE));
+    ok = ok && zstream && scratch;
+  }
+#endif
+
+  if (!ok) {
+    DEBUG_PRINTLN(F("[FSEQ] Decoder buffer allocation failed"));
+    end();
+  }
+  return ok;
+}
+
+void FSEQBlockDecoder::end() {
+  if (input)
+    p_free(input);
+  input = nullptr;
+#ifdef FSEQ_HAVE_ZLIB
+  if (inflator)
+    p_free(inflator);
+  if (dict)
+    p_free(dict);
+  inflator = nullptr;
+  dict = nullptr;
+#endif
+#ifdef FSEQ_HAVE_ZSTD
+  if (zstream)
+    ZSTD_freeDStream(zstream);
+  if (scratch)
+    p_free(scratch);
+  zstream = nullptr;
+  scratch = nullptr;
+#endif
+  type = FSEQ_COMPRESSION_NONE;
+  finished = true;
+}
+
+bool FSEQBlockDecoder::startBlock(FSEQCachedFile &file, uint32_t offset,
+                                  uint32_t length) {
+  finished = true;
+  if (!input || !file.seek(offset))
+    return false;
+  remaining = length;
+  inputPos = 0;
+  inputLen = 0;
+
+#ifdef FSEQ_HAVE_ZLIB
+  if (type == FSEQ_COMPRESSION_ZLIB) {
+    tinfl_init(inflator);
+    dictPos = 0;
+    dictOfs = 0;
+    dictAvail = 0;
+  }
+#endif
+#ifdef FSEQ_HAVE_ZSTD
+  if (type == FSEQ_COMPRESSION_ZSTD)
+    ZSTD_initDStream(zstream);
+#endif
+
+  finished = false;
+  return true;
+}
+
+bool FSEQBlockDecoder::fillInput(FSEQCachedFile &file) {
+  size_t want = min(remaining, (uint32_t)FSEQ_DECODER_INPUT_SIZE);
+  if (want == 0)
+    return false;
+  size_t got = file.read(input, want);
+  if (got == 0)
+    return false;
+  remaining -= got;
+  inputPos = 0;
+  inputLen = got;
+  return true;
+}
+
+size_t FSEQBlockDecoder::read(FSEQCachedFile &file, uint8_t *dst,
+                              size_t len) {
+  size_t done = 0;
+
+#ifdef FSEQ_HAVE_ZLIB
+  if (type == FSEQ_COMPRESSION_ZLIB) {
+    while (done < len) {
+      if (dictAvail > 0) {
+        size_t n = min(dictAvail, len - done);
+        if (dst)
+          memcpy(dst + done, dict + dictOfs, n);
+        dictOfs += n;
+        dictAvail -= n;
+        done += n;
+        continue;
+      }
+      if (finished)
+        break;
+      if (inputPos >= inputLen && remaining > 0 && !fillInput(file)) {
+        DEBUG_PRINTLN(F("[FSEQ] Read error in compressed block"));
+        finished = true;
+        break;
+      }
+
+      size_t inBytes = inputLen - inputPos;
+      size_t outBytes = TINFL_LZ_DICT_SIZE - dictPos;
+      mz_uint32 flags = TINFL_FLAG_PARSE_ZLIB_HEADER;
+      if (remaining > 0)
+        flags |= TINFL_FLAG_HAS_MORE_INPUT;
+      tinfl_status status =
+          tinfl_decompress(inflator, input + inputPos, &inBytes, dict,
+                           dict + dictPos, &outBytes, flags);
+      inputPos += inBytes;
+      dictOfs = dictPos;
+      dictAvail = outBytes;
+      dictPos = (dictPos + outBytes) & (TINFL_LZ_DICT_SIZE - 1);
+
+      if (status <= TINFL_STATUS_DONE) {
+        if (status < TINFL_STATUS_DONE)
+          DEBUG_PRINTF("[FSEQ] zlib block corrupt (%d)\n", (int)status);
+        finished = true;
+      }
+    }
+  }
+#endif
+
+#ifdef FSEQ_HAVE_ZSTD
+  if (type == FSEQ_COMPRESSION_ZSTD) {
+    while (done < len && !finished) {
+      if (inputPos >= inputLen && remaining > 0 && !fillInput(file)) {
+        DEBUG_PRINTLN(F("[FSEQ] Read error in compressed block"));
+        finished = true;
+        break;
+      }
+
+      ZSTD_inBuffer in = {input + inputPos, inputLen - inputPos, 0};
+      ZSTD_outBuffer out = {dst ? dst + done : scratch,
+                            dst ? len - done
+                                : min(len - done,
+                                      (size_t)FSEQ_DECODER_INPUT_SIZE),
+                            0};
+      size_t ret = ZSTD_decompressStream(zstream, &out, &in);
+      inputPos += in.pos;
+      done += out.pos;
+
+      if (ZSTD_isError(ret)) {
+        DEBUG_PRINTF("[FSEQ] zstd block corrupt (%s)\n",
+                     ZSTD_getErrorName(ret));
+        finished = true;
+      } else if (ret == 0 ||
+                 (out.pos == 0 && inputPos >= inputLen && remaining == 0)) {
+        finished = true; // end of frame or no way to make progress
+      }
+    }
+  }
+#endif
+
+  return done;
+}
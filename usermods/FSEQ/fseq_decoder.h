@@ -0,0 +1,72 @@
+#ifndef FSEQ_DECODER_H
+#define FSEQ_DECODER_H
+
+#include "fseq_cache.h"
+#include "wled.h"
+
+// zlib blocks are inflated with the miniz copy in the ESP32 ROM
+#if __has_include(<rom/miniz.h>)
+#include <rom/miniz.h>
+#define FSEQ_HAVE_ZLIB
+#elif __has_include(<esp32/rom/miniz.h>)
+#include <esp32/rom/miniz.h>
+#define FSEQ_HAVE_ZLIB
+#endif
+
+// zstd blocks need a zstd library in the build (e.g. added via lib_deps)
+#if __has_include(<zstd.h>)
+#include <zstd.h>
+#define FSEQ_HAVE_ZSTD
+#endif
+
+#define FSEQ_COMPRESSION_NONE 0
+#define FSEQ_COMPRESSION_ZSTD 1
+#define FSEQ_COMPRESSION_ZLIB 2
+
+// compressed bytes read from SD at once
+#ifndef FSEQ_DECODER_INPUT_SIZE
+#define FSEQ_DECODER_INPUT_SIZE 2048
+#endif
+
+// Streaming decompressor for the frame blocks of compressed FSEQ v2 files.
+// All buffers have a fixed size, memory use does not grow with the block
+// or file size.
+class FSEQBlockDecoder {
+public:
+  FSEQBlockDecoder() {}
+  ~FSEQBlockDecoder() { end(); }
+
+  static bool isSupported(uint8_t compressionType);
+
+  bool begin(uint8_t compressionType);
+  void end();
+  // start decoding the block stored at offset (length compressed bytes)
+  bool startBlock(FSEQCachedFile &file, uint32_t offset,
+                  uint32_t length);
+  // read up to len decompressed bytes, dst may be nullptr to skip data
+  size_t read(FSEQCachedFile &file, uint8_t *dst, size_t len);
+
+private:
+  bool fillInput(FSEQCachedFile &file);
+
+  uint8_t type = FSEQ_COMPRESSION_NONE;
+  uint8_t *input = nullptr;
+  size_t inputPos = 0;
+  size_t inputLen = 0;
+  uint32_t remaining = 0; // compressed bytes of the block still on SD
+  bool finished = true;
+
+#ifdef FSEQ_HAVE_ZLIB
+  tinfl_decompressor *inflator = nullptr;
+  uint8_t *dict = nullptr; // TINFL_LZ_DICT_SIZE output window
+  size_t dictPos = 0;      // next write position in dict
+  size_t dictOfs = 0;      // first decoded byte not yet returned
+  size_t dictAvail = 0;    // decoded bytes not yet returned
+#endif
+#ifdef FSEQ_HAVE_ZSTD
+  ZSTD_DStream *zstream = nullptr;
+  uint8_t *scratch = nullptr; // sink for skipped data
+#endif
+};
+
+#endif // FSEQ_DECODER_H
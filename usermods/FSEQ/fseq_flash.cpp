@@ -0,0 +1,210 @@
+#include "fseq_flash.h"
+#include "fseq_manager.h"
+#include "usermod_fseq.h"
+
+QueueHandle_t FSEQFlashStore::request = nullptr;
+TaskHandle_t FSEQFlashStore::task = nullptr;
+char FSEQFlashStore::pendingName[FSEQ_CACHE_PATH_LEN] = "";
+volatile bool FSEQFlashStore::copying = false;
+volatile bool FSEQFlashStore::running = false;
+volatile bool FSEQFlashStore::paused = false;
+volatile bool FSEQFlashStore::cancel = false;
+File FSEQFlashStore::source;
+uint8_t *FSEQFlashStore::buffer = nullptr;
+uint32_t FSEQFlashStore::copySize = 0;
+uint32_t FSEQFlashStore::copied = 0;
+uint32_t FSEQFlashStore::erased = 0;
+uint8_t FSEQFlashStore::mapCount = 0;
+
+const esp_partition_t *FSEQFlashStore::partition() {
+  static const esp_partition_t *part = esp_partition_find_first(
+      ESP_PARTITION_TYPE_DATA, (esp_partition_subtype_t)FSEQ_PARTITION_SUBTYPE,
+      FSEQ_PARTITION_LABEL);
+  return part;
+}
+
+bool FSEQFlashStore::readStoreHeader(StoreHeader &header) {
+  const esp_partition_t *part = partition();
+  if (!part || esp_partition_read(part, 0, &header, sizeof(header)) != ESP_OK)
+    return false;
+  header.name[sizeof(header.name) - 1] = '\0';
+  return header.magic == STORE_MAGIC && header.size > 0 &&
+         header.size <= part->size - DATA_OFFSET;
+}
+
+String FSEQFlashStore::getFileName() {
+  StoreHeader header;
+  return readStoreHeader(header) ? String(header.name) : String();
+}
+
+uint32_t FSEQFlashStore::getFileSize() {
+  StoreHeader header;
+  return readStoreHeader(header) ? header.size : 0;
+}
+
+void FSEQFlashStore::begin() {
+  if (!request)
+    request = xQueueCreate(1, FSEQ_CACHE_PATH_LEN);
+  if (request && !task && isAvailable())
+    xTaskCreatePinnedToCore(copyTask, "fseqFlash", 4096, nullptr, 1, &task,
+                            tskNO_AFFINITY);
+}
+
+// only posts the file, flash is written by the copy task
+bool FSEQFlashStore::store(const char *filepath) {
+  char name[FSEQ_CACHE_PATH_LEN];
+  size_t pos = 0;
+  if (filepath[0] != '/')
+    name[pos++] = '/';
+  if (!task || strlen(filepath) + pos >= sizeof(name))
+    return false;
+  strcpy(name + pos, filepath);
+  xQueueOverwrite(request, name);
+  copying = true;
+  return true;
+}
+
+bool FSEQFlashStore::beginCopy() {
+  const esp_partition_t *part = partition();
+  if (SD_ADAPTER.cardType() != CARD_NONE &&
+      SD_ADAPTER.exists(pendingName))
+    source = SD_ADAPTER.open(pendingName, "rb");
+  else if (WLED_FS.exists(pendingName))
+    source = WLED_FS.open(pendingName, "r");
+  if (!source) {
+    DEBUG_PRINTF("[FSEQ] Flash: %s not found\n", pendingName);
+    return false;
+  }
+  copySize = source.size();
+  if (copySize == 0 || copySize > part->size - DATA_OFFSET) {
+    DEBUG_PRINTF("[FSEQ] Flash: %s does not fit (%u of %u bytes)\n",
+                 pendingName, copySize, part->size - DATA_OFFSET);
+    return false;
+  }
+  buffer = static_cast<uint8_t *>(d_malloc(SPI_FLASH_SEC_SIZE));
+  if (!buffer)
+    return false;
+  // the old sequence is invalid from here on, its header is written last
+  if (esp_partition_erase_range(part, 0, SPI_FLASH_SEC_SIZE) != ESP_OK)
+    return false;
+  copied = 0;
+  erased = DATA_OFFSET;
+  DEBUG_PRINTF("[FSEQ] Flash: storing %s (%u bytes)\n", pendingName,
+               copySize);
+  return true;
+}
+
+void FSEQFlashStore::endCopy() {
+  if (source)
+    source.close();
+  source = File();
+  if (buffer)
+    d_free(buffer);
+  buffer = nullptr;
+}
+
+// erase up to the next FSEQ_FLASH_ERASE_SIZE boundary if the data is not
+// erased yet, then copy what is erased; false when done or failed
+bool FSEQFlashStore::copyStep() {
+  const esp_partition_t *part = partition();
+  uint32_t offset = DATA_OFFSET + copied;
+  if (offset >= erased) {
+    uint32_t end = DATA_OFFSET + copySize;
+    end = (end + SPI_FLASH_SEC_SIZE - 1) & ~(SPI_FLASH_SEC_SIZE - 1);
+    uint32_t size = min(FSEQ_FLASH_ERASE_SIZE - erased % FSEQ_FLASH_ERASE_SIZE,
+                        end - erased);
+    if (esp_partition_erase_range(part, erased, size) != ESP_OK) {
+      DEBUG_PRINTLN(F("[FSEQ] Flash: erase failed"));
+      return false;
+    }
+    erased += size;
+  }
+  uint32_t want = min(copySize - copied,
+                      min(erased - offset, (uint32_t)SPI_FLASH_SEC_SIZE));
+  size_t got = source.read(buffer, want);
+  if (got == 0 || esp_partition_write(part, offset, buffer, got) != ESP_OK) {
+    DEBUG_PRINTLN(F("[FSEQ] Flash: copy failed"));
+    return false;
+  }
+  copied += got;
+  if (copied < copySize)
+    return true;
+
+  StoreHeader header = {STORE_MAGIC, copySize, {}};
+  strlcpy(header.name, pendingName, sizeof(header.name));
+  esp_partition_write(part, 0, &header, sizeof(header));
+  DEBUG_PRINTF("[FSEQ] Flash: stored %s\n", header.name);
+  return false;
+}
+
+// Erasing and writing flash disables the flash cache on both cores, an
+// erase for tens to hundreds of ms. The task does one step at a time and
+// lets everything else run in between; loop() pauses it while anything
+// is shown in realtime, where such a stall drops frames.
+void FSEQFlashStore::copyTask(void *) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    if (beginCopy()) {
+      while (!cancel) {
+        if (paused)
+          vTaskDelay(pdMS_TO_TICKS(50));
+        else if (!copyStep())
+          break;
+      }
+    }
+    endCopy();
+    running = false;
+  }
+}
+
+void FSEQFlashStore::handleCopy() {
+  paused = FSEQPlayerManager::isAnyActive() ||
+           realtimeMode != REALTIME_MODE_INACTIVE;
+  if (!request || uxQueueMessagesWaiting(request) == 0) {
+    copying = running;
+    return;
+  }
+  copying = true;
+  // a newer request replaces the running copy
+  if (running) {
+    cancel = true;
+    return;
+  }
+  if (paused || mapCount > 0)
+    return; // the stored sequence may be playing, copy once it stopped
+  xQueueReceive(request, pendingName, 0);
+  cancel = false;
+  running = true;
+  xTaskNotifyGive(task);
+}
+
+bool FSEQFlashStore::open(const char *filepath, FSEQCachedFile &dst) {
+  if (isCopying())
+    return false;
+  StoreHeader header;
+  if (!readStoreHeader(header))
+    return false;
+  String name = filepath;
+  if (!name.startsWith("/"))
+    name = "/" + name;
+  if (name != header.name)
+    return false;
+
+  const void *data = nullptr;
+  spi_flash_mmap_handle_t handle;
+  if (esp_partition_mmap(partition(), DATA_OFFSET, header.size,
+                         SPI_FLASH_MMAP_DATA, &data, &handle) != ESP_OK) {
+    // larger than the free part of the flash cache address space
+    DEBUG_PRINTF("[FSEQ] Flash: cannot map %u bytes\n", header.size);
+    return false;
+  }
+  mapCount++;
+  dst.attachMapped(static_cast<const uint8_t *>(data), header.size, handle);
+  return true;
+}
+
+void FSEQFlashStore::unmap(spi_flash_mmap_handle_t handle) {
+  spi_flash_munmap(handle);
+  if (mapCount > 0)
+    mapCount--;
+}
@@ -0,0 +1,89 @@
+#ifndef FSEQ_FLASH_H
+#define FSEQ_FLASH_H
+
+#include "fseq_cache.h"
+#include "wled.h"
+#include <esp_partition.h>
+
+// data partition holding a sequence for flash playback (see README)
+#ifndef FSEQ_PARTITION_SUBTYPE
+#define FSEQ_PARTITION_SUBTYPE 0x40
+#endif
+#ifndef FSEQ_PARTITION_LABEL
+#define FSEQ_PARTITION_LABEL "fseq"
+#endif
+// flash erased per step of the copy, 64 KB aligned steps use block erase
+#ifndef FSEQ_FLASH_ERASE_SIZE
+#define FSEQ_FLASH_ERASE_SIZE 0x10000
+#endif
+
+// Stores one sequence contiguously in a dedicated flash data partition.
+// For playback the partition is memory mapped, frames are then read through
+// a pointer without any file system calls and without SD traffic. store()
+// is called by the web server, it only posts the file name; loop() hands
+// it to a low priority task that erases and writes the partition, so the
+// long flash operations never run inside loop().
+class FSEQFlashStore {
+public:
+  // setup(): create the request mailbox and the copy task
+  static void begin();
+  static bool isAvailable() { return partition() != nullptr; }
+
+  // queue copying filepath (SD or LittleFS) into the partition, a later
+  // request replaces one that has not started yet
+  static bool store(const char *filepath);
+  // loop(): start queued copies, pause the copy while any player or other
+  // realtime mode is active
+  static void handleCopy();
+  // loop(): give up a running copy (the card is unmounted), true once the
+  // copy task holds no file
+  static bool stopCopy() {
+    cancel = true;
+    return !running;
+  }
+  // map the stored sequence into dst if it is filepath
+  static bool open(const char *filepath, FSEQCachedFile &dst);
+  static void unmap(spi_flash_mmap_handle_t handle);
+
+  static String getFileName();   // stored sequence, "" if none
+  static uint32_t getFileSize();
+  static bool isCopying() { return copying; }
+  static uint8_t getCopyProgress() {
+    return copySize ? (uint64_t)copied * 100 / copySize : 0;
+  }
+
+private:
+  FSEQFlashStore() {}
+
+  static const uint32_t STORE_MAGIC = 0x50514553; // "SEQP"
+  static const uint32_t DATA_OFFSET = SPI_FLASH_SEC_SIZE; // after the header
+
+  struct StoreHeader {
+    uint32_t magic;
+    uint32_t size;
+    char name[64];
+  };
+
+  static const esp_partition_t *partition();
+  static bool readStoreHeader(StoreHeader &header);
+  static bool beginCopy();
+  static bool copyStep();
+  static void endCopy();
+  static void copyTask(void *);
+
+  static QueueHandle_t request; // one path of FSEQ_CACHE_PATH_LEN
+  static TaskHandle_t task;
+  static char pendingName[FSEQ_CACHE_PATH_LEN];
+  static volatile bool copying; // request queued or copy running
+  static volatile bool running; // the task owns pendingName and the file
+  static volatile bool paused;  // set by loop(), the task waits
+  static volatile bool cancel;  // set by loop(), the task gives up the copy
+  static File source;
+  static uint8_t *buffer;
+  static uint32_t copySize;
+  static uint32_t copied;
+  static uint32_t erased;   // partition bytes erased for the copy
+  static uint8_t mapCount;  // open mappings, no copy while > 0
+};
+
+#endif // FSEQ_FLASH_H
@@ -0,0 +1,11 @@
+#include "fseq_header.h"
+#include "fseq_decoder.h"
+
+const char *FSEQHeader::compressionName(uint8_t compressionType) {
+  switch (compressionType) {
+  case FSEQ_COMPRESSION_NONE: return "none";
+  case FSEQ_COMPRESSION_ZSTD: return "zstd";
+  case FSEQ_COMPRESSION_ZLIB: return "zlib";
+  default:                    return "unknown";
+  }
+}
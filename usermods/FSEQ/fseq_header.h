@@ -0,0 +1,143 @@
+#ifndef FSEQ_HEADER_H
+#define FSEQ_HEADER_H
+
+#include "wled.h"
+
+// fixed part of the FSEQ file header (v1 and v2)
+struct FSEQFileHeader {
+  uint8_t identifier[4];
+  uint16_t channel_data_offset;
+  uint8_t minor_version;
+  uint8_t major_version;
+  uint16_t header_length;
+  uint32_t channel_count;
+  uint32_t frame_count;
+  uint8_t step_time;
+  uint8_t flags;
+  // v2 only
+  uint8_t compression_type;
+  uint16_t compression_block_count;
+  uint8_t sparse_range_count;
+  uint64_t unique_id;
+};
+
+// v2 sparse range: channels stored in the file, in file order
+struct FSEQSparseRange {
+  uint32_t start;
+  uint32_t length;
+};
+
+// Parsing of the FSEQ file header, shared by playback and the file index.
+// The readers take any file type with read(buffer, length) and seek(pos),
+// i.e. File and FSEQCachedFile.
+class FSEQHeader {
+public:
+  static const uint8_t V1_FIXED_SIZE = 20; // fields up to flags
+  static const uint8_t V2_FIXED_SIZE = 32;
+
+  // fixed header from the start of the file, false if it is no sequence;
+  // the file is left positioned after it (at the v2 block table)
+  template <typename F>
+  static bool readFixed(F &file, FSEQFileHeader &header);
+  // up to maxRanges sparse ranges, they follow the compression block table
+  template <typename F>
+  static bool readSparseRanges(F &file, const FSEQFileHeader &header,
+                               FSEQSparseRange *ranges, uint8_t maxRanges);
+  // media file named by the 'mf' variable header, "" if there is none
+  template <typename F>
+  static void readMediaFile(F &file, const FSEQFileHeader &header, char *name,
+                            size_t size);
+
+  static const char *compressionName(uint8_t compressionType);
+  static float getDuration(const FSEQFileHeader &header) {
+    return (float)header.frame_count * header.step_time / 1000.0f;
+  }
+
+private:
+  FSEQHeader() {}
+
+  static uint32_t le(const uint8_t *data, uint8_t bytes) {
+    uint32_t value = 0;
+    for (uint8_t i = bytes; i > 0; i--)
+      value = value << 8 | data[i - 1];
+    return value;
+  }
+};
+
+template <typename F>
+bool FSEQHeader::readFixed(F &file, FSEQFileHeader &header) {
+  uint8_t data[V2_FIXED_SIZE];
+  memset(&header, 0, sizeof(header));
+  if (!file.seek(0) || file.read(data, V1_FIXED_SIZE) != V1_FIXED_SIZE)
+    return false;
+  memcpy(header.identifier, data, 4);
+  header.channel_data_offset = le(data + 4, 2);
+  header.minor_version = data[6];
+  header.major_version = data[7];
+  header.header_length = le(data + 8, 2);
+  header.channel_count = le(data + 10, 4);
+  header.frame_count = le(data + 14, 4);
+  header.step_time = data[18];
+  header.flags = data[19];
+  if (memcmp(header.identifier, "PSEQ", 4) != 0)
+    return false;
+
+  if (header.major_version >= 2) {
+    uint8_t *v2 = data + V1_FIXED_SIZE;
+    if (file.read(v2, V2_FIXED_SIZE - V1_FIXED_SIZE) !=
+        V2_FIXED_SIZE - V1_FIXED_SIZE)
+      return false;
+    // upper nibble of byte 20 extends the block count beyond 255
+    header.compression_type = v2[0] & 0x0F;
+    header.compression_block_count = v2[1] | ((uint16_t)(v2[0] & 0xF0) << 4);
+    header.sparse_range_count = v2[2];
+    // v2[3] reserved
+    header.unique_id = le(v2 + 4, 4) | (uint64_t)le(v2 + 8, 4) << 32;
+  }
+  return true;
+}
+
+// 3 byte start channel, 3 byte count per range
+template <typename F>
+bool FSEQHeader::readSparseRanges(F &file, const FSEQFileHeader &header,
+                                  FSEQSparseRange *ranges,
+                                  uint8_t maxRanges) {
+  uint8_t count = min(header.sparse_range_count, maxRanges);
+  if (count == 0)
+    return true;
+  if (!file.seek(V2_FIXED_SIZE + header.compression_block_count * 8))
+    return false;
+  for (uint8_t i = 0; i < count; i++) {
+    uint8_t data[6];
+    if (file.read(data, sizeof(data)) != sizeof(data))
+      return false;
+    ranges[i].start = le(data, 3);
+    ranges[i].length = le(data + 3, 3);
+  }
+  return true;
+}
+
+// variable headers: 2 byte length (incl. these 4 bytes), 2 byte code, data
+template <typename F>
+void FSEQHeader::readMediaFile(F &file, const FSEQFileHeader &header,
+                               char *name, size_t size) {
+  name[0] = '\0';
+  uint32_t pos = header.header_length;
+  while (pos + 4 <= header.channel_data_offset) {
+    uint8_t data[4];
+    if (!file.seek(pos) || file.read(data, sizeof(data)) != sizeof(data))
+      return;
+    uint16_t length = le(data, 2);
+    if (length < 4)
+      return; // padding
+    if (data[2] == 'm' && data[3] == 'f') {
+      size_t n = min((size_t)(length - 4), size - 1);
+      n = file.read(reinterpret_cast<uint8_t *>(name), n);
+      name[n] = '\0';
+      return;
+    }
+    pos += length;
+  }
+}
+
+#endif // FSEQ_HEADER_H
@@ -0,0 +1,363 @@
+#include "fseq_index.h"
+#include "fseq_upload.h"
+#include "usermod_fseq.h"
+#include <memory>
+
+SemaphoreHandle_t FSEQFileIndex::mutex = nullptr;
+FSEQFileIndex::State FSEQFileIndex::state = FSEQFileIndex::STATE_UNLOADED;
+File FSEQFileIndex::scanDir;
+uint32_t FSEQFileIndex::slots = 0;
+uint32_t FSEQFileIndex::fileCount = 0;
+uint32_t FSEQFileIndex::sequenceCount = 0;
+
+void FSEQFileIndex::begin() {
+  if (!mutex)
+    mutex = xSemaphoreCreateMutex();
+}
+
+// the index is used from loop() and from the web server task
+void FSEQFileIndex::lock() { xSemaphoreTake(mutex, portMAX_DELAY); }
+
+void FSEQFileIndex::unlock() { xSemaphoreGive(mutex); }
+
+bool FSEQFileIndex::isSequence(const char *name) {
+  size_t len = strlen(name);
+  return len >= 5 && strcasecmp(name + len - 5, ".fseq") == 0;
+}
+
+const char *FSEQFileIndex::baseName(const char *filepath) {
+  const char *slash = strrchr(filepath, '/');
+  return slash ? slash + 1 : filepath;
+}
+
+void FSEQFileIndex::count(const Entry &entry, int8_t delta) {
+  fileCount += delta;
+  if (isSequence(entry.name))
+    sequenceCount += delta;
+}
+
+bool FSEQFileIndex::load() {
+  File index = SD_ADAPTER.open(FSEQ_INDEX_FILE, "r");
+  if (!index)
+    return false;
+  IndexHeader header;
+  bool ok = index.read((uint8_t *)&header, sizeof(header)) == sizeof(header) &&
+            header.magic == INDEX_MAGIC && header.version == INDEX_VERSION &&
+            header.recordSize == sizeof(Entry) && header.complete;
+  if (ok) {
+    slots = (index.size() - sizeof(header)) / sizeof(Entry);
+    fileCount = header.fileCount;
+    sequenceCount = header.sequenceCount;
+    state = STATE_READY;
+    DEBUG_PRINTF("[FSEQ] Index: %u files, %u sequences\n", fileCount,
+                 sequenceCount);
+  }
+  index.close();
+  return ok;
+}
+
+bool FSEQFileIndex::writeHeader(File &index, bool complete) {
+  IndexHeader header = {INDEX_MAGIC,   INDEX_VERSION, sizeof(Entry),
+                        fileCount,     sequenceCount, complete,
+                        {}};
+  return index.seek(0) &&
+         index.write((const uint8_t *)&header, sizeof(header)) ==
+             sizeof(header);
+}
+
+bool FSEQFileIndex::readEntry(File &index, uint32_t slot, Entry &entry) {
+  return index.seek(sizeof(IndexHeader) + slot * sizeof(Entry)) &&
+         index.read((uint8_t *)&entry, sizeof(entry)) == sizeof(entry);
+}
+
+bool FSEQFileIndex::writeEntry(File &index, uint32_t slot,
+                               const Entry &entry) {
+  return index.seek(sizeof(IndexHeader) + slot * sizeof(Entry)) &&
+         index.write((const uint8_t *)&entry, sizeof(entry)) == sizeof(entry);
+}
+
+// slot holding name or -1, freeSlot is set to the first unused slot or -1
+int32_t FSEQFileIndex::findSlot(File &index, const char *name,
+                                int32_t &freeSlot) {
+  freeSlot = -1;
+  if (!index.seek(sizeof(IndexHeader)))
+    return -1;
+  Entry entry;
+  for (uint32_t slot = 0; slot < slots; slot++) {
+    if (index.read((uint8_t *)&entry, sizeof(entry)) != sizeof(entry))
+      break;
+    if (!entry.name[0]) {
+      if (freeSlot < 0)
+        freeSlot = slot;
+    } else if (strcasecmp(entry.name, name) == 0) {
+      return slot;
+    }
+  }
+  return -1;
+}
+
+// size, time and for sequences the parsed header of an open file
+bool FSEQFileIndex::describe(File &file, const char *name, Entry &entry) {
+  memset(&entry, 0, sizeof(entry));
+  strlcpy(entry.name, name, sizeof(entry.name));
+  entry.size = file.size();
+  entry.mtime = (uint32_t)file.getLastWrite();
+  if (!isSequence(name))
+    return true;
+
+  FSEQFileHeader header;
+  if (!FSEQHeader::readFixed(file, header))
+    return true; // listed as a plain file
+  entry.channelCount = header.channel_count;
+  entry.frameCount = header.frame_count;
+  entry.stepTime = header.step_time;
+  entry.majorVersion = header.major_version;
+  entry.compressionType = header.compression_type;
+  entry.sparseRangeCount = header.sparse_range_count;
+  FSEQHeader::readSparseRanges(file, header, entry.ranges, FSEQ_INDEX_RANGES);
+  FSEQHeader::readMediaFile(file, header, entry.mediaFile,
+                            sizeof(entry.mediaFile));
+  return true;
+}
+
+bool FSEQFileIndex::beginBuild() {
+  SD_ADAPTER.remove(FSEQ_INDEX_FILE);
+  File index = SD_ADAPTER.open(FSEQ_INDEX_FILE, FILE_WRITE);
+  slots = 0;
+  fileCount = 0;
+  sequenceCount = 0;
+  bool ok = index && writeHeader(index, false);
+  if (index)
+    index.close();
+  scanDir = SD_ADAPTER.open("/");
+  if (!ok || !scanDir || !scanDir.isDirectory()) {
+    DEBUG_PRINTLN(F("[FSEQ] Index: cannot create index file"));
+    scanDir = File();
+    return false;
+  }
+  state = STATE_BUILDING;
+  return true;
+}
+
+void FSEQFileIndex::buildStep(uint32_t budgetUs) {
+  File index = SD_ADAPTER.open(FSEQ_INDEX_FILE, "r+");
+  if (!index) {
+    scanDir.close();
+    scanDir = File();
+    state = STATE_UNLOADED;
+    return;
+  }
+  uint32_t start = micros();
+  do {
+    File file = scanDir.openNextFile();
+    if (!file) {
+      writeHeader(index, true);
+      scanDir.close();
+      scanDir = File();
+      state = STATE_READY;
+      DEBUG_PRINTF("[FSEQ] Index built: %u files, %u sequences\n", fileCount,
+                   sequenceCount);
+      break;
+    }
+    const char *name = baseName(file.name());
+    Entry entry;
+    if (!file.isDirectory() && name[0] != '.' &&
+        !FSEQUploadWriter::isTempFile(name) && describe(file, name, entry) &&
+        writeEntry(index, slots, entry)) {
+      slots++;
+      count(entry, 1);
+    }
+    file.close();
+  } while (micros() - start < budgetUs);
+  index.close();
+}
+
+void FSEQFileIndex::handle(uint32_t budgetUs) {
+  if (state == STATE_READY || SD_ADAPTER.cardType() == CARD_NONE)
+    return;
+  lock();
+  if (state == STATE_UNLOADED) {
+    if (!load() && !beginBuild())
+      state = STATE_READY; // read-only card, list what the index holds
+  } else if (state == STATE_BUILDING) {
+    buildStep(budgetUs);
+  }
+  unlock();
+}
+
+void FSEQFileIndex::reload() {
+  lock();
+  if (scanDir)
+    scanDir.close();
+  scanDir = File();
+  slots = 0;
+  fileCount = 0;
+  sequenceCount = 0;
+  state = STATE_UNLOADED;
+  unlock();
+}
+
+void FSEQFileIndex::rescan() {
+  reload();
+  lock();
+  SD_ADAPTER.remove(FSEQ_INDEX_FILE);
+  unlock();
+}
+
+void FSEQFileIndex::update(const char *filepath) {
+  if (state == STATE_BUILDING) {
+    rescan(); // the scan may already be past this file
+    return;
+  }
+  lock();
+  if (state == STATE_READY) {
+    const char *name = baseName(filepath);
+    String path = "/" + String(name);
+    File file = SD_ADAPTER.open(path.c_str(), "r");
+    File index = SD_ADAPTER.open(FSEQ_INDEX_FILE, "r+");
+    Entry entry;
+    if (file && index && describe(file, name, entry)) {
+      int32_t freeSlot;
+      int32_t slot = findSlot(index, name, freeSlot);
+      Entry old;
+      if (slot >= 0 && readEntry(index, slot, old))
+        count(old, -1);
+      else
+        slot = freeSlot >= 0 ? freeSlot : (int32_t)slots++;
+      if (writeEntry(index, slot, entry))
+        count(entry, 1);
+      writeHeader(index, true);
+    }
+    if (file)
+      file.close();
+    if (index)
+      index.close();
+  }
+  unlock();
+}
+
+void FSEQFileIndex::remove(const char *filepath) {
+  if (state == STATE_BUILDING) {
+    rescan();
+    return;
+  }
+  lock();
+  File index;
+  if (state == STATE_READY)
+    index = SD_ADAPTER.open(FSEQ_INDEX_FILE, "r+");
+  if (index) {
+    int32_t freeSlot;
+    int32_t slot = findSlot(index, baseName(filepath), freeSlot);
+    Entry entry;
+    if (slot >= 0 && readEntry(index, slot, entry)) {
+      count(entry, -1);
+      entry.name[0] = '\0';
+      writeEntry(index, slot, entry);
+      writeHeader(index, true);
+    }
+    index.close();
+  }
+  unlock();
+}
+
+struct FSEQListStream {
+  bool sequencesOnly;
+  FSEQFileIndex::Printer print;
+  String prefix;
+  String suffix;
+  uint32_t slot = 0;   // next index record to look at
+  uint32_t skip;       // entries still to skip for the offset
+  uint32_t left;       // entries still to send for the limit
+  bool first = true;
+  uint8_t stage = 0;   // prefix, entries, suffix, done
+  String line;         // piece of JSON not yet sent
+  uint32_t linePos = 0;
+};
+
+void FSEQFileIndex::sendList(AsyncWebServerRequest *request,
+                             bool sequencesOnly, const String &prefix,
+                             const String &suffix, Printer print) {
+  std::shared_ptr<FSEQListStream> list = std::make_shared<FSEQListStream>();
+  list->sequencesOnly = sequencesOnly;
+  list->print = print;
+  list->prefix = prefix;
+  list->suffix = suffix;
+  list->skip = request->hasArg("offset") ? request->arg("offset").toInt() : 0;
+  list->left = request->hasArg("limit") ? request->arg("limit").toInt()
+                                        : FSEQ_INDEX_DEFAULT_LIMIT;
+
+  // filled as the TCP window allows, one response piece at a time
+  AsyncWebServerResponse *response = request->beginChunkedResponse(
+      "application/json",
+      [list](uint8_t *buffer, size_t maxLen, size_t) -> size_t {
+        size_t written = 0;
+        bool locked = false;
+        File index;
+        while (written < maxLen) {
+          if (list->linePos < list->line.length()) {
+            size_t n = min(maxLen - written,
+                           (size_t)(list->line.length() - list->linePos));
+            memcpy(buffer + written, list->line.c_str() + list->linePos, n);
+            list->linePos += n;
+            written += n;
+            continue;
+          }
+          list->line = "";
+          list->linePos = 0;
+
+          if (list->stage == 0) {
+            list->line = list->prefix;
+            list->stage = 1;
+          } else if (list->stage == 1) {
+            if (!locked) {
+              lock();
+              locked = true;
+              if (state != STATE_UNLOADED)
+                index = SD_ADAPTER.open(FSEQ_INDEX_FILE, "r");
+              if (index)
+                index.seek(sizeof(IndexHeader) + list->slot * sizeof(Entry));
+            }
+            Entry entry;
+            bool found = false;
+            while (index && list->left > 0 && list->slot < slots &&
+                   index.read((uint8_t *)&entry, sizeof(entry)) ==
+                       sizeof(entry)) {
+              list->slot++;
+              if (!entry.name[0] ||
+                  (list->sequencesOnly && !isSequence(entry.name)))
+                continue;
+              if (list->skip > 0) {
+                list->skip--;
+                continue;
+              }
+              found = true;
+              break;
+            }
+            if (!found) {
+              list->stage = 2;
+              continue;
+            }
+            list->left--;
+            StaticJsonDocument<768> doc;
+            list->print(entry, doc.to<JsonObject>());
+            String json;
+            serializeJson(doc, json);
+            list->line = list->first ? json : "," + json;
+            list->first = false;
+          } else if (list->stage == 2) {
+            list->line = list->suffix;
+            list->stage = 3;
+          } else {
+            break;
+          }
+        }
+        if (index)
+          index.close();
+        if (locked)
+          unlock();
+        return written;
+      });
+  response->addHeader("X-Total-Count", String(getCount(sequencesOnly)));
+  response->addHeader("X-Index-Complete", isComplete() ? "1" : "0");
+  request->send(response);
+}
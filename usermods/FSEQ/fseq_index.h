@@ -0,0 +1,111 @@
+#ifndef FSEQ_INDEX_H
+#define FSEQ_INDEX_H
+
+#include "fseq_header.h"
+#include "wled.h"
+
+// index file in the SD root, hidden from the listings
+#ifndef FSEQ_INDEX_FILE
+#define FSEQ_INDEX_FILE "/.fseq_index"
+#endif
+// sparse ranges of a sequence kept in its index entry
+#ifndef FSEQ_INDEX_RANGES
+#define FSEQ_INDEX_RANGES 4
+#endif
+// entries returned by a list request without limit parameter
+#ifndef FSEQ_INDEX_DEFAULT_LIMIT
+#define FSEQ_INDEX_DEFAULT_LIMIT UINT32_MAX
+#endif
+
+// Index of the files in the SD root, stored on the card as fixed size
+// records so the list endpoints neither rescan the card nor hold the whole
+// list in memory. It doubles as cache of the sequence headers, so their
+// length and layout are known without opening them. The index is built
+// once from loop() when it is missing and kept up to date by the upload and
+// delete endpoints. Files copied onto the card elsewhere show up after a
+// rescan (/api/sd/rescan).
+class FSEQFileIndex {
+public:
+  struct Entry {
+    char name[64];         // without leading '/', empty for a free slot
+    uint32_t size;
+    uint32_t mtime;        // last write, seconds since epoch
+    // parsed header of .fseq files, all 0 for other files
+    uint32_t channelCount;
+    uint32_t frameCount;
+    uint8_t stepTime;      // ms per frame
+    uint8_t majorVersion;
+    uint8_t compressionType;
+    uint8_t sparseRangeCount; // in the file, the first FSEQ_INDEX_RANGES
+    FSEQSparseRange ranges[FSEQ_INDEX_RANGES]; // are kept here
+    char mediaFile[64];    // 'mf' variable header
+  };
+
+  // fills obj with the fields of one entry in the list response
+  typedef void (*Printer)(const Entry &entry, JsonObject obj);
+
+  // create the lock, from setup() before anything uses the index
+  static void begin();
+  // load or build the index, spending at most budgetUs
+  static void handle(uint32_t budgetUs);
+  // card changed or remounted, load the index again
+  static void reload();
+  // drop the index and scan the card again
+  static void rescan();
+
+  // file was written / deleted
+  static void update(const char *filepath);
+  static void remove(const char *filepath);
+
+  static bool isComplete() { return state == STATE_READY; }
+  static uint32_t getCount(bool sequencesOnly) {
+    return sequencesOnly ? sequenceCount : fileCount;
+  }
+  static bool isSequence(const char *name);
+
+  // stream entries offset .. offset + limit (request arguments) as JSON,
+  // prefix and suffix are written around the comma separated entries
+  static void sendList(AsyncWebServerRequest *request, bool sequencesOnly,
+                       const String &prefix, const String &suffix,
+                       Printer print);
+
+private:
+  FSEQFileIndex() {}
+
+  static const uint32_t INDEX_MAGIC = 0x58444946; // "FIDX"
+  static const uint16_t INDEX_VERSION = 2;
+
+  struct IndexHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t recordSize;
+    uint32_t fileCount;
+    uint32_t sequenceCount;
+    uint8_t complete;      // 0 while the index is being built
+    uint8_t reserved[3];
+  };
+
+  enum State : uint8_t { STATE_UNLOADED, STATE_BUILDING, STATE_READY };
+
+  static void lock();
+  static void unlock();
+  static bool load();
+  static bool beginBuild();
+  static void buildStep(uint32_t budgetUs);
+  static bool writeHeader(File &index, bool complete);
+  static bool readEntry(File &index, uint32_t slot, Entry &entry);
+  static bool writeEntry(File &index, uint32_t slot, const Entry &entry);
+  static int32_t findSlot(File &index, const char *name, int32_t &freeSlot);
+  static bool describe(File &file, const char *name, Entry &entry);
+  static const char *baseName(const char *filepath);
+  static void count(const Entry &entry, int8_t delta);
+
+  static SemaphoreHandle_t mutex;
+  static State state;
+  static File scanDir;           // root directory while building
+  static uint32_t slots;         // records in the index file
+  static uint32_t fileCount;
+  static uint32_t sequenceCount;
+};
+
+#endif // FSEQ_INDEX_H
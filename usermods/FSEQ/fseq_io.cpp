@@ -0,0 +1,73 @@
+#include "fseq_io.h"
+
+volatile bool FSEQIOArbiter::playing = false;
+volatile bool FSEQIOArbiter::readSlack = true;
+volatile uint32_t FSEQIOArbiter::deadline = 0;
+volatile uint32_t FSEQIOArbiter::periodUs = 0;
+volatile uint32_t FSEQIOArbiter::readUs = 0;
+uint32_t FSEQIOArbiter::writeUs = 2000; // until the first write is measured
+uint32_t FSEQIOArbiter::writeBytes = 0;
+uint32_t FSEQIOArbiter::writeWaits = 0;
+uint32_t FSEQIOArbiter::forcedWrites = 0;
+
+void FSEQIOArbiter::setPlayback(int64_t nextFrameUs, uint32_t period,
+                                uint32_t read, bool slack) {
+  // the writer task compares against micros(), 32 bit values are atomic
+  int64_t leftUs = nextFrameUs - esp_timer_get_time();
+  deadline = micros() + (uint32_t)constrain(leftUs, (int64_t)0,
+                                            (int64_t)period);
+  periodUs = period;
+  readUs = read;
+  readSlack = slack;
+  playing = true;
+}
+
+void FSEQIOArbiter::setIdle() {
+  playing = false;
+  readSlack = true;
+}
+
+void FSEQIOArbiter::acquireWrite() {
+  uint32_t start = millis();
+  bool waited = false;
+  while (playing) {
+    int32_t leftUs = (int32_t)(deadline - micros());
+    if (readSlack && leftUs > (int32_t)(writeUs + FSEQ_IO_GUARD_US))
+      break;
+    if (millis() - start > FSEQ_IO_MAX_WRITE_WAIT_MS) {
+      forcedWrites++;
+      break;
+    }
+    waited = true;
+    vTaskDelay(1);
+  }
+  if (waited)
+    writeWaits++;
+}
+
+void FSEQIOArbiter::releaseWrite(uint32_t bytes, uint32_t us) {
+  writeUs = (writeUs * 7 + us) / 8;
+  writeBytes = bytes;
+}
+
+uint32_t FSEQIOArbiter::getUploadBandwidth() {
+  if (!writeBytes || !writeUs)
+    return 0;
+  uint32_t rate = (uint64_t)writeBytes * 1000000 / writeUs;
+  if (!playing)
+    return rate;
+  // whole writes that fit in a frame period next to the frame reads
+  uint32_t used = readUs + FSEQ_IO_GUARD_US;
+  if (periodUs <= used)
+    return 0;
+  uint32_t writes = (periodUs - used) / writeUs;
+  return (uint64_t)writes * writeBytes * 1000000 / periodUs;
+}
+
+void FSEQIOArbiter::toJSON(JsonObject obj) {
+  obj["bandwidth_bytes_per_s"] = getUploadBandwidth();
+  obj["write_us"] = writeUs;
+  obj["read_us_per_frame"] = playing ? (uint32_t)readUs : 0;
+  obj["waits"] = writeWaits;
+  obj["forced"] = forcedWrites;
+}
@@ -0,0 +1,54 @@
+#ifndef FSEQ_IO_H
+#define FSEQ_IO_H
+
+#include "wled.h"
+#include <esp_timer.h>
+
+// SD time kept free before the next frame is due (microseconds)
+#ifndef FSEQ_IO_GUARD_US
+#define FSEQ_IO_GUARD_US 2000
+#endif
+// longest time a write waits for playback slack before it is forced through,
+// so an upload cannot time out while the card is too slow for the sequence
+#ifndef FSEQ_IO_MAX_WRITE_WAIT_MS
+#define FSEQ_IO_MAX_WRITE_WAIT_MS 500
+#endif
+
+// Shares the SD card between playback reads and upload writes. Playback has
+// priority: FSEQPlayerManager publishes when the next frame is due and
+// whether the read-ahead is full, and the upload writer task only starts a
+// write once the read-ahead is full and the write is expected to finish
+// before that deadline. Uploads therefore use the slack left in each frame
+// period instead of delaying frame reads.
+class FSEQIOArbiter {
+public:
+  // playback side, called from loop()
+  static void setPlayback(int64_t nextFrameUs, uint32_t periodUs,
+                          uint32_t readUs, bool readSlack);
+  static void setIdle();
+
+  // upload side, called from the writer task around each SD write
+  static void acquireWrite();
+  static void releaseWrite(uint32_t bytes, uint32_t us);
+
+  // upload bytes/s the card can take at the current playback rate
+  static uint32_t getUploadBandwidth();
+  static uint32_t getWriteWaits() { return writeWaits; }
+  static uint32_t getForcedWrites() { return forcedWrites; }
+  static void toJSON(JsonObject obj);
+
+private:
+  FSEQIOArbiter() {}
+
+  static volatile bool playing;
+  static volatile bool readSlack;  // every SD player's read-ahead is full
+  static volatile uint32_t deadline; // micros() the next frame is due at
+  static volatile uint32_t periodUs;
+  static volatile uint32_t readUs;   // SD read time per frame period
+  static uint32_t writeUs;           // expected time of one write
+  static uint32_t writeBytes;        // size of the last write
+  static uint32_t writeWaits;        // writes delayed for playback
+  static uint32_t forcedWrites;      // writes that did not find slack
+};
+
+#endif // FSEQ_IO_H
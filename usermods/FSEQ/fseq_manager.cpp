@@ -0,0 +1,117 @@
+#include "fseq_manager.h"
+#include "fseq_io.h"
+#include "fseq_metrics.h"
+
+FSEQPlayer FSEQPlayerManager::players[FSEQ_MAX_PLAYERS];
+
+FSEQPlayer *FSEQPlayerManager::get(uint8_t index) {
+  return index < FSEQ_MAX_PLAYERS ? &players[index] : nullptr;
+}
+
+void FSEQPlayerManager::handle() {
+  if (realtimeMode != REALTIME_MODE_FSEQ || !isAnyActive()) {
+    FSEQIOArbiter::setIdle();
+    return;
+  }
+
+  int64_t nowUs = esp_timer_get_time();
+  bool changed = false;
+  bool ended = false;
+  for (FSEQPlayer &player : players) {
+    if (!player.isActive())
+      continue;
+    changed |= player.handlePlayRecording(nowUs);
+    ended |= !player.isActive();
+  }
+
+  if (ended && !isAnyActive()) {
+    DEBUG_PRINTLN("[FSEQ] All recordings finished, disabling realtime mode");
+    realtimeLock(10, REALTIME_MODE_INACTIVE);
+    FSEQIOArbiter::setIdle();
+    return;
+  }
+  if (changed) {
+    uint32_t showStartUs = micros();
+    strip.show();
+    FSEQMetrics::show.add(micros() - showStartUs);
+    realtimeLock(3000, REALTIME_MODE_FSEQ);
+  }
+
+  // use the time until the next frame is due to read ahead
+  scheduleReads(FSEQ_READ_BUDGET_US);
+  publishDeadline();
+}
+
+// tell the upload writer how much of the frame period playback needs
+void FSEQPlayerManager::publishDeadline() {
+  int64_t nextUs = INT64_MAX;
+  uint32_t periodUs = UINT32_MAX;
+  uint8_t sdPlayers = 0;
+  for (FSEQPlayer &player : players) {
+    if (!player.isActive() || !player.readsSD())
+      continue;
+    nextUs = min(nextUs, player.getNextFrameUs());
+    periodUs = min(periodUs, player.getStepUs());
+    sdPlayers++;
+  }
+  if (sdPlayers == 0) {
+    FSEQIOArbiter::setIdle(); // nothing is read from the card
+    return;
+  }
+  FSEQIOArbiter::setPlayback(nextUs, periodUs,
+                             FSEQMetrics::sdRead.getAvg() * sdPlayers,
+                             hasReadSlack());
+}
+
+void FSEQPlayerManager::scheduleReads(uint32_t budgetUs) {
+  uint32_t start = micros();
+  uint32_t failed = 0; // players whose read failed in this iteration
+  do {
+    FSEQPlayer *next = nullptr;
+    uint8_t nextIndex = 0;
+    for (uint8_t i = 0; i < FSEQ_MAX_PLAYERS; i++) {
+      FSEQPlayer &player = players[i];
+      if ((failed & (1U << i)) || player.hasReadSlack())
+        continue;
+      if (!next || player.getBufferedFrames() < next->getBufferedFrames()) {
+        next = &player;
+        nextIndex = i;
+      }
+    }
+    if (!next)
+      break;
+    if (!next->readFrameAhead())
+      failed |= 1U << nextIndex;
+  } while (micros() - start < budgetUs);
+}
+
+void FSEQPlayerManager::stop(FSEQPlayer &player) {
+  player.clearLastPlayback();
+  if (!isAnyActive())
+    realtimeLock(10, REALTIME_MODE_INACTIVE);
+}
+
+void FSEQPlayerManager::stopAll() {
+  for (FSEQPlayer &player : players)
+    if (player.isOpen())
+      player.clearLastPlayback();
+}
+
+bool FSEQPlayerManager::isAnyActive() {
+  for (FSEQPlayer &player : players)
+    if (player.isActive())
+      return true;
+  return false;
+}
+
+bool FSEQPlayerManager::hasReadSlack() {
+  for (FSEQPlayer &player : players)
+    if (!player.hasReadSlack())
+      return false;
+  return true;
+}
+
+void FSEQPlayerManager::setChannelWindow(uint32_t offset, uint32_t length) {
+  for (FSEQPlayer &player : players)
+    player.setChannelWindow(offset, length);
+}
@@ -0,0 +1,44 @@
+#ifndef FSEQ_MANAGER_H
+#define FSEQ_MANAGER_H
+
+#include "fseq_player.h"
+
+// number of sequences that can play at the same time
+#ifndef FSEQ_MAX_PLAYERS
+#define FSEQ_MAX_PLAYERS 4
+#endif
+
+// Runs several FSEQ players side by side, each on its own segment or LED
+// range. Frames that are due are written by all players first and shown
+// once, then the SD card reads of all players are scheduled together: the
+// player whose buffer runs out first gets the next complete frame, so reads
+// stay sequential within a file instead of alternating chunk by chunk.
+// Player 0 is the one controlled by FPP and the single-player endpoints.
+class FSEQPlayerManager {
+public:
+  static FSEQPlayer &primary() { return players[0]; }
+  // player by index, nullptr if out of range
+  static FSEQPlayer *get(uint8_t index);
+  static uint8_t count() { return FSEQ_MAX_PLAYERS; }
+
+  static void handle();
+  // stop one player, realtime mode ends when no other player is active
+  static void stop(FSEQPlayer &player);
+  static void stopAll();
+  static bool isAnyActive();
+  // true while no player needs the SD card for its read-ahead
+  static bool hasReadSlack();
+
+  // channel window applied to every player
+  static void setChannelWindow(uint32_t offset, uint32_t length);
+
+private:
+  FSEQPlayerManager() {}
+
+  static void scheduleReads(uint32_t budgetUs);
+  static void publishDeadline();
+
+  static FSEQPlayer players[FSEQ_MAX_PLAYERS];
+};
+
+#endif // FSEQ_MANAGER_H
@@ -0,0 +1,94 @@
+#include "fseq_metrics.h"
+
+uint8_t FSEQLatency::bucketOf(uint32_t us) {
+  if (us < 4)
+    return us;
+  uint8_t msb = 31 - __builtin_clz(us);
+  uint8_t bucket = msb * 4 + ((us >> (msb - 2)) & 3) - 4;
+  return min(bucket, (uint8_t)(BUCKETS - 1));
+}
+
+uint32_t FSEQLatency::bucketLimit(uint8_t bucket) {
+  if (bucket < 4)
+    return bucket;
+  uint8_t msb = (bucket + 4) / 4;
+  uint32_t step = 1U << (msb - 2);
+  return (1U << msb) + ((bucket + 4) % 4 + 1) * step - 1;
+}
+
+void FSEQLatency::add(uint32_t us) {
+  count++;
+  totalUs += us;
+  minUs = min(minUs, us);
+  maxUs = max(maxUs, us);
+  buckets[bucketOf(us)]++;
+}
+
+uint32_t FSEQLatency::getPercentile(uint8_t percent) const {
+  if (count == 0)
+    return 0;
+  uint32_t rank = ((uint64_t)count * percent + 99) / 100;
+  uint32_t seen = 0;
+  for (uint8_t i = 0; i < BUCKETS; i++) {
+    seen += buckets[i];
+    if (seen >= rank)
+      return min(bucketLimit(i), maxUs);
+  }
+  return maxUs;
+}
+
+void FSEQLatency::toJSON(JsonObject obj) const {
+  obj["count"]  = count;
+  obj["min_us"] = getMin();
+  obj["avg_us"] = getAvg();
+  obj["p99_us"] = getPercentile(99);
+  obj["max_us"] = maxUs;
+}
+
+FSEQLatency FSEQMetrics::sdRead;
+FSEQLatency FSEQMetrics::show;
+FSEQLatency FSEQMetrics::fileOpen;
+FSEQLatency FSEQMetrics::seek;
+uint32_t FSEQMetrics::framesShown = 0;
+uint32_t FSEQMetrics::lateFrames = 0;
+uint32_t FSEQMetrics::skippedFrames = 0;
+uint32_t FSEQMetrics::underruns = 0;
+uint32_t FSEQMetrics::softSyncs = 0;
+uint32_t FSEQMetrics::hardSyncs = 0;
+uint64_t FSEQMetrics::bytesRead = 0;
+uint32_t FSEQMetrics::resetMs = 0;
+
+void FSEQMetrics::reset() {
+  sdRead.reset();
+  show.reset();
+  fileOpen.reset();
+  seek.reset();
+  framesShown = 0;
+  lateFrames = 0;
+  skippedFrames = 0;
+  underruns = 0;
+  softSyncs = 0;
+  hardSyncs = 0;
+  bytesRead = 0;
+  resetMs = millis();
+}
+
+void FSEQMetrics::toJSON(JsonObject obj) {
+  uint32_t elapsedMs = millis() - resetMs;
+  obj["uptime_s"] = elapsedMs / 1000;
+
+  sdRead.toJSON(obj.createNestedObject("sd_read"));
+  show.toJSON(obj.createNestedObject("show"));
+  fileOpen.toJSON(obj.createNestedObject("file_open"));
+  seek.toJSON(obj.createNestedObject("seek"));
+
+  obj["frames_shown"]   = framesShown;
+  obj["late_frames"]    = lateFrames;
+  obj["skipped_frames"] = skippedFrames;
+  obj["underruns"]      = underruns;
+  obj["soft_syncs"]     = softSyncs;
+  obj["hard_syncs"]     = hardSyncs;
+  obj["kb_read"]        = (uint32_t)(bytesRead / 1024);
+  obj["bytes_per_s"] =
+      elapsedMs ? (uint32_t)(bytesRead * 1000 / elapsedMs) : 0;
+}
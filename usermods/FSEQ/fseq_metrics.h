@@ -0,0 +1,66 @@
+#ifndef FSEQ_METRICS_H
+#define FSEQ_METRICS_H
+
+#include "wled.h"
+
+// frames shown later than 1/FSEQ_LATE_FRAME_DIV of a frame period count
+// as late
+#ifndef FSEQ_LATE_FRAME_DIV
+#define FSEQ_LATE_FRAME_DIV 4
+#endif
+
+// Duration histogram with quarter-octave buckets (about 19% wide), enough
+// to report min / avg / p99 without keeping individual samples.
+class FSEQLatency {
+public:
+  void add(uint32_t us);
+  void reset() { *this = FSEQLatency(); }
+  uint32_t getCount() const { return count; }
+  uint32_t getMin() const { return count ? minUs : 0; }
+  uint32_t getMax() const { return maxUs; }
+  uint32_t getAvg() const { return count ? totalUs / count : 0; }
+  // upper bound of the bucket holding the given percentile
+  uint32_t getPercentile(uint8_t percent) const;
+  void toJSON(JsonObject obj) const;
+
+private:
+  static const uint8_t BUCKETS = 84; // up to 2^22 us (4 s)
+
+  static uint8_t bucketOf(uint32_t us);
+  static uint32_t bucketLimit(uint8_t bucket);
+
+  uint32_t count = 0;
+  uint32_t minUs = UINT32_MAX;
+  uint32_t maxUs = 0;
+  uint64_t totalUs = 0;
+  uint32_t buckets[BUCKETS] = {};
+};
+
+// Playback counters of all players, reported by /api/fseq/metrics. They
+// show how close playback runs to its deadlines, e.g. to size SD cards and
+// LED counts before a show.
+class FSEQMetrics {
+public:
+  static FSEQLatency sdRead;   // read time per complete frame
+  static FSEQLatency show;     // strip.show() after new frames
+  static FSEQLatency fileOpen; // open and header parsing of a sequence
+  static FSEQLatency seek;     // read time of the first frame after a jump
+
+  static uint32_t framesShown;
+  static uint32_t lateFrames;
+  static uint32_t skippedFrames;
+  static uint32_t underruns;   // frames read on demand, read-ahead empty
+  static uint32_t softSyncs;
+  static uint32_t hardSyncs;
+  static uint64_t bytesRead;
+
+  static void reset();
+  static void toJSON(JsonObject obj);
+
+private:
+  FSEQMetrics() {}
+
+  static uint32_t resetMs;
+};
+
+#endif // FSEQ_METRICS_H
@@ -1,4 +1,6 @@
 #include "fseq_player.h"
+#include "fseq_flash.h"
+#include "fseq_metrics.h"
 #include "usermod_fseq.h"
 #include "wled.h"
 #include <Arduino.h>
@@ -21,20 +23,6 @@ int8_t UsermodFseq::configPinPoci = 19;
 int8_t UsermodFseq::configPinPico = 23;
 #endif
 
-File FSEQPlayer::recordingFile;
-String FSEQPlayer::currentFileName = "";
-float FSEQPlayer::secondsElapsed = 0;
-
-uint8_t FSEQPlayer::colorChannels = 3;
-int32_t FSEQPlayer::recordingRepeats = RECORDING_REPEAT_DEFAULT;
-uint32_t FSEQPlayer::now = 0;
-uint32_t FSEQPlayer::next_time = 0;
-uint16_t FSEQPlayer::playbackLedStart = 0;
-uint16_t FSEQPlayer::playbackLedStop = uint16_t(-1);
-uint32_t FSEQPlayer::frame = 0;
-uint16_t FSEQPlayer::buffer_size = 48;
-FSEQPlayer::FileHeader FSEQPlayer::file_header;
-
 inline uint32_t FSEQPlayer::readUInt32() {
   uint8_t buffer[4];
   if (recordingFile.read(buffer, 4) != 4)
@@ -43,26 +31,6 @@ inline uint32_t FSEQPlayer::readUInt32() {
          ((uint32_t)buffer[2] << 16) | ((uint32_t)buffer[3] << 24);
 }
 
-inline uint32_t FSEQPlayer::readUInt24() {
-  uint8_t buffer[3];
-  if (recordingFile.read(buffer, 3) != 3)
-    return 0;
-  return (uint32_t)buffer[0] | ((uint32_t)buffer[1] << 8) |
-         ((uint32_t)buffer[2] << 16);
-}
-
-inline uint16_t FSEQPlayer::readUInt16() {
-  uint8_t buffer[2];
-  if (recordingFile.read(buffer, 2) != 2)
-    return 0;
-  return (uint16_t)buffer[0] | ((uint16_t)buffer[1] << 8);
-}
-
-inline uint8_t FSEQPlayer::readUInt8() {
-  int c = recordingFile.read();
-  return (c < 0) ? 0 : (uint8_t)c;
-}
-
 bool FSEQPlayer::fileOnSD(const char *filepath) {
   uint8_t cardType = SD_ADAPTER.cardType();
   if (cardType == CARD_NONE)
@@ -70,7 +38,9 @@ bool FSEQPlayer::fileOnSD(const char *filepath) {
   return SD_ADAPTER.exists(filepath);
 }
 
-bool FSEQPlayer::fileOnFS(const char *filepath) { return false; }
+bool FSEQPlayer::fileOnFS(const char *filepath) {
+  return WLED_FS.exists(filepath);
+}
 
 void FSEQPlayer::printHeaderInfo() {
   DEBUG_PRINTLN("FSEQ file header:");
@@ -82,30 +52,382 @@ void FSEQPlayer::printHeaderInfo() {
   DEBUG_PRINTF(" frame_count         = %d\n", file_header.frame_count);
   DEBUG_PRINTF(" step_time           = %d\n", file_header.step_time);
   DEBUG_PRINTF(" flags               = %d\n", file_header.flags);
+  if (file_header.major_version >= 2) {
+    DEBUG_PRINTF(" compression_type    = %d\n", file_header.compression_type);
+    DEBUG_PRINTF(" compression_blocks  = %d\n",
+                 file_header.compression_block_count);
+    DEBUG_PRINTF(" sparse_ranges       = %d\n",
+                 file_header.sparse_range_count);
+  }
+  if (mediaFileName.length())
+    DEBUG_PRINTF(" media_file          = %s\n", mediaFileName.c_str());
+}
+
+bool FSEQPlayer::readHeader(const char *filepath) {
+  if (!FSEQHeader::readFixed(recordingFile, file_header)) {
+    DEBUG_PRINTF("Error reading FSEQ file %s header, invalid identifier\n",
+                 filepath);
+    return false;
+  }
+  if (!FSEQBlockDecoder::isSupported(file_header.compression_type)) {
+    DEBUG_PRINTF("Error reading FSEQ file %s, compression type %d not "
+                 "supported\n",
+                 filepath, file_header.compression_type);
+    return false;
+  }
+  if (file_header.compression_type != FSEQ_COMPRESSION_NONE &&
+      !readCompressionBlocks()) {
+    DEBUG_PRINTF("Error reading FSEQ file %s compression block table\n",
+                 filepath);
+    return false;
+  }
+  if (!readSparseRanges()) {
+    DEBUG_PRINTF("Error reading FSEQ file %s sparse ranges\n", filepath);
+    return false;
+  }
+  readVariableHeaders();
+  return true;
+}
+
+// block table follows the 32 byte v2 fixed header
+bool FSEQPlayer::readCompressionBlocks() {
+  if (file_header.compression_block_count == 0)
+    return false;
+  blocks = static_cast<CompressionBlock *>(
+      d_malloc(sizeof(CompressionBlock) * file_header.compression_block_count));
+  if (!blocks)
+    return false;
+
+  // blocks are stored back to back after the header, unused entries are 0
+  uint32_t offset = file_header.channel_data_offset;
+  blockCount = 0;
+  for (uint16_t i = 0; i < file_header.compression_block_count; i++) {
+    uint32_t firstFrame = readUInt32();
+    uint32_t length = readUInt32();
+    if (length == 0)
+      continue;
+    blocks[blockCount].first_frame = firstFrame;
+    blocks[blockCount].offset = offset;
+    blocks[blockCount].length = length;
+    blockCount++;
+    offset += length;
+  }
+  return blockCount > 0 && decoder.begin(file_header.compression_type);
+}
+
+bool FSEQPlayer::readSparseRanges() {
+  if (file_header.sparse_range_count == 0)
+    return true;
+  ranges = static_cast<SparseRange *>(
+      d_malloc(sizeof(SparseRange) * file_header.sparse_range_count));
+  if (!ranges)
+    return false;
+  if (!FSEQHeader::readSparseRanges(recordingFile, file_header, ranges,
+                                    file_header.sparse_range_count))
+    return false;
+  for (uint8_t i = 0; i < file_header.sparse_range_count; i++)
+    DEBUG_PRINTF(" sparse range %d: %u + %u\n", i, ranges[i].start,
+                 ranges[i].length);
+  return true;
+}
+
+// Map the channel window of this node onto the stored frame data. Without
+// sparse ranges this is a single read, otherwise one read per range that
+// overlaps the window.
+bool FSEQPlayer::buildReadRuns(uint32_t ledCount) {
+  uint32_t windowLength = ledCount * 3;
+  if (channelLength > 0)
+    windowLength = min(windowLength, channelLength);
+
+  uint16_t maxRuns = ranges ? file_header.sparse_range_count : 1;
+  runs = static_cast<ReadRun *>(d_malloc(sizeof(ReadRun) * maxRuns));
+  if (!runs)
+    return false;
+  runCount = 0;
+
+  if (!ranges) {
+    if (channelOffset >= file_header.channel_count)
+      return false;
+    windowLength = min(windowLength, file_header.channel_count - channelOffset);
+    runs[0] = {channelOffset, 0, windowLength};
+    runCount = 1;
+  } else {
+    uint32_t stored = 0; // offset of the range in the stored frame
+    uint32_t windowEnd = channelOffset + windowLength;
+    for (uint8_t i = 0; i < file_header.sparse_range_count; i++) {
+      uint32_t lo = max(ranges[i].start, channelOffset);
+      uint32_t hi = min(ranges[i].start + ranges[i].length, windowEnd);
+      if (lo < hi) {
+        ReadRun run = {stored + lo - ranges[i].start, lo - channelOffset,
+                       hi - lo};
+        ReadRun *last = runCount ? &runs[runCount - 1] : nullptr;
+        if (last && last->src + last->length == run.src &&
+            last->dst + last->length == run.dst)
+          last->length += run.length; // adjacent ranges, merge
+        else
+          runs[runCount++] = run;
+      }
+      stored += ranges[i].length;
+    }
+    if (stored > file_header.channel_count) {
+      DEBUG_PRINTLN("[FSEQ] Sparse ranges exceed the stored channel count");
+      return false;
+    }
+  }
+
+  // the frame buffer is trimmed to the last channel that has data
+  frameBytes = 0;
+  for (uint16_t i = 0; i < runCount; i++)
+    frameBytes = max(frameBytes, runs[i].dst + runs[i].length);
+  frameBytes -= frameBytes % 3;
+  uint32_t covered = 0;
+  for (uint16_t i = 0; i < runCount; i++) {
+    if (runs[i].dst + runs[i].length > frameBytes)
+      runs[i].length = runs[i].dst < frameBytes ? frameBytes - runs[i].dst : 0;
+    covered += runs[i].length;
+  }
+  runsCoverFrame = covered >= frameBytes;
+  DEBUG_PRINTF("[FSEQ] Channels %u-%u in %u read(s) per frame\n",
+               channelOffset, channelOffset + frameBytes, runCount);
+  return frameBytes > 0;
+}
+
+void FSEQPlayer::setChannelWindow(uint32_t offset, uint32_t length) {
+  channelOffset = offset;
+  channelLength = length;
+}
+
+void FSEQPlayer::readVariableHeaders() {
+  char name[128];
+  FSEQHeader::readMediaFile(recordingFile, file_header, name, sizeof(name));
+  mediaFileName = name;
+}
+
+// last block starting at or before frameNumber
+int32_t FSEQPlayer::findBlock(uint32_t frameNumber) {
+  int32_t lo = 0, hi = (int32_t)blockCount - 1, found = -1;
+  while (lo <= hi) {
+    int32_t mid = (lo + hi) / 2;
+    if (blocks[mid].first_frame <= frameNumber) {
+      found = mid;
+      lo = mid + 1;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  return found;
+}
+
+bool FSEQPlayer::allocateRing() {
+  freeRing();
+  frameRing = static_cast<uint8_t *>(
+      d_malloc((size_t)frameBytes * FSEQ_READAHEAD_FRAMES));
+  if (!frameRing) {
+    DEBUG_PRINTF("[FSEQ] Failed to allocate %u byte read-ahead buffer\n",
+                 frameBytes * FSEQ_READAHEAD_FRAMES);
+    return false;
+  }
+  return true;
+}
+
+void FSEQPlayer::freeRing() {
+  if (frameRing)
+    d_free(frameRing);
+  frameRing = nullptr;
+  ringHead = 0;
+  ringFilled = 0;
+  fillRun = 0;
+  fillOffset = 0;
+}
+
+// drop everything buffered and continue reading ahead from startFrame
+void FSEQPlayer::resetReadAhead(uint32_t startFrame) {
+  ringHead = 0;
+  ringFilled = 0;
+  fillFrame = startFrame;
+  fillRun = 0;
+  fillOffset = 0;
+  fillReadUs = 0;
+}
+
+// read one chunk of the frame being filled, returns false if nothing was read
+bool FSEQPlayer::readChunk() {
+  uint32_t startUs = micros();
+  uint8_t filled = ringFilled;
+  bool ok = readChunkData();
+  fillReadUs += micros() - startUs;
+  if (ringFilled != filled) {
+    FSEQMetrics::sdRead.add(fillReadUs);
+    if (seeking)
+      FSEQMetrics::seek.add(fillReadUs);
+    seeking = false;
+    fillReadUs = 0;
+  }
+  return ok;
+}
+
+bool FSEQPlayer::readChunkData() {
+  if (!frameRing || !recordingFile || ringFilled >= FSEQ_READAHEAD_FRAMES)
+    return false;
+
+  if (fillFrame >= file_header.frame_count) {
+    // only wrap around when the recording is going to be repeated
+    if (recordingRepeats == RECORDING_REPEAT_DEFAULT)
+      return false;
+    fillFrame = 0;
+  }
+
+  uint8_t slot = (ringHead + ringFilled) % FSEQ_READAHEAD_FRAMES;
+  uint8_t *dst = frameRing + (size_t)slot * frameBytes;
+
+  // channels without data in the file stay black
+  if (fillRun == 0 && fillOffset == 0 && !runsCoverFrame)
+    memset(dst, 0, frameBytes);
+
+  if (fillRun < runCount) {
+    const ReadRun &run = runs[fillRun];
+    uint32_t length =
+        min(run.length - fillOffset, (uint32_t)FSEQ_READ_CHUNK_SIZE);
+    uint32_t src = run.src + fillOffset;
+    dst += run.dst + fillOffset;
+    size_t got;
+
+    if (file_header.compression_type != FSEQ_COMPRESSION_NONE) {
+      // jump to the block holding the frame, then decode up to the data
+      int32_t block = findBlock(fillFrame);
+      if (block < 0)
+        return false;
+      uint32_t target =
+          (fillFrame - blocks[block].first_frame) * file_header.channel_count +
+          src;
+      if (block != streamBlock || streamPos > target) {
+        streamBlock = -1;
+        if (!decoder.startBlock(recordingFile, blocks[block].offset,
+                                blocks[block].length)) {
+          DEBUG_PRINTF("[FSEQ] Failed to open compressed block %d\n", block);
+          return false;
+        }
+        streamBlock = block;
+        streamPos = 0;
+      }
+      if (streamPos < target) {
+        size_t skipped = decoder.read(
+            recordingFile, nullptr,
+            min(target - streamPos, (uint32_t)FSEQ_READ_CHUNK_SIZE));
+        streamPos += skipped;
+        if (skipped == 0) {
+          streamBlock = -1;
+          return false;
+        }
+        return true;
+      }
+      got = decoder.read(recordingFile, dst, length);
+      streamPos += got;
+      if (got < length)
+        streamBlock = -1;
+    } else {
+      uint32_t offset = file_header.channel_data_offset +
+                        file_header.channel_count * fillFrame + src;
+      if (recordingFile.position() != offset && !recordingFile.seek(offset)) {
+        DEBUG_PRINTLN("Failed to seek to proper offset for channel data!");
+        return false;
+      }
+      got = recordingFile.read(dst, length);
+    }
+
+    if (got < length) {
+      // truncated file: blank the rest so the frame is still usable
+      DEBUG_PRINTF("[FSEQ] Short read in frame %u (%u of %u bytes)\n",
+                   fillFrame, (unsigned)got, length);
+      memset(dst + got, 0, length - got);
+    }
+    fillOffset += length;
+    if (fillOffset < run.length)
+      return true;
+    fillOffset = 0;
+    if (++fillRun < runCount)
+      return true;
+  }
+
+  fillRun = 0;
+  fillFrame++;
+  ringFilled++;
+  return true;
+}
+
+// complete the frame currently being filled
+bool FSEQPlayer::readFrameAhead() {
+  uint8_t filled = ringFilled;
+  while (ringFilled == filled) {
+    if (!readChunk())
+      return false;
+  }
+  return true;
+}
+
+// top up the ring, spending at most budgetUs (but always at least one chunk)
+void FSEQPlayer::fillReadAhead(uint32_t budgetUs) {
+  uint32_t start = micros();
+  while (ringFilled < FSEQ_READAHEAD_FRAMES) {
+    if (!readChunk())
+      break;
+    if (micros() - start >= budgetUs)
+      break;
+  }
 }
 
 void FSEQPlayer::processFrameData() {
-  uint32_t packetLength = file_header.channel_count;
-  uint16_t lastLed =
-      min((uint32_t)playbackLedStop, (uint32_t)playbackLedStart + (packetLength / 3));
-    char frame_data[48];   // fixed size; buffer_size is always 48
-  CRGB *crgb = reinterpret_cast<CRGB *>(frame_data);
-  uint32_t bytes_remaining = packetLength;
-  uint16_t index = playbackLedStart;
-  while (index < lastLed && bytes_remaining > 0) {
-    uint16_t length = (uint16_t)min(bytes_remaining, (uint32_t)sizeof(frame_data));
-    recordingFile.readBytes(frame_data, length);
-    bytes_remaining -= length;
-    for (uint16_t offset = 0; offset < length / 3; offset++) {
-      setRealtimePixel(index, crgb[offset].r, crgb[offset].g, crgb[offset].b,
-                       0);
-      if (++index > lastLed)
-        break;
+  shownFrames++;
+  FSEQMetrics::framesShown++;
+  if (directFrames) {
+    const uint8_t *data = recordingFile.peek(
+        file_header.channel_data_offset +
+            file_header.channel_count * frame + runs[0].src,
+        frameBytes);
+    setRealtimePixels(playbackLedStart, data, frameBytes / 3);
+    return;
+  }
+
+  if (ringFilled == 0) {
+    // read-ahead fell behind, fetch the frame on demand
+    underruns++;
+    FSEQMetrics::underruns++;
+    if (!readFrameAhead()) {
+      DEBUG_PRINTF("[FSEQ] No data for frame %u\n", frame);
+      return;
     }
   }
-  strip.show();
-  realtimeLock(3000, REALTIME_MODE_FSEQ);
-  next_time = now + file_header.step_time;
+
+  const uint8_t *data = frameRing + (size_t)ringHead * frameBytes;
+  setRealtimePixels(playbackLedStart, data, frameBytes / 3);
+  ringHead = (ringHead + 1) % FSEQ_READAHEAD_FRAMES;
+  ringFilled--;
+}
+
+// drop frames that are already overdue, keeping buffered ones that follow
+void FSEQPlayer::skipFrames(uint32_t count) {
+  timing.droppedFrames += count;
+  FSEQMetrics::skippedFrames += count;
+  while (count > 0 && ringFilled > 0 && frame < file_header.frame_count) {
+    ringHead = (ringHead + 1) % FSEQ_READAHEAD_FRAMES;
+    ringFilled--;
+    frame++;
+    count--;
+  }
+  if (count > 0) {
+    frame = min(frame + count, file_header.frame_count);
+    resetReadAhead(frame);
+  }
+}
+
+// let the schedule run slightly faster or slower than the local clock
+void FSEQPlayer::applyRateCorrection(int64_t nowUs) {
+  if (ratePpm != 0 && lastRateUs != 0) {
+    rateAccum += (nowUs - lastRateUs) * ratePpm;
+    epochUs -= rateAccum / 1000000;
+    rateAccum %= 1000000;
+  }
+  lastRateUs = nowUs;
 }
 
 bool FSEQPlayer::stopBecauseAtTheEnd() {
@@ -113,22 +435,22 @@ bool FSEQPlayer::stopBecauseAtTheEnd() {
   // If we reached the last frame
   if (frame >= file_header.frame_count) {
 
+    // the read-ahead ring has already wrapped to the first frame
     if (recordingRepeats == RECORDING_REPEAT_LOOP) {
       frame = 0;
-      recordingFile.seek(file_header.channel_data_offset);
+      epochUs += (int64_t)file_header.frame_count * stepUs;
       return false;
     }
 
     if (recordingRepeats > 0) {
       recordingRepeats--;
       frame = 0;
-      recordingFile.seek(file_header.channel_data_offset);
+      epochUs += (int64_t)file_header.frame_count * stepUs;
       DEBUG_PRINTF("Repeat recording again for: %d\n", recordingRepeats);
       return false;
     }
 
-    DEBUG_PRINTLN("Finished playing recording, disabling realtime mode");
-    realtimeLock(10, REALTIME_MODE_INACTIVE);
+    DEBUG_PRINTLN("Finished playing recording");
     clearLastPlayback();
     return true;
   }
@@ -139,24 +461,41 @@ bool FSEQPlayer::stopBecauseAtTheEnd() {
 void FSEQPlayer::playNextRecordingFrame() {
   if (stopBecauseAtTheEnd())
     return;
-  uint32_t offset = file_header.channel_count * frame++;
-  offset += file_header.channel_data_offset;
-  if (!recordingFile.seek(offset)) {
-    if (recordingFile.position() != offset) {
-      DEBUG_PRINTLN("Failed to seek to proper offset for channel data!");
-      return;
-    }
-  }
   processFrameData();
+  frame++;
 }
 
-void FSEQPlayer::handlePlayRecording() {
-  now = millis();
-  if (realtimeMode != REALTIME_MODE_FSEQ)
-    return;
-  if (now < next_time)
-    return;
+bool FSEQPlayer::handlePlayRecording(int64_t nowUs) {
+  if (!isActive())
+    return false;
+
+  applyRateCorrection(nowUs);
+  uint32_t seekTo = seekRequest;
+  if (seekTo != 0) {
+    seekRequest = 0;
+    if (seekTo - 1 < file_header.frame_count) {
+      jumpToFrame(seekTo - 1, nowUs - (int64_t)(seekTo - 1) * stepUs);
+      DEBUG_PRINTF("[FSEQ] Seek -> frame=%lu\n", (unsigned long)(seekTo - 1));
+    }
+  }
+  int64_t dueUs = epochUs + (int64_t)frame * stepUs;
+  if (nowUs < dueUs)
+    return false;
+
+  // the frame to show is derived from the epoch, so a late frame
+  // does not delay the ones after it
+  uint32_t target = (uint32_t)((nowUs - epochUs) / stepUs);
+  if (target > frame) {
+    skipFrames(target - frame);
+    dueUs = epochUs + (int64_t)frame * stepUs;
+  }
+  uint32_t lateUs = (uint32_t)min(nowUs - dueUs, (int64_t)UINT32_MAX);
+  timing.jitterAvgUs = (timing.jitterAvgUs * 7 + lateUs) / 8;
+  timing.jitterMaxUs = max(timing.jitterMaxUs, lateUs);
+  if (lateUs > stepUs / FSEQ_LATE_FRAME_DIV)
+    FSEQMetrics::lateFrames++;
   playNextRecordingFrame();
+  return true;
 }
 
 void FSEQPlayer::loadRecording(const char *filepath,
@@ -165,87 +504,192 @@ void FSEQPlayer::loadRecording(const char *filepath,
                                float secondsElapsed,
                                bool loop)
 {
-  if (recordingFile.available()) {
+  if (!isPreparedFor(filepath, startLed, stopLed) &&
+      !openRecording(filepath, startLed, stopLed))
+    return;
+  uint32_t startFrame =
+      (uint32_t)((secondsElapsed * 1000.0f) / file_header.step_time);
+  startPlayback(startFrame, (int64_t)(secondsElapsed * 1000000.0f), loop);
+}
+
+void FSEQPlayer::loadRecordingAtFrame(const char *filepath,
+                                      uint16_t startLed,
+                                      uint16_t stopLed,
+                                      uint32_t startFrame,
+                                      bool loop)
+{
+  if (!isPreparedFor(filepath, startLed, stopLed) &&
+      !openRecording(filepath, startLed, stopLed))
+    return;
+  startPlayback(startFrame, (int64_t)startFrame * stepUs, loop);
+}
+
+// open a recording and buffer its first frames without starting it, so a
+// following start does not have to wait for the SD card
+bool FSEQPlayer::prepareRecording(const char *filepath,
+                                  uint16_t startLed,
+                                  uint16_t stopLed)
+{
+  if (isPreparedFor(filepath, startLed, stopLed))
+    return true;
+  if (!openRecording(filepath, startLed, stopLed))
+    return false;
+  fillReadAhead(UINT32_MAX);
+  DEBUG_PRINTF("[FSEQ] Prepared %s (%u frames buffered)\n", filepath,
+               ringFilled);
+  return true;
+}
+
+void FSEQPlayer::resolveLedRange(uint16_t &startLed, uint16_t &stopLed) {
+  if (startLed == uint16_t(-1) || stopLed == uint16_t(-1)) {
+    Segment sg = strip.getSegment(-1);
+    startLed = sg.start;
+    stopLed = sg.stop;
+  }
+}
+
+bool FSEQPlayer::isPreparedFor(const char *filepath, uint16_t startLed,
+                               uint16_t stopLed) {
+  if (started || !recordingFile)
+    return false;
+  resolveLedRange(startLed, stopLed);
+  const char *name = (filepath[0] == '/') ? filepath + 1 : filepath;
+  return currentFileName == name && startLed == playbackLedStart &&
+         stopLed == playbackLedStop;
+}
+
+bool FSEQPlayer::openRecording(const char *filepath,
+                               uint16_t startLed,
+                               uint16_t stopLed)
+{
+  if (recordingFile) {
     clearLastPlayback();
   }
+  started = false;
+  uint32_t openStartUs = micros();
+  resolveLedRange(startLed, stopLed);
   playbackLedStart = startLed;
   playbackLedStop = stopLed;
-  if (playbackLedStart == uint16_t(-1) || playbackLedStop == uint16_t(-1)) {
-    Segment sg = strip.getSegment(-1);
-    playbackLedStart = sg.start;
-    playbackLedStop = sg.stop;
-  }
   DEBUG_PRINTF("FSEQ load animation on LED %d to %d\n", playbackLedStart,
                playbackLedStop);
-  if (fileOnSD(filepath)) {
+  if (FSEQFlashStore::open(filepath, recordingFile)) {
+    DEBUG_PRINTF("Read file from flash partition: %s\n", filepath);
+    source = SOURCE_FLASH;
+  } else if (FSEQSequenceCache::take(filepath, recordingFile)) {
+    DEBUG_PRINTF("Read file from cache: %s (%u bytes cached)\n", filepath,
+                 recordingFile.cachedBytes());
+    source = SOURCE_CACHE;
+  } else if (fileOnSD(filepath)) {
     DEBUG_PRINTF("Read file from SD: %s\n", filepath);
-    recordingFile = SD_ADAPTER.open(filepath, "rb");
-    currentFileName = String(filepath);
-    if (currentFileName.startsWith("/"))
-      currentFileName = currentFileName.substring(1);
+    recordingFile.attach(SD_ADAPTER.open(filepath, "rb"));
+    source = SOURCE_SD;
   } else if (fileOnFS(filepath)) {
     DEBUG_PRINTF("Read file from FS: %s\n", filepath);
-	recordingFile = WLED_FS.open(filepath, "rb");
-    currentFileName = String(filepath);
-    if (currentFileName.startsWith("/"))
-      currentFileName = currentFileName.substring(1);
+	recordingFile.attach(WLED_FS.open(filepath, "r"));
+    source = SOURCE_FS;
   } else {
     DEBUG_PRINTF("File %s not found (%s)\n", filepath,
                  USED_STORAGE_FILESYSTEMS);
-    return;
+    return false;
   }
-  if ((uint64_t)recordingFile.available() < sizeof(file_header)) {
+  currentFileName = String(filepath);
+  if (currentFileName.startsWith("/"))
+    currentFileName = currentFileName.substring(1);
+  if ((uint64_t)recordingFile.available() < FSEQ_HEADER_MIN_SIZE) {
     DEBUG_PRINTF("Invalid file size: %d\n", recordingFile.available());
-    recordingFile.close();
-    return;
+    closeRecording();
+    return false;
   }
-  for (int i = 0; i < 4; i++) {
-    file_header.identifier[i] = readUInt8();
-  }
-  file_header.channel_data_offset = readUInt16();
-  file_header.minor_version = readUInt8();
-  file_header.major_version = readUInt8();
-  file_header.header_length = readUInt16();
-  file_header.channel_count = readUInt32();
-  file_header.frame_count = readUInt32();
-  file_header.step_time = readUInt8();
-  file_header.flags = readUInt8();
-  printHeaderInfo();
-  if (file_header.identifier[0] != 'P' || file_header.identifier[1] != 'S' ||
-      file_header.identifier[2] != 'E' || file_header.identifier[3] != 'Q') {
-    DEBUG_PRINTF("Error reading FSEQ file %s header, invalid identifier\n",
-                 filepath);
-    recordingFile.close();
-    return;
+  if (!readHeader(filepath)) {
+    closeRecording();
+    return false;
   }
-  if (((uint64_t)file_header.channel_count *
+  printHeaderInfo();
+  if (file_header.compression_type == FSEQ_COMPRESSION_NONE &&
+      ((uint64_t)file_header.channel_count *
        (uint64_t)file_header.frame_count) +
-          file_header.header_length >
-      UINT32_MAX) {
+              file_header.channel_data_offset >
+          UINT32_MAX) {
     DEBUG_PRINTF("Error reading FSEQ file %s header, file too long (max 4gb)\n",
                  filepath);
-    recordingFile.close();
-    return;
+    closeRecording();
+    return false;
   }
   if (file_header.step_time < 1) {
     DEBUG_PRINTF("Invalid step time %d, using default %d instead\n",
                  file_header.step_time, FSEQ_DEFAULT_STEP_TIME);
     file_header.step_time = FSEQ_DEFAULT_STEP_TIME;
   }
+  stepUs = file_header.step_time * 1000;
+
+  uint32_t ledCount = playbackLedStop > playbackLedStart
+                          ? playbackLedStop - playbackLedStart
+                          : 0;
+  if (file_header.frame_count == 0 || !buildReadRuns(ledCount)) {
+    DEBUG_PRINTF("Nothing to play from %s\n", filepath);
+    closeRecording();
+    return false;
+  }
+  // frames of a sequence that is completely in memory (flash mapping or a
+  // small cached file) are shown straight from there, without read-ahead
+  directFrames =
+      file_header.compression_type == FSEQ_COMPRESSION_NONE &&
+      runCount == 1 && runsCoverFrame &&
+      recordingFile.peek(file_header.channel_data_offset,
+                         file_header.channel_count *
+                             file_header.frame_count) != nullptr;
+  if (!directFrames && !allocateRing()) {
+    DEBUG_PRINTF("Nothing to play from %s\n", filepath);
+    closeRecording();
+    return false;
+  }
+  frame = 0;
+  recordingRepeats = RECORDING_REPEAT_DEFAULT;
+  resetReadAhead(0);
+  FSEQMetrics::fileOpen.add(micros() - openStartUs);
+  return true;
+}
+
+// start an opened recording at startFrame, positionUs is the matching
+// (possibly sub-frame) playback time used for the schedule
+void FSEQPlayer::startPlayback(uint32_t startFrame, int64_t positionUs,
+                               bool loop)
+{
   if (realtimeOverride == REALTIME_OVERRIDE_ONCE) {
     realtimeOverride = REALTIME_OVERRIDE_NONE;
   }
-  frame = (uint32_t)((secondsElapsed * 1000.0f) / file_header.step_time);
-  if (frame >= file_header.frame_count) {
-    frame = file_header.frame_count - 1;
+  if (startFrame >= file_header.frame_count) {
+    startFrame = file_header.frame_count - 1;
   }
-  // Set loop mode if secondsElapsed is exactly 1.0f
   recordingRepeats = loop
     ? RECORDING_REPEAT_LOOP
     : RECORDING_REPEAT_DEFAULT;
-	
+
+  // keep frames buffered by prepareRecording() if they are the right ones
+  bool buffered = ringFilled > 0 && fillFrame >= ringFilled &&
+                  fillFrame - ringFilled == startFrame;
+  if (!buffered)
+    resetReadAhead(startFrame);
+  frame = startFrame;
+
+  epochUs = esp_timer_get_time() - positionUs;
+  ratePpm = 0;
+  rateAccum = 0;
+  lastRateUs = 0;
+  lastSyncUs = 0;
+  timing = {};
+  underruns = 0;
+  playStartUs = esp_timer_get_time();
+  shownFrames = 0;
+  if (ringFilled == 0 && !directFrames)
+    readFrameAhead(); // first frame is shown right away
+
+  started = true;
   playNextRecordingFrame();
-  //playNextRecordingFrame();
+  uint32_t showStartUs = micros();
+  strip.show();
+  FSEQMetrics::show.add(micros() - showStartUs);
+  realtimeLock(3000, REALTIME_MODE_FSEQ);
 }
 
 void FSEQPlayer::clearLastPlayback() {
@@ -253,16 +697,64 @@ void FSEQPlayer::clearLastPlayback() {
     setRealtimePixel(i, 0, 0, 0, 0);
   }
   frame = 0;
+  started = false;
+  closeRecording();
+}
+
+// release the file and all buffers of the current recording
+void FSEQPlayer::closeRecording() {
   recordingFile.close();
+  freeRing();
+  decoder.end();
+  if (blocks)
+    d_free(blocks);
+  blocks = nullptr;
+  blockCount = 0;
+  streamBlock = -1;
+  seeking = false;
+  seekRequest = 0;
+  if (ranges)
+    d_free(ranges);
+  ranges = nullptr;
+  if (runs)
+    d_free(runs);
+  runs = nullptr;
+  runCount = 0;
+  directFrames = false;
+  source = SOURCE_NONE;
   currentFileName = "";
 }
 
+bool FSEQPlayer::hasReadSlack() {
+  return !recordingFile || directFrames || ringFilled >= FSEQ_READAHEAD_FRAMES ||
+         (fillFrame >= file_header.frame_count &&
+          recordingRepeats == RECORDING_REPEAT_DEFAULT);
+}
+
 bool FSEQPlayer::isPlaying() {
-  return recordingFile && frame < file_header.frame_count;
+  return started && recordingFile && frame < file_header.frame_count;
 }
 
 String FSEQPlayer::getFileName() { return currentFileName; }
 
+const char *FSEQPlayer::getSourceName() {
+  switch (source) {
+  case SOURCE_SD:    return "sd";
+  case SOURCE_CACHE: return "cache";
+  case SOURCE_FS:    return "fs";
+  case SOURCE_FLASH: return "flash";
+  default:           return "";
+  }
+}
+
+// frames actually shown per second since playback started
+float FSEQPlayer::getFps() {
+  int64_t elapsedUs = esp_timer_get_time() - playStartUs;
+  if (!isPlaying() || elapsedUs <= 0)
+    return 0;
+  return shownFrames * 1000000.0f / elapsedUs;
+}
+
 float FSEQPlayer::getElapsedSeconds() {
   if (!isPlaying())
     return 0;
@@ -273,68 +765,89 @@ float FSEQPlayer::getElapsedSeconds() {
   return (float)frame * (float)file_header.step_time / 1000.0f;
 }
 
+float FSEQPlayer::getRemainingSeconds() {
+  if (!isPlaying())
+    return 0;
+  return (float)(file_header.frame_count - frame) * file_header.step_time /
+         1000.0f;
+}
+
+bool FSEQPlayer::requestSeek(uint32_t frameNumber) {
+  if (!isPlaying() || frameNumber >= file_header.frame_count)
+    return false;
+  seekRequest = frameNumber + 1; // taken by handlePlayRecording()
+  return true;
+}
+
+void FSEQPlayer::jumpToFrame(uint32_t frameNumber, int64_t newEpochUs) {
+  epochUs = newEpochUs;
+  frame = frameNumber;
+  lastSyncUs = 0; // rate estimate restarts with the next sync
+  // buffered frames are stale, the next read seeks to the new position
+  resetReadAhead(frame);
+  seeking = true;
+}
+
 void FSEQPlayer::syncPlayback(float secondsElapsed) {
+  syncToPosition((int64_t)(secondsElapsed * 1000000.0f));
+}
+
+// frame numbers from the master are exact, no float seconds round trip
+void FSEQPlayer::syncPlaybackFrame(uint32_t frameNumber, int64_t receivedUs) {
+  int64_t masterUs = (int64_t)frameNumber * stepUs;
+  if (receivedUs != 0)
+    masterUs += esp_timer_get_time() - receivedUs; // the master moved on since
+  syncToPosition(masterUs);
+}
+
+void FSEQPlayer::syncToPosition(int64_t masterUs) {
 
   if (!isPlaying()) {
     DEBUG_PRINTLN("[FSEQ] Sync: Playback not active, cannot sync.");
     return;
   }
 
-  uint32_t expectedFrame =
-      (uint32_t)((secondsElapsed * 1000.0f) / file_header.step_time);
-
-  int32_t diff = (int32_t)expectedFrame - (int32_t)frame;
+  int64_t nowUs = esp_timer_get_time();
+  applyRateCorrection(nowUs);
+  int64_t errorUs = masterUs - (nowUs - epochUs); // > 0: we are behind
+  timing.driftUs = (int32_t)constrain(errorUs, (int64_t)INT32_MIN,
+                                      (int64_t)INT32_MAX);
 
   // -------------------------------
   // Hard Resync
   // -------------------------------
-  if (abs(diff) > 30) {
-
-    frame = expectedFrame;
+  if (llabs(errorUs) > (int64_t)FSEQ_HARD_SYNC_FRAMES * stepUs) {
 
-    uint32_t offset =
-        file_header.channel_data_offset +
-        (uint32_t)file_header.channel_count * frame;
-
-    if (recordingFile.seek(offset)) {
-      DEBUG_PRINTF("[FSEQ] HARD Sync -> frame=%lu (diff=%ld)\n",
-                   expectedFrame, diff);
-    } else {
-      DEBUG_PRINTLN("[FSEQ] HARD Sync failed to seek");
+    uint32_t expectedFrame = (uint32_t)(masterUs / stepUs);
+    if (masterUs < 0 || expectedFrame >= file_header.frame_count) {
+      DEBUG_PRINTLN("[FSEQ] HARD Sync target beyond end of recording");
+      return;
     }
+    jumpToFrame(expectedFrame, nowUs - masterUs);
+    FSEQMetrics::hardSyncs++;
+    DEBUG_PRINTF("[FSEQ] HARD Sync -> frame=%lu (error=%lldus)\n",
+                 (unsigned long)expectedFrame, errorUs);
 
     return;
   }
 
   // -----------------------------------------
-  // Soft Sync
+  // Soft Sync (PLL)
   // -----------------------------------------
-  if (abs(diff) > 1) {
-
-    // Proportionaler Faktor wächst mit Drift
-    float correctionFactor = 0.05f * abs(diff);
-
-    // Begrenzen damit es nicht aggressiv wird
-    correctionFactor = constrain(correctionFactor, 0.05f, 0.4f);
-
-    int32_t timeAdjustment =
-        (int32_t)(diff * file_header.step_time * correctionFactor);
-
-    next_time -= timeAdjustment;
-
-    DEBUG_PRINTF(
-        "[FSEQ] Soft Sync diff=%ld factor=%.3f adjust=%ldus\n",
-        diff,
-        correctionFactor,
-        timeAdjustment
-    );
-
-  } else {
-
-    DEBUG_PRINTF(
-        "[FSEQ] Sync OK (current=%lu expected=%lu)\n",
-        frame,
-        expectedFrame
-    );
+  FSEQMetrics::softSyncs++;
+  // phase: move the schedule a fraction of the error towards the master
+  epochUs -= errorUs / FSEQ_PLL_PHASE_DIV;
+
+  // frequency: the error left over since the last sync is caused by the
+  // clock rate difference, integrate it into the rate correction
+  if (lastSyncUs != 0 && nowUs > lastSyncUs) {
+    int64_t ppm = errorUs * 1000000 / (nowUs - lastSyncUs);
+    ratePpm = constrain(ratePpm + (int32_t)(ppm / FSEQ_PLL_FREQ_DIV),
+                        -FSEQ_PLL_MAX_PPM, FSEQ_PLL_MAX_PPM);
+    timing.ratePpm = ratePpm;
   }
+  lastSyncUs = nowUs;
+
+  DEBUG_PRINTF("[FSEQ] Soft Sync error=%lldus rate=%ldppm\n", errorUs,
+               (long)ratePpm);
 }
@@ -8,7 +8,40 @@
 #define RECORDING_REPEAT_DEFAULT 0
 #endif
 
+// number of full-frame buffers kept filled ahead of playback (min 2)
+#ifndef FSEQ_READAHEAD_FRAMES
+#define FSEQ_READAHEAD_FRAMES 3
+#endif
+// largest single SD read issued while filling ahead
+#ifndef FSEQ_READ_CHUNK_SIZE
+#define FSEQ_READ_CHUNK_SIZE 4096
+#endif
+// time spent filling ahead per loop() iteration (microseconds)
+#ifndef FSEQ_READ_BUDGET_US
+#define FSEQ_READ_BUDGET_US 4000
+#endif
+
+// sync errors above this many frames jump instead of being slewed
+#ifndef FSEQ_HARD_SYNC_FRAMES
+#define FSEQ_HARD_SYNC_FRAMES 30
+#endif
+// PLL gains, applied as divisors of the measured sync error
+#ifndef FSEQ_PLL_PHASE_DIV
+#define FSEQ_PLL_PHASE_DIV 4
+#endif
+#ifndef FSEQ_PLL_FREQ_DIV
+#define FSEQ_PLL_FREQ_DIV 8
+#endif
+// limit of the learned clock rate correction (ppm)
+#ifndef FSEQ_PLL_MAX_PPM
+#define FSEQ_PLL_MAX_PPM 2000
+#endif
+
+#include "fseq_cache.h"
+#include "fseq_decoder.h"
+#include "fseq_header.h"
 #include "wled.h"
+#include <esp_timer.h>
 #ifdef WLED_USE_SD_SPI
 #include <SD.h>
 #include <SPI.h>
@@ -18,59 +51,187 @@
 
 class FSEQPlayer {
 public:
-  struct FileHeader {
-    uint8_t identifier[4];
-    uint16_t channel_data_offset;
-    uint8_t minor_version;
-    uint8_t major_version;
-    uint16_t header_length;
-    uint32_t channel_count;
-    uint32_t frame_count;
-    uint8_t step_time;
-    uint8_t flags;
+  typedef FSEQFileHeader FileHeader;
+  typedef FSEQSparseRange SparseRange;
+
+  // v2 compressed frame block, frames first_frame up to the next block's
+  struct CompressionBlock {
+    uint32_t first_frame;
+    uint32_t offset;
+    uint32_t length;
   };
 
-  static void loadRecording(const char *filepath,
+  // frame timing, reported in /api/fseq/status
+  struct TimingStats {
+    uint32_t jitterAvgUs;   // average deviation of shown frames from schedule
+    uint32_t jitterMaxUs;
+    uint32_t droppedFrames; // frames skipped to catch up with the schedule
+    int32_t driftUs;        // offset to the sync master at the last sync
+    int32_t ratePpm;        // learned clock rate correction
+  };
+
+  FSEQPlayer() {}
+  ~FSEQPlayer() { closeRecording(); }
+
+  void loadRecording(const char *filepath,
+                     uint16_t startLed,
+                     uint16_t stopLed,
+                     float secondsElapsed = 0.0f,
+                     bool loop = false);
+  void loadRecordingAtFrame(const char *filepath,
                             uint16_t startLed,
                             uint16_t stopLed,
-                            float secondsElapsed = 0.0f,
+                            uint32_t startFrame,
                             bool loop = false);
-  static void handlePlayRecording();
-  static void clearLastPlayback();
-  static void syncPlayback(float secondsElapsed);
-  static bool isPlaying();
-  static String getFileName();
-  static float getElapsedSeconds();
+  bool prepareRecording(const char *filepath,
+                        uint16_t startLed,
+                        uint16_t stopLed);
+  // write the frame that is due, returns true if the LEDs changed
+  bool handlePlayRecording(int64_t nowUs);
+  void clearLastPlayback();
+  void syncPlayback(float secondsElapsed);
+  // receivedUs: when the master was at frameNumber, 0 for now
+  void syncPlaybackFrame(uint32_t frameNumber, int64_t receivedUs = 0);
+  // jump to frameNumber with the next loop() and keep playing from there,
+  // may be called from other tasks; false if nothing plays or the frame is
+  // past the end
+  bool requestSeek(uint32_t frameNumber);
+  bool isPlaying();
+  float getDurationSeconds() { return FSEQHeader::getDuration(file_header); }
+  float getRemainingSeconds();
+  String getMediaFileName() { return mediaFileName; }
+  // a file is open and started (playing or paused by a realtime override)
+  bool isActive() { return started && recordingFile; }
+  bool isOpen() { return (bool)recordingFile; }
+  String getFileName();
+  float getElapsedSeconds();
+  // where the frames come from: "sd", "cache", "fs" or "flash"
+  const char *getSourceName();
+  float getFps();
+  float getTargetFps() { return isActive() ? 1000000.0f / stepUs : 0; }
+  const TimingStats &getTimingStats() { return timing; }
+  uint16_t getLedStart() { return playbackLedStart; }
+  uint16_t getLedStop() { return playbackLedStop; }
 
-private:
-  FSEQPlayer() {}
+  // read-ahead, driven by FSEQPlayerManager for all players together
+  bool hasReadSlack(); // true while the read-ahead does not need the SD card
+  uint8_t getBufferedFrames() { return ringFilled; }
+  bool readFrameAhead();
+  // frames come from the SD card (not from memory, LittleFS or flash)
+  bool readsSD() {
+    return (source == SOURCE_SD || source == SOURCE_CACHE) && !directFrames;
+  }
+  // esp_timer time the next frame is due at
+  int64_t getNextFrameUs() { return epochUs + (int64_t)frame * stepUs; }
+  uint32_t getStepUs() { return stepUs; }
+  // extend the seek index of the open file by one step, see FSEQCachedFile
+  bool buildSeekIndex() { return readsSD() && recordingFile.buildSeekIndex(); }
+  uint8_t getSeekAnchors() { return recordingFile.getSeekAnchors(); }
 
+  // sequence channels this player shows, starting at its first LED
+  void setChannelWindow(uint32_t offset, uint32_t length);
+  uint32_t getChannelOffset() { return channelOffset; }
+  uint32_t getChannelLength() { return channelLength; }
+
+private:
   static const int FSEQ_DEFAULT_STEP_TIME = 50;
+  static const int FSEQ_HEADER_MIN_SIZE = 28;
+
+  enum Source : uint8_t {
+    SOURCE_NONE,
+    SOURCE_SD,
+    SOURCE_CACHE, // SD file with its start cached in memory
+    SOURCE_FS,
+    SOURCE_FLASH  // memory mapped flash partition
+  };
+
+  FSEQCachedFile recordingFile;
+  Source source = SOURCE_NONE;
+  bool started = false;         // false while only prepared
+  bool directFrames = false;    // frames are read in place, no read-ahead
+  String currentFileName;
+  int32_t recordingRepeats = RECORDING_REPEAT_DEFAULT;
+  // Frame schedule: frame n is due at epochUs + n * stepUs (esp_timer time).
+  // The epoch is moved by sync corrections and the learned clock rate.
+  int64_t epochUs = 0;
+  uint32_t stepUs = FSEQ_DEFAULT_STEP_TIME * 1000;
+  int32_t ratePpm = 0;
+  int64_t rateAccum = 0;        // rate correction not yet applied (us * 1e6)
+  int64_t lastRateUs = 0;
+  int64_t lastSyncUs = 0;
+  TimingStats timing = {};
+  int64_t playStartUs = 0;
+  uint32_t shownFrames = 0;
+  uint16_t playbackLedStart = 0;
+  uint16_t playbackLedStop = uint16_t(-1);
+  uint32_t frame = 0;
+  FileHeader file_header = {};
+  String mediaFileName;
+
+  // compressed (v2) files: block table and position of the decoded stream
+  CompressionBlock *blocks = nullptr;
+  uint16_t blockCount = 0;
+  FSEQBlockDecoder decoder;
+  int32_t streamBlock = -1;     // block being decoded, -1 if none
+  uint32_t streamPos = 0;       // decoded bytes of streamBlock consumed
+
+  // channel window of this player and the reads needed to fill it per frame
+  struct ReadRun {
+    uint32_t src;    // offset in the stored frame
+    uint32_t dst;    // offset in the frame buffer
+    uint32_t length;
+  };
+  uint32_t channelOffset = 0;   // first sequence channel (0 based)
+  uint32_t channelLength = 0;   // 0 = as many as the LED range holds
+  SparseRange *ranges = nullptr;
+  ReadRun *runs = nullptr;
+  uint16_t runCount = 0;
+  bool runsCoverFrame = true;   // no gaps to blank between the runs
+
+  // read-ahead ring: frames are read from SD in chunks between shown frames
+  uint8_t *frameRing = nullptr; // FSEQ_READAHEAD_FRAMES buffers of frameBytes
+  uint32_t frameBytes = 0;      // channel bytes used per frame
+  uint8_t ringHead = 0;         // slot holding the next frame to show
+  uint8_t ringFilled = 0;       // complete frames buffered ahead
+  uint32_t fillFrame = 0;       // frame number currently being read ahead
+  uint16_t fillRun = 0;         // read run of fillFrame in progress
+  uint32_t fillOffset = 0;      // bytes of that run already read
+  uint32_t fillReadUs = 0;      // time spent reading fillFrame so far
+  uint32_t underruns = 0;       // frames that had to be read on demand
+  bool seeking = false;         // fillFrame is the first frame after a jump
+  volatile uint32_t seekRequest = 0; // frame + 1 to jump to, 0 = none
 
-  static File recordingFile;
-  static String currentFileName;
-  static float secondsElapsed;
-  static uint8_t colorChannels;
-  static int32_t recordingRepeats;
-  static uint32_t now;
-  static uint32_t next_time;
-  static uint16_t playbackLedStart;
-  static uint16_t playbackLedStop;
-  static uint32_t frame;
-  static uint16_t buffer_size;
-  static FileHeader file_header;
-
-  static inline uint32_t readUInt32();
-  static inline uint32_t readUInt24();
-  static inline uint16_t readUInt16();
-  static inline uint8_t readUInt8();
+  inline uint32_t readUInt32();
 
+  static void resolveLedRange(uint16_t &startLed, uint16_t &stopLed);
+  bool isPreparedFor(const char *filepath, uint16_t startLed,
+                     uint16_t stopLed);
+  bool openRecording(const char *filepath, uint16_t startLed,
+                     uint16_t stopLed);
+  void startPlayback(uint32_t startFrame, int64_t positionUs, bool loop);
+  void syncToPosition(int64_t masterUs);
+  void jumpToFrame(uint32_t frameNumber, int64_t newEpochUs);
   static bool fileOnSD(const char *filepath);
   static bool fileOnFS(const char *filepath);
-  static void printHeaderInfo();
-  static void processFrameData();
-  static bool stopBecauseAtTheEnd();
-  static void playNextRecordingFrame();
+  bool readHeader(const char *filepath);
+  bool readCompressionBlocks();
+  bool readSparseRanges();
+  bool buildReadRuns(uint32_t ledCount);
+  void readVariableHeaders();
+  int32_t findBlock(uint32_t frameNumber);
+  void printHeaderInfo();
+  bool allocateRing();
+  void freeRing();
+  void resetReadAhead(uint32_t startFrame);
+  bool readChunk();
+  bool readChunkData();
+  void fillReadAhead(uint32_t budgetUs);
+  void processFrameData();
+  void closeRecording();
+  void skipFrames(uint32_t count);
+  void applyRateCorrection(int64_t nowUs);
+  bool stopBecauseAtTheEnd();
+  void playNextRecordingFrame();
 };
 
 #endif // FSEQ_PLAYER_H
\ No newline at end of file
@@ -0,0 +1,277 @@
+#include "fseq_recorder.h"
+#include "fseq_io.h"
+#include "fseq_remote.h"
+#include "fseq_upload.h"
+#include "usermod_fseq.h"
+
+TaskHandle_t FSEQRecorder::task = nullptr;
+SemaphoreHandle_t FSEQRecorder::captureLock = nullptr;
+e131_packet_callback_function FSEQRecorder::previousE131 = nullptr;
+e131_packet_callback_function FSEQRecorder::previousDDP = nullptr;
+
+uint8_t *FSEQRecorder::ring = nullptr;
+uint32_t FSEQRecorder::ringMask = 0;
+volatile uint32_t FSEQRecorder::writePos = 0;
+volatile uint32_t FSEQRecorder::readPos = 0;
+volatile bool FSEQRecorder::recording = false;
+volatile bool FSEQRecorder::stopping = false;
+volatile bool FSEQRecorder::failed = false;
+bool FSEQRecorder::saved = false;
+
+File FSEQRecorder::file;
+String FSEQRecorder::fileName = "";
+uint32_t FSEQRecorder::channels = 0;
+uint32_t FSEQRecorder::frames = 0;
+uint32_t FSEQRecorder::dropped = 0;
+int64_t FSEQRecorder::firstFrameUs = 0;
+int64_t FSEQRecorder::lastFrameUs = 0;
+uint16_t FSEQRecorder::lastUniverse = 0;
+bool FSEQRecorder::ddpSeenPush = false;
+
+// the writer task is created with the first recording
+bool FSEQRecorder::init() {
+  if (task)
+    return true;
+  captureLock = xSemaphoreCreateMutex();
+  if (!captureLock)
+    return false;
+  return xTaskCreatePinnedToCore(writerTask, "fseqRecord", 4096, nullptr, 1,
+                                 &task, tskNO_AFFINITY) == pdPASS;
+}
+
+bool FSEQRecorder::start(const char *filepath) {
+  // remote mode shows DDP frames later than they arrive
+  if (recording || stopping || SDManager::isSuspended() ||
+      FSEQRemoteBuffer::isEnabled() || !init())
+    return false;
+  channels = strip.getLengthTotal() * 3;
+  if (channels == 0)
+    return false;
+
+  for (uint32_t size = FSEQ_RECORD_BUFFER_KB * 1024;
+       !ring && size >= FSEQ_RECORD_MIN_BUFFER_KB * 1024 && size >= channels;
+       size /= 2) {
+    ring = static_cast<uint8_t *>(p_malloc(size));
+    ringMask = size - 1;
+  }
+  if (!ring) {
+    DEBUG_PRINTLN(F("[FSEQ] Record buffer allocation failed"));
+    return false;
+  }
+
+  fileName = filepath;
+  file = SD_ADAPTER.open(FSEQUploadWriter::tempPath(filepath).c_str(),
+                         FILE_WRITE);
+  frames = 0;
+  if (!file || !writeHeader(0, FSEQ_RECORD_DEFAULT_STEP_MS)) {
+    DEBUG_PRINTF("[FSEQ] Record: cannot create %s\n", filepath);
+    if (file)
+      file.close();
+    file = File();
+    p_free(ring);
+    ring = nullptr;
+    return false;
+  }
+
+  writePos = 0;
+  readPos = 0;
+  dropped = 0;
+  failed = false;
+  saved = false;
+  lastUniverse = 0;
+  ddpSeenPush = false;
+  recording = true;
+
+  previousE131 = e131.getCallback();
+  e131.setCallback(onE131Packet);
+  previousDDP = ddp.getCallback();
+  ddp.setCallback(onDDPPacket);
+  DEBUG_PRINTF("[FSEQ] Recording %u channels to %s (%u KB buffer)\n",
+               channels, filepath, (ringMask + 1) / 1024);
+  return true;
+}
+
+bool FSEQRecorder::stop() {
+  if (!recording)
+    return false;
+  e131.setCallback(previousE131);
+  ddp.setCallback(previousDDP);
+  // a frame may be copied right now
+  xSemaphoreTake(captureLock, portMAX_DELAY);
+  recording = false;
+  xSemaphoreGive(captureLock);
+
+  // the web server does not wait for the card, the writer task drains the
+  // buffer and finishes the file
+  stopping = true;
+  xTaskNotifyGive(task);
+  return true;
+}
+
+// v2 header without variable headers, compression or sparse ranges
+bool FSEQRecorder::writeHeader(uint32_t frameCount, uint8_t stepMs) {
+  uint8_t header[HEADER_SIZE] = {};
+  memcpy(header, "PSEQ", 4);
+  header[4] = HEADER_SIZE; // channel data offset
+  header[6] = 0;           // minor version
+  header[7] = 2;           // major version
+  header[8] = HEADER_SIZE; // header length
+  for (uint8_t i = 0; i < 4; i++) {
+    header[10 + i] = channels >> (8 * i);
+    header[14 + i] = frameCount >> (8 * i);
+  }
+  header[18] = stepMs;
+  // 20-23: no compression, no blocks, no sparse ranges
+  uint64_t id = esp_timer_get_time();
+  memcpy(header + 24, &id, sizeof(id));
+  return file.seek(0) && file.write(header, HEADER_SIZE) == HEADER_SIZE;
+}
+
+// runs in the AsyncUDP task, after the core handler applied the packet
+void FSEQRecorder::onE131Packet(e131_packet_t *p, IPAddress clientIP,
+                                byte protocol) {
+  previousE131(p, clientIP, protocol);
+  if (completesFrame(p, protocol))
+    captureFrame();
+}
+
+void FSEQRecorder::onDDPPacket(e131_packet_t *p, IPAddress clientIP,
+                               byte protocol) {
+  previousDDP(p, clientIP, protocol);
+  if (completesFrame(p, protocol))
+    captureFrame();
+}
+
+bool FSEQRecorder::completesFrame(const e131_packet_t *p, byte protocol) {
+  if (protocol == P_DDP) {
+    // senders that never push show every packet, see handleDDPPacket()
+    bool push = p->flags & DDP_PUSH_FLAG;
+    ddpSeenPush |= push;
+    return push || !ddpSeenPush;
+  }
+
+  uint16_t universe;
+  if (protocol == P_ARTNET) {
+    if (p->art_opcode != ARTNET_OPCODE_OPDMX)
+      return false;
+    universe = p->art_universe;
+  } else {
+    if (p->options & 0x80)
+      return false; // preview data is not shown
+    universe = htons(p->universe);
+  }
+  if (universe < e131Universe ||
+      universe >= e131Universe + E131_MAX_UNIVERSE_COUNT)
+    return false;
+  // the highest universe of the input ends a frame, it is learned from the
+  // first one
+  if (universe > lastUniverse) {
+    lastUniverse = universe;
+    return false;
+  }
+  return universe == lastUniverse;
+}
+
+void FSEQRecorder::captureFrame() {
+  if (!recording || xSemaphoreTake(captureLock, 0) != pdTRUE)
+    return;
+  if (recording) {
+    uint32_t free = ringMask + 1 - (writePos - readPos);
+    if (free < channels) {
+      dropped++; // the card fell behind by more than the buffer
+    } else {
+      uint32_t pos = writePos;
+      uint32_t leds = min((uint32_t)strip.getLengthTotal(), channels / 3);
+      for (uint32_t i = 0; i < leds; i++) {
+        uint32_t c = strip.getPixelColorNoMap(i);
+        ring[pos++ & ringMask] = R(c);
+        ring[pos++ & ringMask] = G(c);
+        ring[pos++ & ringMask] = B(c);
+      }
+      for (uint32_t i = leds * 3; i < channels; i++)
+        ring[pos++ & ringMask] = 0; // LEDs removed while recording
+
+      int64_t nowUs = esp_timer_get_time();
+      if (frames == 0)
+        firstFrameUs = nowUs;
+      lastFrameUs = nowUs;
+      frames++;
+      writePos = pos; // the frame is complete before the writer sees it
+      if (pos - readPos >= FSEQ_RECORD_WRITE_SIZE)
+        xTaskNotifyGive(task);
+    }
+  }
+  xSemaphoreGive(captureLock);
+}
+
+// write buffered data in FSEQ_RECORD_WRITE_SIZE pieces, all of it if all
+void FSEQRecorder::drain(bool all) {
+  for (;;) {
+    uint32_t buffered = writePos - readPos;
+    if (buffered == 0 || (!all && buffered < FSEQ_RECORD_WRITE_SIZE))
+      return;
+    uint32_t offset = readPos & ringMask;
+    uint32_t length = min(buffered, min((uint32_t)FSEQ_RECORD_WRITE_SIZE,
+                                        ringMask + 1 - offset));
+    if (!failed) {
+      FSEQIOArbiter::acquireWrite();
+      uint32_t startUs = micros();
+      if (file.write(ring + offset, length) != length) {
+        DEBUG_PRINTLN(F("[FSEQ] Record: SD write failed"));
+        failed = true; // keep draining so the receivers are not blocked
+      }
+      FSEQIOArbiter::releaseWrite(length, micros() - startUs);
+    }
+    readPos += length;
+  }
+}
+
+// header, rename to the target and release the buffer
+void FSEQRecorder::finish() {
+  uint8_t stepMs = FSEQ_RECORD_DEFAULT_STEP_MS;
+  if (frames > 1)
+    stepMs = constrain((lastFrameUs - firstFrameUs + (frames - 1) * 500) /
+                           ((int64_t)(frames - 1) * 1000),
+                       (int64_t)1, (int64_t)255);
+  bool ok = !failed && frames > 0 && writeHeader(frames, stepMs);
+  file.close();
+  file = File();
+  ok = ok && FSEQUploadWriter::commit(fileName.c_str());
+  if (!ok)
+    SD_ADAPTER.remove(FSEQUploadWriter::tempPath(fileName.c_str()).c_str());
+  DEBUG_PRINTF("[FSEQ] Recorded %u frames at %u ms to %s: %s\n", frames,
+               stepMs, fileName.c_str(), ok ? "saved" : "failed");
+  p_free(ring);
+  ring = nullptr;
+  saved = ok;
+  stopping = false;
+}
+
+void FSEQRecorder::writerTask(void *) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+    // read once, the flag may be set while draining
+    bool last = stopping;
+    if (!recording && !last)
+      continue;
+    drain(last);
+    if (last)
+      finish();
+  }
+}
+
+void FSEQRecorder::toJSON(JsonObject obj) {
+  obj["recording"] = (bool)recording;
+  obj["finishing"] = (bool)stopping;
+  obj["file"] = fileName;
+  obj["channels"] = channels;
+  obj["frames"] = frames;
+  obj["dropped"] = dropped;
+  uint32_t seconds =
+      frames > 1 ? (uint32_t)((lastFrameUs - firstFrameUs) / 1000000) : 0;
+  obj["seconds"] = seconds;
+  obj["buffered_bytes"] = ring ? writePos - readPos : 0;
+  obj["buffer_kb"] = ring ? (ringMask + 1) / 1024 : 0;
+  obj["failed"] = (bool)failed;
+  obj["saved"] = saved;
+}
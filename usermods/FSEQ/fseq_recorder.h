@@ -0,0 +1,90 @@
+#ifndef FSEQ_RECORDER_H
+#define FSEQ_RECORDER_H
+
+#include "wled.h"
+#include <esp_timer.h>
+
+// write-behind buffer between the receivers and the SD card, a power of two;
+// halved until the allocation succeeds
+#ifndef FSEQ_RECORD_BUFFER_KB
+#define FSEQ_RECORD_BUFFER_KB 128
+#endif
+#ifndef FSEQ_RECORD_MIN_BUFFER_KB
+#define FSEQ_RECORD_MIN_BUFFER_KB 16
+#endif
+// size of one SD write, a multiple of the 512 byte sector size
+#ifndef FSEQ_RECORD_WRITE_SIZE
+#define FSEQ_RECORD_WRITE_SIZE 8192
+#endif
+// step time written when fewer than two frames were recorded
+#ifndef FSEQ_RECORD_DEFAULT_STEP_MS
+#define FSEQ_RECORD_DEFAULT_STEP_MS 25
+#endif
+
+// Records live E1.31, Art-Net and DDP input into an uncompressed v2 .fseq
+// file. The recorder sits in front of the core packet handlers of both
+// receivers: after a packet that completes a frame (DDP push flag, or the
+// highest universe of the frame) has been applied, the LED buffer is copied
+// as RGB channels into a ring buffer. A writer task drains the ring to the
+// temporary file in sector sized writes, so a slow card only fills the
+// buffer instead of holding up the UDP task. On stop the header gets the
+// frame count and the average frame interval as step time, and the file
+// replaces filepath; the writer task does that after stop() returned.
+class FSEQRecorder {
+public:
+  // false if a recording runs, remote mode is on or the file cannot be
+  // created
+  static bool start(const char *filepath);
+  // stop capturing and let the writer task finish the file, false if no
+  // recording runs; toJSON() reports finishing until it is done
+  static bool stop();
+
+  static bool isRecording() { return recording; }
+  // recording or still writing the file
+  static bool isBusy() { return recording || stopping; }
+  static void toJSON(JsonObject obj);
+
+private:
+  FSEQRecorder() {}
+
+  static const uint8_t HEADER_SIZE = 32;
+
+  static bool init();
+  static void writerTask(void *);
+  static void drain(bool all);
+  static void finish();
+  static bool writeHeader(uint32_t frameCount, uint8_t stepMs);
+  static void onE131Packet(e131_packet_t *p, IPAddress clientIP,
+                           byte protocol);
+  static void onDDPPacket(e131_packet_t *p, IPAddress clientIP,
+                          byte protocol);
+  static bool completesFrame(const e131_packet_t *p, byte protocol);
+  static void captureFrame();
+
+  static TaskHandle_t task;
+  static SemaphoreHandle_t captureLock; // held while a frame is copied
+  static e131_packet_callback_function previousE131;
+  static e131_packet_callback_function previousDDP;
+
+  static uint8_t *ring;
+  static uint32_t ringMask;         // ring size - 1
+  // total bytes put in / written out, the difference is buffered
+  static volatile uint32_t writePos; // UDP task
+  static volatile uint32_t readPos;  // writer task
+  static volatile bool recording;
+  static volatile bool stopping;
+  static volatile bool failed;
+  static bool saved;                // last recording was stored
+
+  static File file;
+  static String fileName;           // target, data goes to its temp file
+  static uint32_t channels;         // per frame
+  static uint32_t frames;
+  static uint32_t dropped;          // ring full
+  static int64_t firstFrameUs;
+  static int64_t lastFrameUs;
+  static uint16_t lastUniverse;     // highest universe seen, ends a frame
+  static bool ddpSeenPush;
+};
+
+#endif // FSEQ_RECORDER_H
@@ -0,0 +1,235 @@
+#include "fseq_remote.h"
+#include "fseq_recorder.h"
+
+bool FSEQRemoteBuffer::enabled = false;
+bool FSEQRemoteBuffer::active = false;
+uint16_t FSEQRemoteBuffer::delayMs = FSEQ_REMOTE_DEFAULT_DELAY_MS;
+SemaphoreHandle_t FSEQRemoteBuffer::mutex = nullptr;
+e131_packet_callback_function FSEQRemoteBuffer::previous = nullptr;
+FSEQRemoteBuffer::Frame FSEQRemoteBuffer::frames[FSEQ_REMOTE_FRAMES] = {};
+uint32_t FSEQRemoteBuffer::frameSize = 0;
+std::atomic<uint8_t> FSEQRemoteBuffer::head{0};
+std::atomic<uint8_t> FSEQRemoteBuffer::tail{0};
+int64_t FSEQRemoteBuffer::epochUs = 0;
+volatile uint32_t FSEQRemoteBuffer::stepUs = 0;
+volatile uint32_t FSEQRemoteBuffer::lastSyncMs = 0;
+uint32_t FSEQRemoteBuffer::received = 0;
+uint32_t FSEQRemoteBuffer::shown = 0;
+uint32_t FSEQRemoteBuffer::late = 0;
+uint32_t FSEQRemoteBuffer::dropped = 0;
+int32_t FSEQRemoteBuffer::offsetUs = 0;
+uint32_t FSEQRemoteBuffer::jitterUs = 0;
+
+bool FSEQRemoteBuffer::isSynced() {
+  return enabled && stepUs > 0 && lastSyncMs != 0 &&
+         millis() - lastSyncMs < FSEQ_REMOTE_SYNC_TIMEOUT_MS;
+}
+
+// called from loop() through FSEQSyncQueue
+void FSEQRemoteBuffer::sync(uint32_t frameNumber, float secondsElapsed,
+                            int64_t receivedUs) {
+  uint32_t step = stepUs;
+  // FPP step times are whole milliseconds, the first frames give a rounded
+  // seconds value that is too coarse to derive it from
+  if (frameNumber >= 10 && secondsElapsed > 0.0f)
+    step = (uint32_t)lroundf(secondsElapsed * 1000.0f / frameNumber) * 1000;
+  if (step == 0)
+    return;
+
+  int64_t masterEpochUs = receivedUs - (int64_t)frameNumber * step;
+  int64_t diff = masterEpochUs - epochUs;
+  if (step != stepUs || diff > 2 * (int64_t)step || diff < -2 * (int64_t)step)
+    epochUs = masterEpochUs; // first sync, new sequence or seek
+  else
+    epochUs += diff / 8; // single sync packets are delayed by Wi-Fi as well
+  stepUs = step;
+  lastSyncMs = millis() | 1; // 0 is "not synced"
+}
+
+// the buffered frames are dropped by handle(), it owns the read side
+void FSEQRemoteBuffer::stop() { lastSyncMs = 0; }
+
+bool FSEQRemoteBuffer::begin(uint32_t size) {
+  if (!mutex)
+    mutex = xSemaphoreCreateMutex();
+  for (Frame &frame : frames) {
+    frame = {};
+    frame.data = static_cast<uint8_t *>(p_malloc(size));
+    if (!frame.data) {
+      DEBUG_PRINTF("[FPP] Remote: failed to allocate %u bytes\n", size);
+      end();
+      return false;
+    }
+  }
+  frameSize = size;
+  head.store(0);
+  tail.store(0);
+  previous = ddp.getCallback();
+  ddp.setCallback(onPacket);
+  active = true;
+  DEBUG_PRINTF("[FPP] Remote: buffering %u DDP frames of %u channels\n",
+               FSEQ_REMOTE_FRAMES, size);
+  return true;
+}
+
+void FSEQRemoteBuffer::end() {
+  if (active) {
+    ddp.setCallback(previous);
+    active = false;
+  }
+  // a packet may still be copied into the buffers
+  if (mutex)
+    xSemaphoreTake(mutex, portMAX_DELAY);
+  for (Frame &frame : frames) {
+    if (frame.data)
+      p_free(frame.data);
+    frame = {};
+  }
+  frameSize = 0;
+  head.store(0);
+  tail.store(0);
+  if (mutex)
+    xSemaphoreGive(mutex);
+}
+
+// DDP port callback, runs in the AsyncUDP task
+void FSEQRemoteBuffer::onPacket(e131_packet_t *p, IPAddress clientIP,
+                                byte protocol) {
+  if (protocol != P_DDP || !isSynced() ||
+      xSemaphoreTake(mutex, 0) != pdTRUE) {
+    previous(p, clientIP, protocol); // shown on arrival as before
+    return;
+  }
+  if (!active) {
+    xSemaphoreGive(mutex);
+    previous(p, clientIP, protocol);
+    return;
+  }
+  // late packets of the previous frame are rejected like handleDDPPacket()
+  // does, they would overwrite the frame being received; both keep the
+  // last pushed sequence number in the same place
+  int lastPushSeq = e131LastSequenceNumber[0];
+  int sn = p->sequenceNum & 0xF;
+  if (e131SkipOutOfSequence && lastPushSeq && sn &&
+      (lastPushSeq > 5 ? sn > lastPushSeq - 5 && sn < lastPushSeq
+                       : sn > 10 + lastPushSeq || sn < lastPushSeq)) {
+    xSemaphoreGive(mutex);
+    return;
+  }
+  realtimeIP = clientIP;
+
+  uint8_t slot = head.load(std::memory_order_relaxed);
+  Frame &frame = frames[slot];
+  const uint8_t *data = p->data;
+  if (p->flags & DDP_TIMECODE_FLAG)
+    data += 4; // timecode is not used, data starts after it
+  uint32_t offset = htonl(p->channelOffset);
+  uint32_t length = min((uint32_t)htons(p->dataLen),
+                        (uint32_t)(p->raw + sizeof(p->raw) - data));
+  if (offset < frameSize) {
+    length = min(length, frameSize - offset);
+    memcpy(frame.data + offset, data, length);
+    frame.length = max(frame.length, offset + length);
+  }
+  // data type 0x1B (formerly 0x1A) is RGBW, see handleDDPPacket()
+  frame.channelsPerLed = ((p->dataType & 0b00111000) >> 3 == 0b011) ? 4 : 3;
+
+  if (p->flags & DDP_PUSH_FLAG) {
+    received++;
+    if (sn)
+      e131LastSequenceNumber[0] = sn;
+    frame.arrivalUs = esp_timer_get_time();
+    uint8_t next = (slot + 1) % FSEQ_REMOTE_FRAMES;
+    if (next == tail.load(std::memory_order_acquire)) {
+      dropped++; // loop() fell behind, receive the next frame into this slot
+      frame.length = 0;
+    } else {
+      frames[next].length = 0;
+      head.store(next, std::memory_order_release); // frame is complete
+    }
+  }
+  xSemaphoreGive(mutex);
+}
+
+void FSEQRemoteBuffer::flush() {
+  tail.store(head.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+// time of the master frame nearest to the arrival
+int64_t FSEQRemoteBuffer::frameTimeUs(int64_t arrivalUs) {
+  int64_t step = stepUs;
+  int64_t frame = (arrivalUs - epochUs + step / 2) / step;
+  return epochUs + frame * step;
+}
+
+void FSEQRemoteBuffer::present(const Frame &frame) {
+  realtimeLock(realtimeTimeoutMs, REALTIME_MODE_DDP);
+  if (!realtimeOverride && frame.channelsPerLed)
+    setRealtimePixels(DMXAddress / frame.channelsPerLed, frame.data,
+                      frame.length / frame.channelsPerLed,
+                      frame.channelsPerLed);
+  strip.show();
+  shown++;
+}
+
+void FSEQRemoteBuffer::handle() {
+  // buffers follow the LED count, RGBW is the widest DDP data type; the
+  // DDP port is left alone while a recording holds it
+  uint32_t size = enabled && !FSEQRecorder::isRecording()
+                      ? strip.getLengthTotal() * 4
+                      : 0;
+  if (size != frameSize) {
+    end();
+    if (size && !begin(size))
+      enabled = false;
+  }
+  if (!active)
+    return;
+  if (!isSynced()) {
+    flush();
+    return;
+  }
+
+  // show the newest frame that is due, older ones were overtaken
+  int64_t nowUs = esp_timer_get_time();
+  int64_t delayUs = (int64_t)delayMs * 1000;
+  int8_t due = -1;
+  int64_t dueFrameUs = 0;
+  uint8_t next = tail.load(std::memory_order_relaxed);
+  uint8_t last = head.load(std::memory_order_acquire);
+  while (next != last) {
+    int64_t frameUs = frameTimeUs(frames[next].arrivalUs);
+    if (frameUs + delayUs > nowUs)
+      break;
+    if (due >= 0)
+      late++;
+    due = next;
+    dueFrameUs = frameUs;
+    next = (next + 1) % FSEQ_REMOTE_FRAMES;
+  }
+  if (due < 0)
+    return;
+
+  const Frame &frame = frames[due];
+  int32_t offset = (int32_t)(frame.arrivalUs - dueFrameUs);
+  offsetUs += (offset - offsetUs) / 8;
+  jitterUs = (jitterUs * 7 + (uint32_t)abs(offset - offsetUs)) / 8;
+  present(frame);
+  // the UDP task may reuse the slots now
+  tail.store(next, std::memory_order_release);
+}
+
+void FSEQRemoteBuffer::toJSON(JsonObject obj) {
+  obj["enabled"] = enabled;
+  obj["synced"] = isSynced();
+  obj["delay_ms"] = delayMs;
+  obj["step_ms"] = stepUs / 1000;
+  obj["buffered"] = (head.load() + FSEQ_REMOTE_FRAMES - tail.load()) %
+                    FSEQ_REMOTE_FRAMES;
+  obj["frames_received"] = received;
+  obj["frames_shown"] = shown;
+  obj["frames_late"] = late;
+  obj["frames_dropped"] = dropped;
+  obj["arrival_offset_us"] = offsetUs;
+  obj["jitter_us"] = jitterUs;
+}
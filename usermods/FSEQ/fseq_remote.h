@@ -0,0 +1,97 @@
+#ifndef FSEQ_REMOTE_H
+#define FSEQ_REMOTE_H
+
+#include "wled.h"
+#include <atomic>
+#include <esp_timer.h>
+
+// frames the jitter buffer holds, must cover the delay at the sequence rate
+#ifndef FSEQ_REMOTE_FRAMES
+#define FSEQ_REMOTE_FRAMES 6
+#endif
+// time between the master sending a frame and this node showing it
+#ifndef FSEQ_REMOTE_DEFAULT_DELAY_MS
+#define FSEQ_REMOTE_DEFAULT_DELAY_MS 50
+#endif
+#ifndef FSEQ_REMOTE_MAX_DELAY_MS
+#define FSEQ_REMOTE_MAX_DELAY_MS 500
+#endif
+// without sync packets for this long DDP frames are shown on arrival again
+#ifndef FSEQ_REMOTE_SYNC_TIMEOUT_MS
+#define FSEQ_REMOTE_SYNC_TIMEOUT_MS 3000
+#endif
+
+// FPP remote mode for channel data pushed over DDP. While the FPP master
+// sends sync packets, DDP frames are not shown on arrival but collected in a
+// small jitter buffer. Each frame is assigned to the master frame slot it
+// arrived in (from the frame number and step time in the sync stream) and
+// shown a fixed delay after that slot starts. Every remote with the same
+// delay then shows a frame at the same time, however late Wi-Fi delivered it
+// within the delay. Without sync packets the DDP port behaves as usual.
+class FSEQRemoteBuffer {
+public:
+  static void setEnabled(bool enable) { enabled = enable; }
+  static bool isEnabled() { return enabled; }
+  static void setDelay(uint16_t ms) {
+    delayMs = min(ms, (uint16_t)FSEQ_REMOTE_MAX_DELAY_MS);
+  }
+  static uint16_t getDelay() { return delayMs; }
+  // sync stream is recent and its frame rate known
+  static bool isSynced();
+
+  // FPP sync packet received at receivedUs: the master was at frameNumber,
+  // secondsElapsed into the sequence
+  static void sync(uint32_t frameNumber, float secondsElapsed,
+                   int64_t receivedUs);
+  // sequence stopped or blanked, buffered frames are dropped
+  static void stop();
+
+  // called from loop(): takes over the DDP port when enabled and shows the
+  // frames that are due
+  static void handle();
+  static void toJSON(JsonObject obj);
+
+private:
+  FSEQRemoteBuffer() {}
+
+  struct Frame {
+    uint8_t *data;
+    uint32_t length;        // channels received
+    uint8_t channelsPerLed;
+    int64_t arrivalUs;      // when the push packet came in
+  };
+
+  static bool begin(uint32_t size);
+  static void end();
+  static void onPacket(e131_packet_t *p, IPAddress clientIP, byte protocol);
+  static void flush();
+  static void present(const Frame &frame);
+  static int64_t frameTimeUs(int64_t arrivalUs);
+
+  static bool enabled;
+  static bool active;                 // DDP callback installed
+  static uint16_t delayMs;
+  static SemaphoreHandle_t mutex;     // held by onPacket() while it fills
+  static e131_packet_callback_function previous;
+  static Frame frames[FSEQ_REMOTE_FRAMES];
+  static uint32_t frameSize;
+  // frames tail .. head are complete, frames[head] is being received;
+  // loop() reads them without the mutex, so head is published with release
+  // and tail handed back with release, each loaded with acquire
+  static std::atomic<uint8_t> head;   // written by the UDP task
+  static std::atomic<uint8_t> tail;   // written by loop()
+
+  // master clock, set from the sync packets
+  static int64_t epochUs;             // local time of master frame 0
+  static volatile uint32_t stepUs;
+  static volatile uint32_t lastSyncMs;
+
+  static uint32_t received;
+  static uint32_t shown;
+  static uint32_t late;               // replaced by a newer frame before shown
+  static uint32_t dropped;            // buffer full
+  static int32_t offsetUs;            // average arrival after the frame time
+  static uint32_t jitterUs;           // average deviation from offsetUs
+};
+
+#endif // FSEQ_REMOTE_H
@@ -0,0 +1,203 @@
+#include "fseq_sync.h"
+#include "fseq_manager.h"
+#include "fseq_player.h"
+#include "fseq_remote.h"
+
+FSEQSyncCommand FSEQSyncQueue::commands[FSEQ_SYNC_QUEUE_SIZE] = {};
+std::atomic<uint8_t> FSEQSyncQueue::head{0};
+std::atomic<uint8_t> FSEQSyncQueue::tail{0};
+uint32_t FSEQSyncQueue::dropped = 0;
+
+// slot the producer may fill, nullptr if loop() has not caught up
+FSEQSyncCommand *FSEQSyncQueue::reserve() {
+  uint8_t slot = head.load(std::memory_order_relaxed);
+  // acquire: loop() is done with the slot before it is filled again
+  if ((uint8_t)((slot + 1) % FSEQ_SYNC_QUEUE_SIZE) ==
+      tail.load(std::memory_order_acquire)) {
+    dropped++;
+    return nullptr;
+  }
+  return &commands[slot];
+}
+
+// the release store makes the filled slot visible to loop() before the new
+// head, so it never sees a half written command
+void FSEQSyncQueue::publish() {
+  uint8_t next = (head.load(std::memory_order_relaxed) + 1) %
+                 FSEQ_SYNC_QUEUE_SIZE;
+  head.store(next, std::memory_order_release);
+}
+
+bool FSEQSyncQueue::pushSync(const uint8_t *data, size_t length) {
+  // header, action, file type, frame number, seconds elapsed, file name
+  const size_t fileNameOffset = 17;
+  if (length <= fileNameOffset || data[8] != SYNC_FILE_SEQ)
+    return false;
+  FSEQSyncCommand *command = reserve();
+  if (!command)
+    return false;
+
+  command->type = FSEQSyncCommand::SYNC;
+  command->action = data[7];
+  memcpy(&command->frameNumber, data + 9, sizeof(command->frameNumber));
+  memcpy(&command->secondsElapsed, data + 13,
+         sizeof(command->secondsElapsed));
+  command->receivedUs = esp_timer_get_time();
+
+  // names are relative to the SD root
+  const char *name = reinterpret_cast<const char *>(data + fileNameOffset);
+  size_t nameLength = min(length - fileNameOffset, (size_t)64);
+  nameLength = strnlen(name, nameLength);
+  size_t pos = 0;
+  if (nameLength == 0 || name[0] != '/')
+    command->fileName[pos++] = '/';
+  memcpy(command->fileName + pos, name, nameLength);
+  command->fileName[pos + nameLength] = '\0';
+
+  publish();
+  return true;
+}
+
+bool FSEQSyncQueue::pushBlank() {
+  FSEQSyncCommand *command = reserve();
+  if (!command)
+    return false;
+  command->type = FSEQSyncCommand::BLANK;
+  command->receivedUs = esp_timer_get_time();
+  publish();
+  return true;
+}
+
+void FSEQSyncQueue::handle() {
+  uint8_t slot = tail.load(std::memory_order_relaxed);
+  while (slot != head.load(std::memory_order_acquire)) {
+    apply(commands[slot]);
+    slot = (slot + 1) % FSEQ_SYNC_QUEUE_SIZE;
+    tail.store(slot, std::memory_order_release);
+  }
+}
+
+// The master's frame number is used for positioning, seconds_elapsed is
+// only informational (it is a rounded float).
+void FSEQSyncQueue::apply(const FSEQSyncCommand &command) {
+  if (command.type == FSEQSyncCommand::BLANK) {
+    DEBUG_PRINTLN(F("[FPP] Blank"));
+    FSEQRemoteBuffer::stop();
+    FSEQPlayerManager::stopAll();
+    realtimeLock(10, REALTIME_MODE_INACTIVE);
+    return;
+  }
+
+  DEBUG_PRINTF("[FPP] Sync action %u: %s frame %lu (%.2fs)\n", command.action,
+               command.fileName, (unsigned long)command.frameNumber,
+               command.secondsElapsed);
+
+  // remote mode: the channel data comes over DDP, the sync stream only
+  // provides the master's frame clock
+  if (FSEQRemoteBuffer::isEnabled()) {
+    if (command.action == SYNC_PKT_START || command.action == SYNC_PKT_SYNC)
+      FSEQRemoteBuffer::sync(command.frameNumber, command.secondsElapsed,
+                             command.receivedUs);
+    else if (command.action == SYNC_PKT_STOP)
+      FSEQRemoteBuffer::stop();
+    return;
+  }
+
+  FSEQPlayer &player = FSEQPlayerManager::primary();
+  switch (command.action) {
+  case SYNC_PKT_START:
+    player.loadRecordingAtFrame(command.fileName, 0, strip.getLength(),
+                                command.frameNumber);
+    break;
+  case SYNC_PKT_STOP:
+    FSEQPlayerManager::stop(player);
+    break;
+  case SYNC_PKT_SYNC:
+    if (!player.isPlaying()) {
+      DEBUG_PRINTLN(F("[FPP] Sync: Playback not active, starting playback."));
+      player.loadRecordingAtFrame(command.fileName, 0, strip.getLength(),
+                                  command.frameNumber);
+    } else {
+      player.syncPlaybackFrame(command.frameNumber, command.receivedUs);
+    }
+    break;
+  case SYNC_PKT_OPEN:
+    // open the file and buffer the first frames now, START then begins
+    // playback without waiting for the SD card
+    if (!player.prepareRecording(command.fileName, 0, strip.getLength()))
+      DEBUG_PRINTLN(F("[FPP] Open: could not prepare sequence"));
+    break;
+  default:
+    DEBUG_PRINTLN(F("[FPP] Unknown sync action"));
+    break;
+  }
+}
+
+QueueHandle_t FSEQControlQueue::queue = nullptr;
+
+void FSEQControlQueue::begin() {
+  if (!queue)
+    queue = xQueueCreate(FSEQ_CONTROL_QUEUE_SIZE, sizeof(FSEQControlCommand));
+}
+
+bool FSEQControlQueue::push(const FSEQControlCommand &command) {
+  return queue && xQueueSend(queue, &command, 0) == pdTRUE;
+}
+
+bool FSEQControlQueue::pushStart(uint8_t player, const char *filepath,
+                                 uint16_t startLed, uint16_t stopLed,
+                                 bool loop) {
+  FSEQControlCommand command = {};
+  if (strlen(filepath) >= sizeof(command.fileName))
+    return false;
+  command.type = FSEQControlCommand::START;
+  command.player = player;
+  command.loop = loop;
+  command.startLed = startLed;
+  command.stopLed = stopLed;
+  strcpy(command.fileName, filepath);
+  return push(command);
+}
+
+bool FSEQControlQueue::pushStop(uint8_t player) {
+  FSEQControlCommand command = {};
+  command.type = FSEQControlCommand::STOP;
+  command.player = player;
+  return push(command);
+}
+
+bool FSEQControlQueue::pushStopAll() {
+  FSEQControlCommand command = {};
+  command.type = FSEQControlCommand::STOP_ALL;
+  return push(command);
+}
+
+void FSEQControlQueue::handle() {
+  FSEQControlCommand command;
+  while (queue && xQueueReceive(queue, &command, 0) == pdTRUE)
+    apply(command);
+}
+
+void FSEQControlQueue::apply(const FSEQControlCommand &command) {
+  if (command.type == FSEQControlCommand::STOP_ALL) {
+    FSEQPlayerManager::stopAll();
+    if (realtimeOverride == REALTIME_OVERRIDE_ONCE)
+      realtimeOverride = REALTIME_OVERRIDE_NONE;
+    if (realtimeMode)
+      exitRealtime();
+    else {
+      realtimeMode = REALTIME_MODE_INACTIVE;
+      strip.trigger();
+    }
+    return;
+  }
+
+  FSEQPlayer *player = FSEQPlayerManager::get(command.player);
+  if (!player)
+    return;
+  if (command.type == FSEQControlCommand::STOP)
+    FSEQPlayerManager::stop(*player);
+  else
+    player->loadRecording(command.fileName, command.startLed,
+                          command.stopLed, 0.0f, command.loop);
+}
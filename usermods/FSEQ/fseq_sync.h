@@ -0,0 +1,114 @@
+#ifndef FSEQ_SYNC_H
+#define FSEQ_SYNC_H
+
+#include "wled.h"
+#include <atomic>
+#include <esp_timer.h>
+
+// Sync actions and file types of an FPP CTRL_PKT_SYNC packet
+#define SYNC_PKT_START 0
+#define SYNC_PKT_STOP 1
+#define SYNC_PKT_SYNC 2
+#define SYNC_PKT_OPEN 3
+#define SYNC_FILE_SEQ 0
+#define SYNC_FILE_MEDIA 1
+
+// commands waiting for loop(), packets beyond are dropped
+#ifndef FSEQ_SYNC_QUEUE_SIZE
+#define FSEQ_SYNC_QUEUE_SIZE 16
+#endif
+
+// FPP sync or blank packet, parsed in the UDP task
+struct FSEQSyncCommand {
+  enum Type : uint8_t { SYNC, BLANK };
+  Type type;
+  uint8_t action;        // SYNC_PKT_*
+  uint32_t frameNumber;
+  float secondsElapsed;
+  int64_t receivedUs;    // esp_timer time the packet came in
+  char fileName[66];     // absolute path
+};
+
+// Hands FPP sync packets from the AsyncUDP task to loop(). The UDP task
+// only parses a packet into a fixed slot of a single producer / single
+// consumer ring, without allocating; opening sequences, reading the SD
+// card and showing frames happen when loop() applies the commands, so
+// they cannot race playback. The receive time travels with the command,
+// so syncing is not skewed by the time it waited in the queue.
+class FSEQSyncQueue {
+public:
+  // UDP task: parse a whole FPP sync packet, false if it is malformed, for
+  // media or the queue is full
+  static bool pushSync(const uint8_t *data, size_t length);
+  static bool pushBlank();
+
+  // loop(): apply the queued commands to playback
+  static void handle();
+
+  static uint32_t getDropped() { return dropped; }
+
+private:
+  FSEQSyncQueue() {}
+
+  static FSEQSyncCommand *reserve();
+  static void publish();
+  static void apply(const FSEQSyncCommand &command);
+
+  static FSEQSyncCommand commands[FSEQ_SYNC_QUEUE_SIZE];
+  // release stores and acquire loads order the slot contents between the
+  // two cores, volatile alone would not
+  static std::atomic<uint8_t> head; // next slot written by the UDP task
+  static std::atomic<uint8_t> tail; // next slot read by loop()
+  static uint32_t dropped;      // queue full
+};
+
+// start/stop commands of the web endpoints waiting for loop()
+#ifndef FSEQ_CONTROL_QUEUE_SIZE
+#define FSEQ_CONTROL_QUEUE_SIZE 8
+#endif
+// longest sequence path a web start command carries
+#ifndef FSEQ_CONTROL_PATH_LEN
+#define FSEQ_CONTROL_PATH_LEN 128
+#endif
+
+// start or stop request of a web endpoint
+struct FSEQControlCommand {
+  enum Type : uint8_t { START, STOP, STOP_ALL };
+  Type type;
+  uint8_t player;
+  bool loop;
+  uint16_t startLed; // uint16_t(-1): whole strip
+  uint16_t stopLed;
+  char fileName[FSEQ_CONTROL_PATH_LEN]; // absolute path
+};
+
+// Hands playback start and stop from the AsyncTCP task to loop(). Opening
+// or closing a sequence frees the read-ahead ring, block table and decoder
+// that loop() may be using right then, so the web handlers only post a
+// command. A FreeRTOS queue, as the web server and the FPP endpoints may
+// post from different tasks.
+class FSEQControlQueue {
+public:
+  // setup(): create the queue
+  static void begin();
+
+  // web task: false if the queue is full or missing or the path too long
+  static bool pushStart(uint8_t player, const char *filepath,
+                        uint16_t startLed, uint16_t stopLed, bool loop);
+  static bool pushStop(uint8_t player);
+  // stop every player and leave realtime mode
+  static bool pushStopAll();
+
+  // loop(): apply the queued commands
+  static void handle();
+
+private:
+  FSEQControlQueue() {}
+
+  static bool push(const FSEQControlCommand &command);
+  static void apply(const FSEQControlCommand &command);
+
+  static QueueHandle_t queue;
+};
+
+#endif // FSEQ_SYNC_H
@@ -0,0 +1,476 @@
+#include "fseq_upload.h"
+#include "fseq_cache.h"
+#include "fseq_index.h"
+#include "fseq_io.h"
+#include "usermod_fseq.h"
+
+#if __has_include(<rom/crc.h>)
+#include <rom/crc.h>
+#else
+#include <esp32/rom/crc.h>
+#endif
+
+TaskHandle_t FSEQUploadWriter::task = nullptr;
+QueueHandle_t FSEQUploadWriter::writeQueue = nullptr;
+QueueHandle_t FSEQUploadWriter::freeQueue = nullptr;
+SemaphoreHandle_t FSEQUploadWriter::clientLock = nullptr;
+
+uint8_t *FSEQUploadWriter::pool = nullptr;
+File FSEQUploadWriter::file;
+String FSEQUploadWriter::fileName = "";
+String FSEQUploadWriter::targetName = "";
+bool FSEQUploadWriter::keepOnFailure = false;
+bool FSEQUploadWriter::commitOnClose = false;
+FSEQUploadWriter::CloseHandler FSEQUploadWriter::closeHandler = nullptr;
+uint8_t *FSEQUploadWriter::fill = nullptr;
+uint16_t FSEQUploadWriter::fillLength = 0;
+AsyncClient *FSEQUploadWriter::client = nullptr;
+uint32_t FSEQUploadWriter::generation = 0;
+volatile bool FSEQUploadWriter::active = false;
+volatile bool FSEQUploadWriter::failed = false;
+volatile bool FSEQUploadWriter::throttled = false;
+volatile bool FSEQUploadWriter::closing = false;
+volatile FSEQUploadWriter::Result FSEQUploadWriter::result =
+    FSEQUploadWriter::NONE;
+uint32_t FSEQUploadWriter::written = 0;
+uint32_t FSEQUploadWriter::startMs = 0;
+uint32_t FSEQUploadWriter::lastRate = 0;
+
+// queues and the writer task are created with the first upload
+bool FSEQUploadWriter::init() {
+  if (task)
+    return true;
+  writeQueue = xQueueCreate(FSEQ_UPLOAD_CHUNKS + 1, sizeof(Message));
+  freeQueue = xQueueCreate(FSEQ_UPLOAD_CHUNKS, sizeof(uint8_t *));
+  clientLock = xSemaphoreCreateMutex();
+  if (!writeQueue || !freeQueue || !clientLock)
+    return false;
+  return xTaskCreatePinnedToCore(writerTask, "fseqUpload", 4096, nullptr, 1,
+                                 &task, tskNO_AFFINITY) == pdPASS;
+}
+
+static bool endsWith(const char *name, const char *suffix) {
+  size_t len = strlen(name);
+  size_t suffixLen = strlen(suffix);
+  return len > suffixLen && strcmp(name + len - suffixLen, suffix) == 0;
+}
+
+bool FSEQUploadWriter::isTempFile(const char *name) {
+  return endsWith(name, FSEQ_UPLOAD_TEMP_SUFFIX) ||
+         endsWith(name, FSEQ_UPLOAD_PROGRESS_SUFFIX);
+}
+
+bool FSEQUploadWriter::begin(const char *filepath,
+                             AsyncWebServerRequest *request,
+                             uint32_t offset) {
+  if (active || SDManager::isSuspended() || !init())
+    return false;
+  pool = static_cast<uint8_t *>(
+      d_malloc(FSEQ_UPLOAD_CHUNK_SIZE * FSEQ_UPLOAD_CHUNKS));
+  if (!pool) {
+    DEBUG_PRINTLN(F("[FSEQ] Upload buffer allocation failed"));
+    return false;
+  }
+  targetName = filepath;
+  fileName = tempPath(filepath);
+  if (offset == 0) {
+    file = SD_ADAPTER.open(fileName.c_str(), FILE_WRITE);
+  } else {
+    // continue a partial upload, data after offset is overwritten
+    file = SD_ADAPTER.open(fileName.c_str(), "r+");
+    if (file && (file.size() < offset || !file.seek(offset)))
+      file.close();
+  }
+  if (!file) {
+    d_free(pool);
+    pool = nullptr;
+    return false;
+  }
+  keepOnFailure = offset > 0;
+  for (uint8_t i = 0; i < FSEQ_UPLOAD_CHUNKS; i++) {
+    uint8_t *chunk = pool + i * FSEQ_UPLOAD_CHUNK_SIZE;
+    xQueueSend(freeQueue, &chunk, 0);
+  }
+
+  fill = nullptr;
+  fillLength = 0;
+  written = 0;
+  startMs = millis();
+  failed = false;
+  throttled = false;
+  closing = false;
+  commitOnClose = false;
+  closeHandler = nullptr;
+  result = WRITING;
+  client = request->client();
+  uint32_t upload = ++generation;
+  request->onDisconnect([upload]() {
+    if (upload != generation)
+      return;
+    xSemaphoreTake(clientLock, portMAX_DELAY);
+    client = nullptr;
+    xSemaphoreGive(clientLock);
+    if (active)
+      abort(); // connection lost before the upload was complete
+  });
+  active = true;
+  return true;
+}
+
+// hand the filled chunk to the writer task
+bool FSEQUploadWriter::flushChunk() {
+  if (!fill)
+    return true;
+  Message msg = {fill, fillLength};
+  fill = nullptr;
+  fillLength = 0;
+  // writeQueue holds every chunk plus the close message, this cannot block
+  return xQueueSend(writeQueue, &msg, 0) == pdTRUE;
+}
+
+bool FSEQUploadWriter::write(const uint8_t *data, size_t len) {
+  if (!active || failed)
+    return false;
+  while (len > 0) {
+    if (!fill) {
+      // only waits if the client ignored the closed window
+      if (xQueueReceive(freeQueue, &fill, pdMS_TO_TICKS(1000)) != pdTRUE) {
+        DEBUG_PRINTLN(F("[FSEQ] Upload writer stalled"));
+        failed = true;
+        return false;
+      }
+    }
+    size_t n = min(len, (size_t)(FSEQ_UPLOAD_CHUNK_SIZE - fillLength));
+    memcpy(fill + fillLength, data, n);
+    fillLength += n;
+    data += n;
+    len -= n;
+    if (fillLength == FSEQ_UPLOAD_CHUNK_SIZE && !flushChunk()) {
+      failed = true;
+      return false;
+    }
+  }
+
+  // out of chunks: keep the receive window closed until the writer frees
+  // one. AsyncTCP acknowledges every received segment unless ackLater() is
+  // called for it, so this is repeated for each one while throttled.
+  xSemaphoreTake(clientLock, portMAX_DELAY);
+  if (client && (throttled || uxQueueMessagesWaiting(freeQueue) == 0)) {
+    throttled = true;
+    client->ackLater();
+  }
+  xSemaphoreGive(clientLock);
+  return true;
+}
+
+bool FSEQUploadWriter::end(bool commit, CloseHandler onClose) {
+  if (!active)
+    return false;
+  // read by the writer task after the close message
+  commitOnClose = commit;
+  closeHandler = onClose;
+  Message close = {nullptr, 0};
+  if (!flushChunk() || xQueueSend(writeQueue, &close, 0) != pdTRUE) {
+    abort();
+    return false;
+  }
+  closing = true;
+  return !failed;
+}
+
+// FAT cannot rename onto an existing file, the old one is removed first
+bool FSEQUploadWriter::commit(const char *filepath) {
+  if (SD_ADAPTER.exists(filepath) && !SD_ADAPTER.remove(filepath))
+    return false;
+  if (!SD_ADAPTER.rename(tempPath(filepath).c_str(), filepath)) {
+    DEBUG_PRINTF("[FSEQ] Upload: cannot rename to %s\n", filepath);
+    return false;
+  }
+  FSEQSequenceCache::invalidate(filepath);
+  FSEQFileIndex::update(filepath);
+  return true;
+}
+
+void FSEQUploadWriter::abort() {
+  if (!active || closing)
+    return; // a closing upload has all of its data
+  failed = true;
+  Message close = {nullptr, 0};
+  if (fill) {
+    xQueueSend(freeQueue, &fill, 0);
+    fill = nullptr;
+    fillLength = 0;
+  }
+  xQueueSend(writeQueue, &close, 0);
+}
+
+// reopen the receive window once half of the chunks are free again
+void FSEQUploadWriter::resumeClient() {
+  if (!throttled || uxQueueMessagesWaiting(freeQueue) < FSEQ_UPLOAD_CHUNKS / 2)
+    return;
+  xSemaphoreTake(clientLock, portMAX_DELAY);
+  if (client)
+    client->ack(UINT32_MAX); // everything held back by ackLater()
+  throttled = false;
+  xSemaphoreGive(clientLock);
+}
+
+void FSEQUploadWriter::writerTask(void *) {
+  for (;;) {
+    Message msg;
+    if (xQueueReceive(writeQueue, &msg, pdMS_TO_TICKS(50)) != pdTRUE) {
+      resumeClient();
+      continue;
+    }
+
+    if (msg.chunk) {
+      if (!failed) {
+        // wait for a gap between playback frame reads
+        FSEQIOArbiter::acquireWrite();
+        uint32_t writeStartUs = micros();
+        size_t wrote = file.write(msg.chunk, msg.length);
+        FSEQIOArbiter::releaseWrite(msg.length, micros() - writeStartUs);
+        if (wrote != msg.length) {
+          DEBUG_PRINTF("[FSEQ] Upload write failed at %u\n", written);
+          failed = true;
+        }
+      }
+      written += msg.length;
+      xQueueSend(freeQueue, &msg.chunk, 0);
+      resumeClient();
+      continue;
+    }
+
+    // close message: everything queued before it is written
+    if (!pool)
+      continue; // upload already closed (abort after end)
+    file.close();
+    file = File();
+    if (failed && !keepOnFailure)
+      SD_ADAPTER.remove(fileName.c_str());
+    bool ok = !failed && (!closeHandler || closeHandler()) &&
+              (!commitOnClose || commit(targetName.c_str()));
+    uint32_t elapsed = millis() - startMs;
+    lastRate = elapsed ? (uint64_t)written * 1000 / elapsed : 0;
+    DEBUG_PRINTF("[FSEQ] Upload %s: %u bytes, %u bytes/s\n",
+                 ok ? "done" : "failed", written, lastRate);
+    xSemaphoreTake(clientLock, portMAX_DELAY);
+    client = nullptr;
+    throttled = false;
+    xSemaphoreGive(clientLock);
+    xQueueReset(freeQueue);
+    d_free(pool);
+    pool = nullptr;
+    result = ok ? DONE : FAILED;
+    active = false;
+  }
+}
+
+String FSEQUploadSession::closingPath = "";
+FSEQUploadSession::Progress FSEQUploadSession::closingProgress = {0, 0, 0, 0};
+bool FSEQUploadSession::closingDiscard = false;
+
+bool FSEQUploadSession::readProgress(const String &filepath,
+                                     Progress &progress) {
+  File file = SD_ADAPTER.open(progressPath(filepath).c_str(), "r");
+  if (!file)
+    return false;
+  bool ok = file.read((uint8_t *)&progress, sizeof(progress)) ==
+                sizeof(progress) &&
+            progress.magic == PROGRESS_MAGIC &&
+            progress.committed <= progress.total;
+  file.close();
+  return ok;
+}
+
+bool FSEQUploadSession::writeProgress(const String &filepath,
+                                      const Progress &progress) {
+  File file = SD_ADAPTER.open(progressPath(filepath).c_str(), FILE_WRITE);
+  if (!file)
+    return false;
+  bool ok = file.write((const uint8_t *)&progress, sizeof(progress)) ==
+            sizeof(progress);
+  file.close();
+  return ok;
+}
+
+void FSEQUploadSession::handleChunk(AsyncWebServerRequest *request,
+                                    const String &filepath, uint8_t *data,
+                                    size_t len, size_t index, size_t total) {
+  Chunk *chunk = static_cast<Chunk *>(request->_tempObject);
+  if (index == 0) {
+    // plain C memory, the web server free()s it with the request
+    chunk = static_cast<Chunk *>(calloc(1, sizeof(Chunk)));
+    request->_tempObject = chunk;
+    if (!chunk)
+      return;
+    chunk->offset = request->arg("offset").toInt();
+    chunk->length = total;
+    uint32_t fileSize = request->arg("total").toInt();
+    if (!request->hasArg("crc32") || fileSize == 0) {
+      chunk->status = 400;
+      return;
+    }
+    chunk->expectedCrc = strtoul(request->arg("crc32").c_str(), nullptr, 16);
+
+    if (chunk->offset == 0) {
+      chunk->progress = {PROGRESS_MAGIC, fileSize, 0, 0};
+    } else if (!readProgress(filepath, chunk->progress) ||
+               chunk->progress.total != fileSize) {
+      // no upload of this file to continue, it has to start over
+      chunk->progress = {PROGRESS_MAGIC, fileSize, 0, 0};
+      chunk->status = 409;
+      return;
+    }
+    if (chunk->offset != chunk->progress.committed ||
+        chunk->offset + total > fileSize) {
+      chunk->status = 409; // the response tells the offset to continue at
+      return;
+    }
+    if (FSEQUploadWriter::isBusy()) {
+      chunk->status = 503;
+      return;
+    }
+    if ((chunk->offset == 0 && !writeProgress(filepath, chunk->progress)) ||
+        !FSEQUploadWriter::begin(filepath.c_str(), request, chunk->offset)) {
+      chunk->status = 500;
+      return;
+    }
+    chunk->fileCrc = chunk->progress.crc;
+    chunk->writing = true;
+  }
+  if (!chunk || !chunk->writing)
+    return;
+
+  chunk->crc = crc32_le(chunk->crc, data, len);
+  chunk->fileCrc = crc32_le(chunk->fileCrc, data, len);
+  if (!FSEQUploadWriter::write(data, len))
+    chunk->status = 500;
+  if (index + len == total || chunk->status) {
+    chunk->writing = false;
+    finishChunk(request, filepath, *chunk);
+  }
+}
+
+// a chunk is only counted once its CRC matches, the data of a rejected one
+// is overwritten when it is sent again
+void FSEQUploadSession::finishChunk(AsyncWebServerRequest *request,
+                                    const String &filepath, Chunk &chunk) {
+  if (chunk.status || chunk.crc != chunk.expectedCrc) {
+    if (!chunk.status) {
+      DEBUG_PRINTF("[FSEQ] Upload chunk at %u: CRC mismatch\n", chunk.offset);
+      chunk.status = 422;
+    } else {
+      chunk.status = 500;
+    }
+    FSEQUploadWriter::end(false);
+    return;
+  }
+  Progress progress = chunk.progress;
+  progress.committed += chunk.length;
+  progress.crc = chunk.fileCrc;
+
+  // last chunk: check the whole file if the client sent its CRC
+  bool discard =
+      progress.committed >= progress.total &&
+      request->hasArg("file_crc32") &&
+      strtoul(request->arg("file_crc32").c_str(), nullptr, 16) != progress.crc;
+
+  // the progress file and the rename wait for the data in the writer task
+  closingPath = filepath;
+  closingProgress = progress;
+  closingDiscard = discard;
+  if (!FSEQUploadWriter::end(false, closeChunk)) {
+    chunk.status = 500;
+    return;
+  }
+  if (discard) {
+    DEBUG_PRINTF("[FSEQ] Upload of %s: file CRC mismatch\n",
+                 filepath.c_str());
+    chunk.progress = {PROGRESS_MAGIC, progress.total, 0, 0};
+    chunk.status = 422;
+    return;
+  }
+  chunk.progress = progress;
+  chunk.closing = true;
+}
+
+// runs in the writer task once the chunk is written
+bool FSEQUploadSession::closeChunk() {
+  const char *filepath = closingPath.c_str();
+  if (closingDiscard) {
+    SD_ADAPTER.remove(FSEQUploadWriter::tempPath(filepath).c_str());
+    SD_ADAPTER.remove(progressPath(closingPath).c_str());
+    return false;
+  }
+  if (closingProgress.committed < closingProgress.total)
+    return writeProgress(closingPath, closingProgress);
+  if (!FSEQUploadWriter::commit(filepath))
+    return false;
+  SD_ADAPTER.remove(progressPath(closingPath).c_str());
+  return true;
+}
+
+void FSEQUploadSession::sendProgress(AsyncWebServerRequest *request, int code,
+                                     const String &filepath,
+                                     const Progress &progress) {
+  StaticJsonDocument<256> doc;
+  char crc[9];
+  snprintf(crc, sizeof(crc), "%08x", progress.crc);
+  doc["file"] = filepath;
+  doc["offset"] = progress.committed;
+  doc["total"] = progress.total;
+  doc["crc32"] = crc;
+  // writing: the writer still finishes an upload of this file
+  FSEQUploadWriter::Result result =
+      FSEQUploadWriter::getResult(filepath.c_str());
+  bool writing = result == FSEQUploadWriter::WRITING;
+  bool failed = result == FSEQUploadWriter::FAILED;
+  doc["complete"] = progress.total > 0 &&
+                    progress.committed >= progress.total && !writing &&
+                    !failed;
+  doc["writing"] = writing;
+  doc["failed"] = failed;
+  String output;
+  serializeJson(doc, output);
+  request->send(code, "application/json", output);
+}
+
+void FSEQUploadSession::sendChunkResult(AsyncWebServerRequest *request,
+                                        const String &filepath) {
+  Chunk *chunk = static_cast<Chunk *>(request->_tempObject);
+  if (!chunk) {
+    request->send(400, "text/plain", "Empty chunk");
+    return;
+  }
+  int code = chunk->status ? chunk->status : 200;
+  if (chunk->closing) {
+    // answered once the writer is done if it already is, 202 otherwise
+    switch (FSEQUploadWriter::getResult(filepath.c_str())) {
+    case FSEQUploadWriter::WRITING:
+      code = 202;
+      break;
+    case FSEQUploadWriter::FAILED: {
+      // the progress file still holds where to continue
+      Progress saved;
+      code = 500;
+      if (readProgress(filepath, saved))
+        chunk->progress = saved;
+      else
+        chunk->progress = {PROGRESS_MAGIC, chunk->progress.total, 0, 0};
+      break;
+    }
+    default:
+      break;
+    }
+  }
+  sendProgress(request, code, filepath, chunk->progress);
+}
+
+void FSEQUploadSession::sendStatus(AsyncWebServerRequest *request,
+                                   const String &filepath) {
+  Progress progress = {PROGRESS_MAGIC, 0, 0, 0};
+  if (!readProgress(filepath, progress))
+    progress = {PROGRESS_MAGIC, 0, 0, 0};
+  sendProgress(request, 200, filepath, progress);
+}
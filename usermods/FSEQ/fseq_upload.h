@@ -0,0 +1,177 @@
+#ifndef FSEQ_UPLOAD_H
+#define FSEQ_UPLOAD_H
+
+#include "wled.h"
+
+// size of one SD write, a multiple of the 512 byte sector size
+#ifndef FSEQ_UPLOAD_CHUNK_SIZE
+#define FSEQ_UPLOAD_CHUNK_SIZE 8192
+#endif
+// chunks buffered between the web server and the writer task
+#ifndef FSEQ_UPLOAD_CHUNKS
+#define FSEQ_UPLOAD_CHUNKS 4
+#endif
+// appended to the file name while an upload is written
+#ifndef FSEQ_UPLOAD_TEMP_SUFFIX
+#define FSEQ_UPLOAD_TEMP_SUFFIX ".part"
+#endif
+// progress of a resumable upload, next to its temporary file
+#ifndef FSEQ_UPLOAD_PROGRESS_SUFFIX
+#define FSEQ_UPLOAD_PROGRESS_SUFFIX ".upl"
+#endif
+
+// Writes uploads to the SD card from its own task. The web server callbacks
+// only copy the data into a bounded queue of chunks. When no chunk is left
+// the TCP receive window is not reopened (AsyncClient::ackLater()) until
+// the writer caught up, so the client slows down instead of the AsyncTCP
+// task waiting for the card. Data goes to a temporary file that replaces
+// filepath once the upload is complete, until then the old file is kept.
+// Finishing does not wait for the card either, the writer task closes the
+// file and reports the result through getResult().
+class FSEQUploadWriter {
+public:
+  enum Result : uint8_t { NONE, WRITING, DONE, FAILED };
+  // runs in the writer task once the file is closed, false fails the upload
+  typedef bool (*CloseHandler)();
+
+  // write the temporary file of filepath from offset on (0 starts a new
+  // one), false if an upload is already running
+  static bool begin(const char *filepath, AsyncWebServerRequest *request,
+                    uint32_t offset = 0);
+  static bool write(const uint8_t *data, size_t len);
+  // queue what is left and the close of the file, false if the upload
+  // already failed; commit renames the temporary file to filepath
+  static bool end(bool commit = true, CloseHandler onClose = nullptr);
+  // stop the upload, a new temporary file is deleted; nothing once end()
+  // queued the close
+  static void abort();
+  // any task: fail the running upload, its request then ends it like one
+  // that failed to write
+  static void cancel() {
+    if (active && !closing)
+      failed = true;
+  }
+
+  // rename the complete temporary file of filepath to filepath
+  static bool commit(const char *filepath);
+
+  // temporary file of filepath and whether name is one of the upload files
+  static String tempPath(const char *filepath) {
+    return String(filepath) + FSEQ_UPLOAD_TEMP_SUFFIX;
+  }
+  static bool isTempFile(const char *name);
+
+  static bool isBusy() { return active; }
+  // state of the last upload if it was one of filepath, NONE otherwise
+  static Result getResult(const char *filepath) {
+    return targetName == filepath ? result : NONE;
+  }
+  static uint32_t getLastRate() { return lastRate; } // bytes/s, last upload
+
+private:
+  FSEQUploadWriter() {}
+
+  struct Message {
+    uint8_t *chunk; // nullptr: close the file
+    uint16_t length;
+  };
+
+  static bool init();
+  static void writerTask(void *);
+  static bool flushChunk();
+  static void resumeClient();
+
+  static TaskHandle_t task;
+  static QueueHandle_t writeQueue; // Message, filled chunks in file order
+  static QueueHandle_t freeQueue;  // uint8_t *, empty chunks
+  static SemaphoreHandle_t clientLock;
+
+  static uint8_t *pool;
+  static File file;
+  static String fileName;          // temporary file
+  static String targetName;
+  static bool keepOnFailure;       // resumed file, keep what it holds
+  static bool commitOnClose;
+  static CloseHandler closeHandler;
+  static uint8_t *fill;            // chunk being filled by write()
+  static uint16_t fillLength;
+  static AsyncClient *client;      // nullptr once disconnected
+  static uint32_t generation;      // upload number, for stale callbacks
+  static volatile bool active;
+  static volatile bool failed;
+  static volatile bool throttled;  // client's receive window kept closed
+  static volatile bool closing;    // close queued, the writer finishes it
+  static volatile Result result;
+  static uint32_t written;
+  static uint32_t startMs;
+  static uint32_t lastRate;
+};
+
+// Resumable uploads: a file is sent as a series of chunk requests, each with
+// its offset in the file and the CRC32 of its data. The verified length and
+// the CRC32 of the data so far are kept in a progress file next to the
+// temporary file, so an interrupted upload continues where it stopped, also
+// after a reboot. The last chunk renames the temporary file to filepath.
+// A chunk still being written when its request ends is answered with 202,
+// the status query tells when it is done.
+class FSEQUploadSession {
+public:
+  // chunk requests carry offset, total (file size) and crc32 (hex) args
+  static bool isChunkRequest(AsyncWebServerRequest *request) {
+    return request->hasArg("offset");
+  }
+  // body callback of a chunk request
+  static void handleChunk(AsyncWebServerRequest *request,
+                          const String &filepath, uint8_t *data, size_t len,
+                          size_t index, size_t total);
+  // request callback of a chunk request, sends the result
+  static void sendChunkResult(AsyncWebServerRequest *request,
+                              const String &filepath);
+  // resume query: the offset the next chunk of filepath has to start at,
+  // also reports an upload of filepath the writer is still finishing
+  static void sendStatus(AsyncWebServerRequest *request,
+                         const String &filepath);
+
+private:
+  FSEQUploadSession() {}
+
+  static const uint32_t PROGRESS_MAGIC = 0x4C505553; // "SUPL"
+
+  struct Progress {
+    uint32_t magic;
+    uint32_t total;     // file size
+    uint32_t committed; // bytes received and verified
+    uint32_t crc;       // CRC32 of the committed bytes
+  };
+
+  // state of one chunk request, freed with the request
+  struct Chunk {
+    uint16_t status;    // HTTP error, 0 while everything is fine
+    bool writing;
+    bool closing;       // handed to the writer, result not known yet
+    uint32_t offset;
+    uint32_t length;
+    uint32_t expectedCrc;
+    uint32_t crc;       // of the chunk data received so far
+    uint32_t fileCrc;   // of the file up to the data received so far
+    Progress progress;  // after this chunk once it is closed
+  };
+
+  static String progressPath(const String &filepath) {
+    return filepath + FSEQ_UPLOAD_PROGRESS_SUFFIX;
+  }
+  static bool readProgress(const String &filepath, Progress &progress);
+  static bool writeProgress(const String &filepath, const Progress &progress);
+  static void finishChunk(AsyncWebServerRequest *request,
+                          const String &filepath, Chunk &chunk);
+  static bool closeChunk();
+  static void sendProgress(AsyncWebServerRequest *request, int code,
+                           const String &filepath, const Progress &progress);
+
+  // chunk being closed by the writer task, one upload runs at a time
+  static String closingPath;
+  static Progress closingProgress;
+  static bool closingDiscard; // file CRC mismatch, start over
+};
+
+#endif // FSEQ_UPLOAD_H
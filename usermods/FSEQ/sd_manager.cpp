@@ -1,16 +1,20 @@
 #include "sd_manager.h"
 #include "usermod_fseq.h"
 
+volatile bool SDManager::suspended = false;
+
 bool SDManager::begin() {
 #if !defined(WLED_USE_SD_SPI) && !defined(WLED_USE_SD_MMC)
 #error "FSEQ requires SD backend (WLED_USE_SD_SPI or WLED_USE_SD_MMC)"
 #endif
 
 #ifdef WLED_USE_SD_SPI
-  if (!SD_ADAPTER.begin(WLED_PIN_SS, spiPort))
+  if (!SD_ADAPTER.begin(WLED_PIN_SS, spiPort, 4000000, "/sd",
+                        FSEQ_SD_MAX_FILES))
     return false;
 #elif defined(WLED_USE_SD_MMC)
-  if (!SD_ADAPTER.begin())
+  if (!SD_ADAPTER.begin("/sdcard", false, false, BOARD_MAX_SDMMC_FREQ,
+                        FSEQ_SD_MAX_FILES))
     return false;
 #endif
   return true;
@@ -2,6 +2,8 @@
 #define SD_MANAGER_H
 
 #include "wled.h"
+#include "fseq_cache.h"
+#include "fseq_manager.h"
 
 #ifdef WLED_USE_SD_SPI
   #include <SPI.h>
@@ -10,12 +12,27 @@
   #include "SD_MMC.h"
 #endif
 
+// files the SD card is mounted for (the driver default is 5): one per
+// player, the seek anchors of player 0, the sequence cache, an upload and
+// its progress file, a recording, and the file index scan (directory and
+// the file being read)
+#ifndef FSEQ_SD_MAX_FILES
+#define FSEQ_SD_MAX_FILES (FSEQ_MAX_PLAYERS + FSEQ_SEEK_ANCHORS + 6)
+#endif
+
 class SDManager {
   public:
     SDManager() {}
     bool begin();
     void end();
     bool deleteFile(const char* path);
+
+    // set while the card is remounted, no new uploads or recordings start
+    static bool isSuspended() { return suspended; }
+    static void suspend(bool on) { suspended = on; }
+
+  private:
+    static volatile bool suspended;
 };
 
 #endif // SD_MANAGER_H
\ No newline at end of file
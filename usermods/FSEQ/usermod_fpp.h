@@ -1,5 +1,8 @@
 #pragma once
 
+#include "fseq_remote.h"
+#include "fseq_sync.h"
+#include "fseq_upload.h"
 #include "usermod_fseq.h" // Contains FSEQ playback logic and getter methods for pins
 #include "wled.h"
 
@@ -13,65 +16,6 @@
 #include <AsyncUDP.h>
 #include <ESPAsyncWebServer.h>
 
-// ----- Minimal WriteBufferingStream Implementation -----
-// This class buffers data before writing it to an underlying Stream.
-class WriteBufferingStream : public Stream {
-public:
-  WriteBufferingStream(Stream &upstream, size_t capacity)
-      : _upstream(upstream) {
-    _capacity = capacity;
-    _buffer = (uint8_t *)malloc(capacity);
-    _offset = 0;
-    if (!_buffer) {
-      DEBUG_PRINTLN(F("[WBS] ERROR: Buffer allocation failed"));
-    }
-  }
-  ~WriteBufferingStream() {
-    flush();
-    if (_buffer)
-      free(_buffer);
-  }
-  // Write a block of data to the buffer
-  size_t write(const uint8_t *buffer, size_t size) override {
-	if (!_buffer) return 0;
-    size_t total = 0;
-    while (size > 0) {
-      size_t space = _capacity - _offset;
-      size_t toCopy = (size < space) ? size : space;
-      memcpy(_buffer + _offset, buffer, toCopy);
-      _offset += toCopy;
-      buffer += toCopy;
-      size -= toCopy;
-      total += toCopy;
-      if (_offset == _capacity)
-        flush();
-    }
-    return total;
-  }
-  // Write a single byte
-  size_t write(uint8_t b) override { return write(&b, 1); }
-  // Flush the buffer to the upstream stream
-  void flush() override {
-    if (_offset > 0) {
-      _upstream.write(_buffer, _offset);
-      _offset = 0;
-    }
-    _upstream.flush();
-  }
-  int available() override { return _upstream.available(); }
-  int read() override { return _upstream.read(); }
-  int peek() override { return _upstream.peek(); }
-
-private:
-  Stream &_upstream;
-  uint8_t *_buffer = nullptr;
-  size_t _capacity = 0;
-  size_t _offset = 0;
-};
-// ----- End WriteBufferingStream -----
-
-#define FILE_UPLOAD_BUFFER_SIZE 8192
-
 // Definitions for UDP (FPP) synchronization
 #define CTRL_PKT_SYNC 1
 #define CTRL_PKT_PING 4
@@ -109,384 +53,267 @@ private:
   const uint16_t udpPort = UDP_SYNC_PORT; // UDP port
 
   // Variables for FSEQ file upload
-  File currentUploadFile;
   String currentUploadFileName = "";
   unsigned long uploadStartTime = 0;
-  WriteBufferingStream *uploadStream = nullptr;
-
-  // Returns device name from server description
-  String getDeviceName() { return String(serverDescription); }
-
-  // Build JSON with system information
-  String buildSystemInfoJSON() {
-    DynamicJsonDocument doc(1024);
-
-    String devName = getDeviceName();
-
-	String id = "WLED-" + WiFi.macAddress();
-    id.replace(":", "");
-
-    doc["HostName"] = id;
-    doc["HostDescription"] = devName;
-    doc["Platform"] = "ESP32";
-    doc["Variant"] = "WLED";
-    doc["Mode"] = "remote";
-    doc["Version"] = versionString;
-    
-	uint16_t major = 0, minor = 0;
-    String ver = versionString;
-    int dashPos = ver.indexOf('-');
-    if (dashPos > 0) ver = ver.substring(0, dashPos);
-    int dotPos = ver.indexOf('.');
-    if (dotPos > 0) { major = ver.substring(0, dotPos).toInt(); minor = ver.substring(dotPos + 1).toInt(); }
-    else { major = ver.toInt(); }
-    doc["majorVersion"] = major;
-    doc["minorVersion"] = minor;
-    doc["typeId"] = 195;
-    doc["UUID"] = WiFi.macAddress();
-
-    JsonObject utilization = doc.createNestedObject("Utilization");
-    utilization["MemoryFree"] = ESP.getFreeHeap();
-    utilization["Uptime"] = millis();
-    
-    doc["rssi"] = WiFi.RSSI();
-
-    JsonArray ips = doc.createNestedArray("IPS");
-    ips.add(WiFi.localIP().toString());
-
-    String json;
-    serializeJson(doc, json);
-    return json;
+  bool uploadActive = false; // this endpoint owns FSEQUploadWriter
+  bool uploadFailed = false;
+
+  // HTTP error of a raw upload, 0 while it is fine; kept with the request,
+  // the web server frees it
+  static void setUploadStatus(AsyncWebServerRequest *request,
+                              uint16_t status) {
+    if (!request->_tempObject)
+      request->_tempObject = malloc(sizeof(uint16_t));
+    if (request->_tempObject)
+      *static_cast<uint16_t *>(request->_tempObject) = status;
   }
 
-	// Build JSON with system status
-	String buildSystemStatusJSON() {
-
-	  DynamicJsonDocument doc(2048);
-
-	  // --------------------------------------------------
-	  // MQTT
-	  // --------------------------------------------------
-	  JsonObject mqtt = doc.createNestedObject("MQTT");
-	  mqtt["configured"] = false;
-	  mqtt["connected"] = false;
-
-	  // --------------------------------------------------
-	  // Playlist Info
-	  // --------------------------------------------------
-	  JsonObject currentPlaylist = doc.createNestedObject("current_playlist");
-	  currentPlaylist["count"] = "0";
-	  currentPlaylist["description"] = "";
-	  currentPlaylist["index"] = "0";
-	  currentPlaylist["playlist"] = "";
-	  currentPlaylist["type"] = "";
-
-	  // --------------------------------------------------
-	  // Basic Status
-	  // --------------------------------------------------
-	  doc["volume"] = 70;
-	  doc["media_filename"] = "";
-	  doc["fppd"] = "running";
-	  doc["current_song"] = "";
-
-	  if (FSEQPlayer::isPlaying()) {
-
-		String fileName = FSEQPlayer::getFileName();
-		float elapsedF = FSEQPlayer::getElapsedSeconds();
-        uint32_t elapsed = (uint32_t)elapsedF;
-
-		doc["current_sequence"] = fileName;
-		doc["playlist"] = "";
-		doc["seconds_elapsed"] = String(elapsed);
-		doc["seconds_played"] = String(elapsed);
-		doc["seconds_remaining"] = "0";
-		doc["sequence_filename"] = fileName;
-
-		uint32_t mins = elapsed / 60;
-		uint32_t secs = elapsed % 60;
-		char timeStr[16];
-        snprintf(timeStr, sizeof(timeStr), "%02u:%02u", mins, secs);
-
-		doc["time_elapsed"] = timeStr;
-		doc["time_remaining"] = "00:00";
-
-		doc["status"] = 1;
-		doc["status_name"] = "playing";
-		doc["mode"] = 8;
-		doc["mode_name"] = "remote";
-
-	  } else {
-
-		doc["current_sequence"] = "";
-		doc["playlist"] = "";
-		doc["seconds_elapsed"] = "0";
-		doc["seconds_played"] = "0";
-		doc["seconds_remaining"] = "0";
-		doc["sequence_filename"] = "";
-		doc["time_elapsed"] = "00:00";
-		doc["time_remaining"] = "00:00";
-		doc["status"] = 0;
-		doc["status_name"] = "idle";
-		doc["mode"] = 8;
-		doc["mode_name"] = "remote";
-	  }
-
-	  // --------------------------------------------------
-	  // Advanced View
-	  // --------------------------------------------------
-	  JsonObject adv = doc.createNestedObject("advancedView");
-
-      String devName = getDeviceName();
-		
-      String id = "WLED-" + WiFi.macAddress();
-      id.replace(":", "");
-		
-	  adv["HostName"] = id;
-	  adv["HostDescription"] = devName;
-	  adv["Platform"] = "WLED";
-	  adv["Variant"] = "ESP32";
-	  adv["Mode"] = "remote";
-	  adv["Version"] = versionString;
-
-	  uint16_t major = 0;
-	  uint16_t minor = 0;
-
-	  String ver = versionString;
-	  int dashPos = ver.indexOf('-');
-	  if (dashPos > 0) {
-		ver = ver.substring(0, dashPos);
-	  }
-
-	  int dotPos = ver.indexOf('.');
-	  if (dotPos > 0) {
-		major = ver.substring(0, dotPos).toInt();
-		minor = ver.substring(dotPos + 1).toInt();
-	  } else {
-		major = ver.toInt();
-		minor = 0;
-	  }
-
-	  adv["majorVersion"] = major;
-	  adv["minorVersion"] = minor;
-	  adv["typeId"] = 195;
-	  adv["UUID"] = WiFi.macAddress();
-
-	  JsonObject util = adv.createNestedObject("Utilization");
-	  util["MemoryFree"] = ESP.getFreeHeap();
-	  util["Uptime"] = millis();
-
-	  adv["rssi"] = WiFi.RSSI();
-
-	  JsonArray ips = adv.createNestedArray("IPS");
-	  ips.add(WiFi.localIP().toString());
-
-	  // --------------------------------------------------
-	  // Serialize
-	  // --------------------------------------------------
-	  String json;
-	  serializeJson(doc, json);
-	  return json;
-	}
-
-  // Build JSON for FPP multi-sync systems
-	String buildFppdMultiSyncSystemsJSON() {
-	  DynamicJsonDocument doc(1024);
-
-	  JsonArray systems = doc.createNestedArray("systems");
-	  JsonObject sys = systems.createNestedObject();
-
-	  String devName = getDeviceName();
-
-	  String id = "WLED-" + WiFi.macAddress();
-      id.replace(":", "");
-
-	  sys["hostname"] = devName;
-	  sys["id"] = id;
-	  sys["ip"] = WiFi.localIP().toString();
-	  sys["version"] = versionString;
-	  sys["hardwareType"] = "WLED";
-	  sys["type"] = 195;
-	  sys["num_chan"] = strip.getLength() * 3;
-	  sys["NumPixelPort"] = 1;
-	  sys["NumSerialPort"] = 0;
-	  sys["mode"] = "remote";
-
-	  String json;
-	  serializeJson(doc, json);
-	  return json;
-	}
-
-  // UDP - send a ping packet
-void sendPingPacket(IPAddress destination = IPAddress(255, 255, 255, 255)) {
-  uint8_t buf[301];
-  memset(buf, 0, sizeof(buf));
-
-  // --------------------------------------------------
-  // Header
-  // --------------------------------------------------
-  buf[0] = 'F';
-  buf[1] = 'P';
-  buf[2] = 'P';
-  buf[3] = 'D';
-
-  buf[4] = 0x04;  // PacketType = Ping
-
-  // ExtraDataLen = 294 (Ping v3)  -> LITTLE ENDIAN
-  uint16_t dataLen = 294;
-  buf[5] = dataLen & 0xFF;
-  buf[6] = (dataLen >> 8) & 0xFF;
-
-  buf[7] = 0x03;  // Ping packet version = 3
-  buf[8] = 0x00;  // SubType = Ping
-
-  buf[9] = 0xC3;  // Hardware Type = ESPixelStick
+  // Target of an /fpp upload, from the filename argument
+  static String getUploadFileName(AsyncWebServerRequest *request) {
+    String fileParam = "";
+    if (request->hasParam("filename")) {
+      fileParam = request->arg("filename");
+    }
+    return (fileParam != "")
+               ? (fileParam.startsWith("/") ? fileParam : "/" + fileParam)
+               : "/default.fseq";
+  }
 
-  // --------------------------------------------------
-  // Version (MSB first!)
-  // --------------------------------------------------
+  // Identity reported in pings and the system JSON, derived once in setup()
+  char hostId[24] = "";  // "WLED-" + MAC without colons
+  char uuid[18] = "";    // MAC with colons
+  char ipAddress[16] = "";
   uint16_t versionMajor = 0;
   uint16_t versionMinor = 0;
 
-  String ver = versionString;
-
-  int dashPos = ver.indexOf('-');
-  if (dashPos > 0) {
-    ver = ver.substring(0, dashPos);
+  // Responses to the FPP master's polls, built once by buildResponses().
+  // Strings are referenced by pointer (const char *), so updating a field
+  // does not grow the documents; refresh*() only set the changing fields.
+  StaticJsonDocument<512> infoDoc;
+  StaticJsonDocument<1024> statusDoc;
+  StaticJsonDocument<384> multiSyncDoc;
+  bool responsesBuilt = false;
+  // playback fields of statusDoc
+  char sequenceName[65] = "";
+  char mediaName[65] = "";
+  char secondsElapsed[12] = "0";
+  char secondsRemaining[12] = "0";
+  char timeElapsed[12] = "00:00";
+  char timeRemaining[12] = "00:00";
+
+  // FPP ping v3, built once, only the IP address changes
+  static const size_t PING_PACKET_SIZE = 301;
+  uint8_t pingPacket[PING_PACKET_SIZE];
+  bool pingBuilt = false;
+
+  void initIdentity() {
+    uint8_t mac[6];
+    WiFi.macAddress(mac);
+    snprintf(hostId, sizeof(hostId), "WLED-%02X%02X%02X%02X%02X%02X", mac[0],
+             mac[1], mac[2], mac[3], mac[4], mac[5]);
+    snprintf(uuid, sizeof(uuid), "%02X:%02X:%02X:%02X:%02X:%02X", mac[0],
+             mac[1], mac[2], mac[3], mac[4], mac[5]);
+
+    // "major.minor[.patch][-suffix]"
+    char *end;
+    versionMajor = strtoul(versionString, &end, 10);
+    versionMinor = *end == '.' ? strtoul(end + 1, nullptr, 10) : 0;
   }
 
-  int dotPos = ver.indexOf('.');
-  if (dotPos > 0) {
-	versionMajor = ver.substring(0, dotPos).toInt();
-	versionMinor = ver.substring(dotPos + 1).toInt();
+  void refreshIpAddress() {
+    IPAddress ip = WiFi.localIP();
+    snprintf(ipAddress, sizeof(ipAddress), "%u.%u.%u.%u", ip[0], ip[1], ip[2],
+             ip[3]);
   }
 
-  buf[10] = (versionMajor >> 8) & 0xFF;
-  buf[11] = versionMajor & 0xFF;
-  buf[12] = (versionMinor >> 8) & 0xFF;
-  buf[13] = versionMinor & 0xFF;
-
-  // --------------------------------------------------
-  // Operating Mode Flags
-  // 0x08 = Remote
-  // --------------------------------------------------
-  buf[14] = 0x08;
-
-  // --------------------------------------------------
-  // IP Address
-  // --------------------------------------------------
-  IPAddress ip = WiFi.localIP();
-  buf[15] = ip[0];
-  buf[16] = ip[1];
-  buf[17] = ip[2];
-  buf[18] = ip[3];
-
-  // --------------------------------------------------
-  // Hostname (19-83) 64 bytes + NULL
-  // --------------------------------------------------
-
-  String id = "WLED-" + WiFi.macAddress();
-  id.replace(":", "");
-
-  if (id.length() > 64)
-    id = id.substring(0, 64);
-
-  for (int i = 0; i < 64; i++) {
-    buf[19 + i] = (i < id.length()) ? id[i] : 0;
+  // fields shared by /api/system/info and the advancedView of the status
+  void addSystemInfo(JsonObject obj) {
+    obj["HostName"] = (const char *)hostId;
+    obj["HostDescription"] = (const char *)serverDescription;
+    obj["Platform"] = "ESP32";
+    obj["Variant"] = "WLED";
+    obj["Mode"] = "remote";
+    obj["Version"] = (const char *)versionString;
+    obj["majorVersion"] = versionMajor;
+    obj["minorVersion"] = versionMinor;
+    obj["typeId"] = 195;
+    obj["UUID"] = (const char *)uuid;
+    JsonObject utilization = obj.createNestedObject("Utilization");
+    utilization["MemoryFree"] = 0;
+    utilization["Uptime"] = 0;
+    obj["rssi"] = 0;
+    JsonArray ips = obj.createNestedArray("IPS");
+    ips.add((const char *)ipAddress);
   }
 
-  // --------------------------------------------------
-  // Version String (84-124) 40 bytes + NULL
-  // --------------------------------------------------
-  String verStr = versionString;
-  for (int i = 0; i < 40; i++) {
-    buf[84 + i] = (i < verStr.length()) ? verStr[i] : 0;
+  void refreshSystemInfo(JsonObject obj) {
+    obj["Utilization"]["MemoryFree"] = ESP.getFreeHeap();
+    obj["Utilization"]["Uptime"] = millis();
+    obj["rssi"] = WiFi.RSSI();
   }
 
-  // --------------------------------------------------
-  // Hardware Type String (125-165) 40 bytes + NULL
-  // --------------------------------------------------
-  String hwType = "WLED";
-  for (int i = 0; i < 40; i++) {
-    buf[125 + i] = (i < hwType.length()) ? hwType[i] : 0;
+  void buildResponses() {
+    infoDoc.clear();
+    addSystemInfo(infoDoc.to<JsonObject>());
+
+    statusDoc.clear();
+    JsonObject mqtt = statusDoc.createNestedObject("MQTT");
+    mqtt["configured"] = false;
+    mqtt["connected"] = false;
+    JsonObject currentPlaylist = statusDoc.createNestedObject("current_playlist");
+    currentPlaylist["count"] = "0";
+    currentPlaylist["description"] = "";
+    currentPlaylist["index"] = "0";
+    currentPlaylist["playlist"] = "";
+    currentPlaylist["type"] = "";
+    statusDoc["volume"] = 70;
+    statusDoc["fppd"] = "running";
+    statusDoc["current_song"] = "";
+    statusDoc["playlist"] = "";
+    statusDoc["current_sequence"] = (const char *)sequenceName;
+    statusDoc["sequence_filename"] = (const char *)sequenceName;
+    statusDoc["media_filename"] = (const char *)mediaName;
+    statusDoc["seconds_elapsed"] = (const char *)secondsElapsed;
+    statusDoc["seconds_played"] = (const char *)secondsElapsed;
+    statusDoc["seconds_remaining"] = (const char *)secondsRemaining;
+    statusDoc["time_elapsed"] = (const char *)timeElapsed;
+    statusDoc["time_remaining"] = (const char *)timeRemaining;
+    statusDoc["status"] = 0;
+    statusDoc["status_name"] = "idle";
+    statusDoc["mode"] = 8;
+    statusDoc["mode_name"] = "remote";
+    addSystemInfo(statusDoc.createNestedObject("advancedView"));
+    // the status reports platform and variant the other way round
+    statusDoc["advancedView"]["Platform"] = "WLED";
+    statusDoc["advancedView"]["Variant"] = "ESP32";
+
+    multiSyncDoc.clear();
+    JsonObject sys = multiSyncDoc.createNestedArray("systems").createNestedObject();
+    sys["hostname"] = (const char *)serverDescription;
+    sys["id"] = (const char *)hostId;
+    sys["ip"] = (const char *)ipAddress;
+    sys["version"] = (const char *)versionString;
+    sys["hardwareType"] = "WLED";
+    sys["type"] = 195;
+    sys["num_chan"] = 0;
+    sys["NumPixelPort"] = 1;
+    sys["NumSerialPort"] = 0;
+    sys["mode"] = "remote";
+
+    responsesBuilt = true;
   }
 
-  // --------------------------------------------------
-  // Channel Ranges (166-286) 120 bytes + NULL
-  // --------------------------------------------------
-  String channelRanges = "";
-  for (int i = 0; i < 120; i++) {
-    buf[166 + i] = (i < channelRanges.length()) ? channelRanges[i] : 0;
+  void refreshPlayback() {
+    FSEQPlayer &player = FSEQPlayerManager::primary();
+    bool playing = player.isPlaying();
+    uint32_t elapsed = playing ? (uint32_t)player.getElapsedSeconds() : 0;
+    uint32_t remaining = playing ? (uint32_t)player.getRemainingSeconds() : 0;
+    strlcpy(sequenceName, playing ? player.getFileName().c_str() : "",
+            sizeof(sequenceName));
+    strlcpy(mediaName, playing ? player.getMediaFileName().c_str() : "",
+            sizeof(mediaName));
+    snprintf(secondsElapsed, sizeof(secondsElapsed), "%u", elapsed);
+    snprintf(secondsRemaining, sizeof(secondsRemaining), "%u", remaining);
+    snprintf(timeElapsed, sizeof(timeElapsed), "%02u:%02u", elapsed / 60,
+             elapsed % 60);
+    snprintf(timeRemaining, sizeof(timeRemaining), "%02u:%02u",
+             remaining / 60, remaining % 60);
+    statusDoc["status"] = playing ? 1 : 0;
+    statusDoc["status_name"] = playing ? "playing" : "idle";
   }
 
-  // --------------------------------------------------
-  // Send packet
-  // --------------------------------------------------
-  udp.writeTo(buf, sizeof(buf), destination, udpPort);
-}
-
-  // UDP - process received packet
-  void processUdpPacket(AsyncUDPPacket packet) {
-    // Print the raw UDP packet in hex format for debugging
-    //  DEBUG_PRINTLN(F("[FPP] Raw UDP Packet:"));
-    //for (size_t i = 0; i < packet.length(); i++) {
-    //   DEBUG_PRINTF("%02X ", packet.data()[i]);
-    // }
-    // DEBUG_PRINTLN();
-
-    if (packet.length() < 5)
-      return;
-    if (packet.data()[0] != 'F' || packet.data()[1] != 'P' ||
-        packet.data()[2] != 'P' || packet.data()[3] != 'D')
-      return;
-    uint8_t packetType = packet.data()[4];
-    switch (packetType) {
-    case CTRL_PKT_SYNC: {
-
-	  const size_t baseSize = 17; // up to seconds_elapsed
-
-	  if (packet.length() <= baseSize) {
-		DEBUG_PRINTLN(F("[FPP] Sync packet too short, ignoring"));
-		break;
-	  }
-
-	  uint8_t syncAction = packet.data()[7];
-	  uint32_t frameNumber = 0;
-	  float secondsElapsed = 0.0f;
-	  memcpy(&frameNumber, packet.data() + 9, sizeof(frameNumber));
-	  memcpy(&secondsElapsed, packet.data() + 13, sizeof(secondsElapsed));
-
-	  DEBUG_PRINTLN(F("[FPP] Received UDP sync packet"));
-	  DEBUG_PRINTF("[FPP] Sync Packet - Action: %d\n", syncAction);
-	  DEBUG_PRINTF("[FPP] Frame Number: %lu\n", frameNumber);
-	  DEBUG_PRINTF("[FPP] Seconds Elapsed: %.2f\n", secondsElapsed);
+  static void sendJSON(AsyncWebServerRequest *request, JsonDocument &doc) {
+    String json;
+    json.reserve(measureJson(doc) + 1);
+    serializeJson(doc, json);
+    request->send(200, "application/json", json);
+  }
 
-	  // ---- SAFE filename extraction ----
-	  size_t filenameOffset = 17;
-	  size_t maxFilenameLen =
-		  min((size_t)64, packet.length() - filenameOffset);
+  // Handlers of the FPP system endpoints, run in the web server task
+  void sendSystemInfo(AsyncWebServerRequest *request) {
+    refreshIpAddress();
+    refreshSystemInfo(infoDoc.as<JsonObject>());
+    sendJSON(request, infoDoc);
+  }
 
-	  char safeFilename[65];
-	  memcpy(safeFilename,
-			 packet.data() + filenameOffset,
-			 maxFilenameLen);
+  void sendSystemStatus(AsyncWebServerRequest *request) {
+    refreshIpAddress();
+    refreshPlayback();
+    refreshSystemInfo(statusDoc["advancedView"].as<JsonObject>());
+    sendJSON(request, statusDoc);
+  }
 
-	  safeFilename[maxFilenameLen] = '\0';
+  void sendMultiSyncSystems(AsyncWebServerRequest *request) {
+    refreshIpAddress();
+    multiSyncDoc["systems"][0]["num_chan"] = strip.getLength() * 3;
+    sendJSON(request, multiSyncDoc);
+  }
 
-	  DEBUG_PRINT(F("[FPP] Filename: "));
-	  DEBUG_PRINTLN(safeFilename);
+  void buildPingPacket() {
+    uint8_t *buf = pingPacket;
+    memset(buf, 0, PING_PACKET_SIZE);
+
+    // Header
+    memcpy(buf, "FPPD", 4);
+    buf[4] = CTRL_PKT_PING;
+    // ExtraDataLen = 294 (Ping v3), little endian
+    uint16_t dataLen = PING_PACKET_SIZE - 7;
+    buf[5] = dataLen & 0xFF;
+    buf[6] = (dataLen >> 8) & 0xFF;
+    buf[7] = 0x03; // Ping packet version = 3
+    buf[8] = 0x00; // SubType = Ping
+    buf[9] = 0xC3; // Hardware Type = ESPixelStick
+
+    // Version, MSB first
+    buf[10] = (versionMajor >> 8) & 0xFF;
+    buf[11] = versionMajor & 0xFF;
+    buf[12] = (versionMinor >> 8) & 0xFF;
+    buf[13] = versionMinor & 0xFF;
+
+    buf[14] = 0x08; // Operating Mode Flags: 0x08 = Remote
+    // IP address (15-18) is set on every send
+
+    // Hostname (19-83) 64 bytes + NULL
+    strncpy((char *)buf + 19, hostId, 64);
+    // Version String (84-124) 40 bytes + NULL
+    strncpy((char *)buf + 84, versionString, 40);
+    // Hardware Type String (125-165) 40 bytes + NULL
+    strncpy((char *)buf + 125, "WLED", 40);
+    // Channel Ranges (166-286) 120 bytes + NULL, none
+
+    pingBuilt = true;
+  }
 
-	  ProcessSyncPacket(syncAction, String(safeFilename), secondsElapsed);
+  // UDP - send a ping packet
+  void sendPingPacket(IPAddress destination = IPAddress(255, 255, 255, 255)) {
+    if (!pingBuilt)
+      return; // before setup()
+    IPAddress ip = WiFi.localIP();
+    pingPacket[15] = ip[0];
+    pingPacket[16] = ip[1];
+    pingPacket[17] = ip[2];
+    pingPacket[18] = ip[3];
+    udp.writeTo(pingPacket, PING_PACKET_SIZE, destination, udpPort);
+  }
 
-	  break;
-	}
+  // UDP - process received packet
+  // Runs in the AsyncUDP task: sync and blank packets are only queued for
+  // loop(), nothing here allocates or touches the SD card or the LEDs.
+  void processUdpPacket(AsyncUDPPacket &packet) {
+    const uint8_t *data = packet.data();
+    size_t length = packet.length();
+    if (length < 5 || memcmp(data, "FPPD", 4) != 0)
+      return;
+    switch (data[4]) {
+    case CTRL_PKT_SYNC:
+      if (!FSEQSyncQueue::pushSync(data, length))
+        DEBUG_PRINTLN(F("[FPP] Sync packet ignored"));
+      break;
     case CTRL_PKT_PING:
-      DEBUG_PRINTLN(F("[FPP] Received UDP ping packet"));
       sendPingPacket(packet.remoteIP());
       break;
     case CTRL_PKT_BLANK:
-      DEBUG_PRINTLN(F("[FPP] Received UDP blank packet"));
-      FSEQPlayer::clearLastPlayback();
-      realtimeLock(10, REALTIME_MODE_INACTIVE);
+      FSEQSyncQueue::pushBlank();
       break;
     default:
       DEBUG_PRINTLN(F("[FPP] Unknown UDP packet type"));
@@ -494,51 +321,6 @@ void sendPingPacket(IPAddress destination = IPAddress(255, 255, 255, 255)) {
     }
   }
 
-  // Process sync command with detailed debug output
-  void ProcessSyncPacket(uint8_t action, String fileName,
-                         float secondsElapsed) {
-    // Ensure the filename is absolute
-    if (!fileName.startsWith("/")) {
-      fileName = "/" + fileName;
-    }
-
-    DEBUG_PRINTLN(F("[FPP] ProcessSyncPacket: Sync command received"));
-    DEBUG_PRINTF("[FPP] Action: %d\n", action);
-    DEBUG_PRINT(F("[FPP] FileName: "));
-    DEBUG_PRINTLN(fileName);
-    DEBUG_PRINTF("[FPP] Seconds Elapsed: %.2f\n", secondsElapsed);
-
-    switch (action) {
-    case 0: // SYNC_PKT_START
-      FSEQPlayer::loadRecording(fileName.c_str(), 0, strip.getLength(),
-                                secondsElapsed);
-      break;
-    case 1: // SYNC_PKT_STOP
-      FSEQPlayer::clearLastPlayback();
-      realtimeLock(10, REALTIME_MODE_INACTIVE);
-      break;
-    case 2: // SYNC_PKT_SYNC
-      DEBUG_PRINTLN(F("[FPP] ProcessSyncPacket: Sync command received"));
-      DEBUG_PRINTF("[FPP] Sync Packet - FileName: %s, Seconds Elapsed: %.2f\n",
-                   fileName.c_str(), secondsElapsed);
-      if (!FSEQPlayer::isPlaying()) {
-        DEBUG_PRINTLN(F("[FPP] Sync: Playback not active, starting playback."));
-        FSEQPlayer::loadRecording(fileName.c_str(), 0, strip.getLength(),
-                                  secondsElapsed);
-      } else {
-        FSEQPlayer::syncPlayback(secondsElapsed);
-      }
-      break;
-    case 3: // SYNC_PKT_OPEN
-      DEBUG_PRINTLN(F(
-          "[FPP] Open command received – metadata request (not implemented)"));
-      break;
-    default:
-      DEBUG_PRINTLN(F("[FPP] ProcessSyncPacket: Unknown sync action"));
-      break;
-    }
-  }
-
 public:
   static const char _name[];
 
@@ -547,27 +329,58 @@ public:
     DEBUG_PRINTF("[%s] FPP Usermod loaded\n", _name);
 
     // Register API endpoints
+    // polled by the FPP master, the responses are built once here
+    initIdentity();
+    refreshIpAddress();
+    buildResponses();
+    buildPingPacket();
     server.on("/api/system/info", HTTP_GET,
               [this](AsyncWebServerRequest *request) {
-                String json = buildSystemInfoJSON();
-                request->send(200, "application/json", json);
+                sendSystemInfo(request);
               });
     server.on("/api/system/status", HTTP_GET,
               [this](AsyncWebServerRequest *request) {
-                String json = buildSystemStatusJSON();
-                request->send(200, "application/json", json);
+                sendSystemStatus(request);
               });
     server.on("/api/fppd/multiSyncSystems", HTTP_GET,
-			  [this](AsyncWebServerRequest *request) {
-				String json = buildFppdMultiSyncSystemsJSON();
-				request->send(200, "application/json", json);
-			  });
+              [this](AsyncWebServerRequest *request) {
+                sendMultiSyncSystems(request);
+              });
     // Other API endpoints as needed...
 
     // Endpoint for file upload (raw, application/octet-stream)
     server.on(
     "/fpp", HTTP_POST,
-    [](AsyncWebServerRequest *request) {
+    [this](AsyncWebServerRequest *request) {
+        // resumable upload: offset, total and crc32 args, one chunk per request
+        if (FSEQUploadSession::isChunkRequest(request)) {
+            FSEQUploadSession::sendChunkResult(request,
+                                               getUploadFileName(request));
+            return;
+        }
+        uint16_t *status = static_cast<uint16_t *>(request->_tempObject);
+        if (!status) {
+            request->send(400, "text/plain", "No file data");
+        } else if (*status == 409) {
+            request->send(409, "text/plain", "Upload already in progress");
+        } else if (*status) {
+            request->send(500, "text/plain", "File write failed");
+        } else {
+            // the writer task may still be closing the file, the client
+            // polls /api/sd/upload/status?file= after a 202
+            switch (FSEQUploadWriter::getResult(
+                currentUploadFileName.c_str())) {
+            case FSEQUploadWriter::WRITING:
+                request->send(202, "text/plain", "Upload received, writing");
+                break;
+            case FSEQUploadWriter::FAILED:
+                request->send(500, "text/plain", "File write failed");
+                break;
+            default:
+                request->send(200, "text/plain", "Upload complete");
+                break;
+            }
+        }
     },
     NULL,
     [this](AsyncWebServerRequest *request,
@@ -577,109 +390,72 @@ public:
         // Debug optional:
         DEBUG_PRINTF("[FPP] Chunk index=%u len=%u total=%u\n", index, len, total);
 
+        if (FSEQUploadSession::isChunkRequest(request)) {
+            FSEQUploadSession::handleChunk(request, getUploadFileName(request),
+                                           data, len, index, total);
+            return;
+        }
+
         if (index == 0) {
-			if (uploadStream || currentUploadFile) {
-                request->send(409, "text/plain", "Upload already in progress");
+            if (FSEQUploadWriter::isBusy()) {
+                setUploadStatus(request, 409);
                 return;
             }
 
             DEBUG_PRINTLN("[FPP] Starting file upload");
 
-            if (uploadStream) {
-                uploadStream->flush();
-                delete uploadStream;
-                uploadStream = nullptr;
-            }
-
-            if (currentUploadFile) {
-                currentUploadFile.close();
-            }
-
-            String fileParam = "";
-            if (request->hasParam("filename")) {
-                fileParam = request->arg("filename");
-            }
-
-            currentUploadFileName =
-                (fileParam != "")
-                    ? (fileParam.startsWith("/") ? fileParam : "/" + fileParam)
-                    : "/default.fseq";
+            currentUploadFileName = getUploadFileName(request);
 
             DEBUG_PRINTF("[FPP] Using filename: %s\n",
                          currentUploadFileName.c_str());
 
-            if (SD_ADAPTER.exists(currentUploadFileName.c_str())) {
-                SD_ADAPTER.remove(currentUploadFileName.c_str());
-            }
-
-            currentUploadFile =
-                SD_ADAPTER.open(currentUploadFileName.c_str(), FILE_WRITE);
-
-            if (!currentUploadFile) {
+            // chunks are written to SD by the writer task, a full queue
+            // holds back the TCP window instead of blocking this callback
+            if (!FSEQUploadWriter::begin(currentUploadFileName.c_str(),
+                                         request)) {
                 DEBUG_PRINTLN(F("[FPP] ERROR: Failed to open file"));
-                request->send(500, "text/plain", "File open failed");
+                setUploadStatus(request, 500);
                 return;
             }
 
-            uploadStream = new WriteBufferingStream(
-                currentUploadFile, FILE_UPLOAD_BUFFER_SIZE);
-
+            uploadActive = true;
+            uploadFailed = false;
+            setUploadStatus(request, 0);
             uploadStartTime = millis();
         }
 
-        if (uploadStream) {
-            uploadStream->write(data, len);
+        if (!uploadActive) {
+            return;
         }
 
-        if (index + len == total) {
-
-            DEBUG_PRINTLN("[FPP] Upload finished");
-
-            if (uploadStream) {
-                uploadStream->flush();
-                delete uploadStream;
-                uploadStream = nullptr;
-            }
+        if (!FSEQUploadWriter::write(data, len)) {
+            uploadFailed = true;
+        }
 
-            if (currentUploadFile) {
-                currentUploadFile.close();
+        if (index + len == total || uploadFailed) {
+            uploadActive = false;
+            // the existing file is only replaced by a complete upload, the
+            // writer task closes and renames it after this callback
+            if (!FSEQUploadWriter::end() || uploadFailed) {
+                DEBUG_PRINTLN(F("[FPP] ERROR: Upload failed"));
+                setUploadStatus(request, 500);
+                return;
             }
 
             unsigned long duration = millis() - uploadStartTime;
-            DEBUG_PRINTF("[FPP] Upload complete in %lu ms\n", duration);
-
-            currentUploadFileName = "";
-
-            request->send(200, "text/plain", "Upload complete");
+            DEBUG_PRINTF("[FPP] Upload received in %lu ms\n", duration);
         }
     });
 
 
     // Endpoint to list FSEQ files on SD card
     server.on("/fseqfilelist", HTTP_GET, [](AsyncWebServerRequest *request) {
-      DynamicJsonDocument doc(1024);
-      JsonArray files = doc.createNestedArray("files");
-
-      File root = SD_ADAPTER.open("/");
-      if (root && root.isDirectory()) {
-        File file = root.openNextFile();
-        while (file) {
-          String name = file.name();
-          if (name.endsWith(".fseq") || name.endsWith(".FSEQ")) {
-            JsonObject fileObj = files.createNestedObject();
-            fileObj["name"] = name;
-            fileObj["size"] = file.size();
-          }
-          file.close();
-          file = root.openNextFile();
-        }
-      } else {
-        doc["error"] = "Cannot open SD root directory";
-      }
-
-      String json;
-      serializeJson(doc, json);
-      request->send(200, "application/json", json);
+      FSEQFileIndex::sendList(
+          request, true, "{\"files\":[", "]}",
+          [](const FSEQFileIndex::Entry &entry, JsonObject obj) {
+            obj["name"] = entry.name;
+            obj["size"] = entry.size;
+          });
     });
 
     // Endpoint to start FSEQ playback
@@ -692,14 +468,20 @@ public:
       if (!filepath.startsWith("/")) {
         filepath = "/" + filepath;
       }
-      // Use FSEQPlayer to start playback
-      FSEQPlayer::loadRecording(filepath.c_str(), 0, strip.getLength());
+      // playback is started by loop(), see FSEQControlQueue
+      if (!FSEQControlQueue::pushStart(0, filepath.c_str(), 0,
+                                       strip.getLength(), false)) {
+        request->send(503, "text/plain", "FPP connect busy");
+        return;
+      }
       request->send(200, "text/plain", "FPP connect started: " + filepath);
     });
     // Endpoint to stop FSEQ playback
     server.on("/fpp/stop", HTTP_GET, [this](AsyncWebServerRequest *request) {
-      FSEQPlayer::clearLastPlayback();
-      realtimeLock(10, REALTIME_MODE_INACTIVE);
+      if (!FSEQControlQueue::pushStop(0)) {
+        request->send(503, "text/plain", "FPP connect busy");
+        return;
+      }
       request->send(200, "text/plain", "FPP connect stopped");
     });
 
@@ -708,7 +490,7 @@ public:
       if (udp.listenMulticast(multicastAddr, udpPort)) {
         udpStarted = true;
         udp.onPacket(
-            [this](AsyncUDPPacket packet) { processUdpPacket(packet); });
+            [this](AsyncUDPPacket &packet) { processUdpPacket(packet); });
         DEBUG_PRINTLN(F("[FPP] UDP listener started on multicast"));
       }
     }
@@ -720,23 +502,39 @@ public:
       if (udp.listenMulticast(multicastAddr, udpPort)) {
         udpStarted = true;
         udp.onPacket(
-            [this](AsyncUDPPacket packet) { processUdpPacket(packet); });
+            [this](AsyncUDPPacket &packet) { processUdpPacket(packet); });
         DEBUG_PRINTLN(F("[FPP] UDP listener started on multicast"));
       }
     }
-	
-    // if (udpStarted && WiFi.status() == WL_CONNECTED) {
-
-      // if (millis() - lastPingTime > pingInterval) {
-          // sendPingPacket();
-          // lastPingTime = millis();
-      // }
-    // }
+
+    // remote mode: show buffered DDP frames on the master's schedule
+    FSEQRemoteBuffer::handle();
+
+    // announce this node so FPP discovers it without pinging first
+    if (udpStarted && WiFi.status() == WL_CONNECTED &&
+        millis() - lastPingTime > pingInterval) {
+      sendPingPacket();
+      lastPingTime = millis();
+    }
   }
 
   uint16_t getId() override { return USERMOD_ID_FPP; }
-  void addToConfig(JsonObject &root) override {}
-  bool readFromConfig(JsonObject &root) override { return true; }
+  void addToConfig(JsonObject &root) override {
+    JsonObject top = root.createNestedObject(FPSTR(_name));
+    top["remoteDDP"] = FSEQRemoteBuffer::isEnabled();
+    top["remoteDelayMs"] = FSEQRemoteBuffer::getDelay();
+  }
+
+  // remote mode: buffer DDP frames and show them on the sync stream's clock
+  bool readFromConfig(JsonObject &root) override {
+    JsonObject top = root[FPSTR(_name)];
+    if (top.isNull())
+      return false;
+    FSEQRemoteBuffer::setEnabled(top["remoteDDP"] | false);
+    FSEQRemoteBuffer::setDelay(top["remoteDelayMs"] |
+                               FSEQ_REMOTE_DEFAULT_DELAY_MS);
+    return true;
+  }
 };
 
 inline const char UsermodFPP::_name[] PROGMEM = "FPP Connect";
@@ -52,7 +52,13 @@ inline SPIClass spiPort = SPI;
 #endif
 #endif
 
+#include "fseq_flash.h"
+#include "fseq_index.h"
+#include "fseq_manager.h"
 #include "fseq_player.h"
+#include "fseq_recorder.h"
+#include "fseq_sync.h"
+#include "fseq_upload.h"
 #include "sd_manager.h"
 #include "web_ui_manager.h"
 
@@ -61,6 +67,11 @@ class UsermodFseq : public Usermod {
 private:
   WebUIManager webUI;        // Web UI Manager module (handles endpoints)
   static const char _name[]; // for storing usermod name in config
+#ifdef WLED_USE_SD_SPI
+  // pins changed in the config, the card is remounted by loop()
+  bool remountPending = false;
+  int8_t mountedPins[4];     // cs, sck, miso, mosi the card is mounted with
+#endif
 
 public:
   // Setup function called once at startup
@@ -75,14 +86,37 @@ public:
       DEBUG_PRINTF("[%s] SD initialization successful.\n", FPSTR(_name));
     }
 
+    // before the endpoints that post to them
+    FSEQControlQueue::begin();
+    FSEQFileIndex::begin();
+    FSEQSequenceCache::begin();
+    FSEQFlashStore::begin();
     // Register web endpoints defined in WebUIManager
     webUI.registerEndpoints();
   }
 
   // Loop function called continuously
   void loop() {
-    // Process FSEQ playback (includes UDP sync commands)
-    FSEQPlayer::handlePlayRecording();
+#ifdef WLED_USE_SD_SPI
+    // nothing else touches the card until it is mounted again
+    if (remountPending) {
+      remountPending = !reinit_SD_SPI();
+      return;
+    }
+#endif
+    // start/stop from the web endpoints and FPP sync commands queued by the
+    // UDP task, then FSEQ playback
+    FSEQControlQueue::handle();
+    FSEQSyncQueue::handle();
+    FSEQPlayerManager::handle();
+    FSEQFlashStore::handleCopy();
+    // fill the next-sequence cache only with SD time playback does not need
+    if (FSEQPlayerManager::hasReadSlack()) {
+      // FPP seeks the primary player, its file gets the seek index
+      FSEQPlayerManager::primary().buildSeekIndex();
+      FSEQSequenceCache::handleWarmup(FSEQ_READ_BUDGET_US);
+      FSEQFileIndex::handle(FSEQ_READ_BUDGET_US);
+    }
   }
 
   // Unique ID for the usermod
@@ -103,13 +137,18 @@ public:
     arr.add(button);
   }
 
-  // Save your SPI pins to WLED config 
+  // Save playback channel window and SPI pins to WLED config
   void addToConfig(JsonObject &root) override {
 
-  #ifdef WLED_USE_SD_SPI
-
     JsonObject top = root.createNestedObject(FPSTR(_name));
 
+    // 1-based like the start channel in xLights/FPP, 0 = all channels
+    top["startChannel"] = FSEQPlayerManager::primary().getChannelOffset() + 1;
+    top["channelCount"] = FSEQPlayerManager::primary().getChannelLength();
+    top["cacheKB"] = FSEQSequenceCache::getBudget() / 1024;
+
+  #ifdef WLED_USE_SD_SPI
+
     top["csPin"]   = configPinSourceSelect;
     top["sckPin"]  = configPinSourceClock;
     top["misoPin"] = configPinPoci;
@@ -118,17 +157,27 @@ public:
   #endif
   }
   
-  // Read your SPI pins from WLED config JSON
+  // Read playback channel window and SPI pins from WLED config JSON
   bool readFromConfig(JsonObject &root) override {
-#ifdef WLED_USE_SD_SPI
     JsonObject top = root[FPSTR(_name)];
     if (top.isNull())
       return false;
-  
-    int8_t oldCs   = configPinSourceSelect;
-    int8_t oldSck  = configPinSourceClock;
-    int8_t oldMiso = configPinPoci;
-    int8_t oldMosi = configPinPico;
+
+    uint32_t startChannel = top["startChannel"] | 1;
+    uint32_t channelCount = top["channelCount"] | 0;
+    FSEQPlayerManager::setChannelWindow(
+        startChannel > 0 ? startChannel - 1 : 0, channelCount);
+    FSEQSequenceCache::setBudget((top["cacheKB"] | FSEQ_CACHE_DEFAULT_KB) *
+                                 1024);
+
+#ifdef WLED_USE_SD_SPI
+    // a remount still pending was queued with the pins in use
+    if (!remountPending) {
+      mountedPins[0] = configPinSourceSelect;
+      mountedPins[1] = configPinSourceClock;
+      mountedPins[2] = configPinPoci;
+      mountedPins[3] = configPinPico;
+    }
 
     if (top["csPin"].is<int>())
       configPinSourceSelect = top["csPin"].as<int>();
@@ -139,23 +188,39 @@ public:
     if (top["mosiPin"].is<int>())
       configPinPico = top["mosiPin"].as<int>();
 
-    reinit_SD_SPI(oldCs, oldSck, oldMiso, oldMosi); // reinitialize SD with new pins
-    return true;
-#else
-    return false;
+    // this runs in the web server task (or before setup()), files may be
+    // open on the card: loop() closes them and remounts it
+    if (mountedPins[0] != configPinSourceSelect ||
+        mountedPins[1] != configPinSourceClock ||
+        mountedPins[2] != configPinPoci || mountedPins[3] != configPinPico) {
+      SDManager::suspend(true);
+      remountPending = true;
+    }
 #endif
+    return true;
   }
 
 #ifdef WLED_USE_SD_SPI
-  // Reinitialize SD SPI with updated pins
-  void reinit_SD_SPI(int8_t oldCs, int8_t oldSck, int8_t oldMiso, int8_t oldMosi) {
-    // Deinit SD if needed
+  // Reinitialize SD SPI with updated pins, from loop(). Players, the
+  // sequence cache and the index scan are closed right away, a recording,
+  // an upload and a flash copy are stopped and finished by their tasks;
+  // false while one of them still has a file open.
+  bool reinit_SD_SPI() {
+    FSEQPlayerManager::stopAll();
+    FSEQSequenceCache::end();
+    FSEQFileIndex::reload(); // loaded again from the new mount
+    FSEQRecorder::stop();
+    FSEQUploadWriter::cancel();
+    if (!FSEQFlashStore::stopCopy() || FSEQRecorder::isBusy() ||
+        FSEQUploadWriter::isBusy())
+      return false;
+
     SD_ADAPTER.end();
     // Reallocate pins
-    PinManager::deallocatePin(oldCs, PinOwner::UM_SdCard);
-    PinManager::deallocatePin(oldSck, PinOwner::UM_SdCard);
-    PinManager::deallocatePin(oldMiso, PinOwner::UM_SdCard);
-    PinManager::deallocatePin(oldMosi, PinOwner::UM_SdCard);
+    for (int8_t &pin : mountedPins) {
+      PinManager::deallocatePin(pin, PinOwner::UM_SdCard);
+      pin = -1;
+    }
 
     PinManagerPinType pins[4] = {{configPinSourceSelect, true},
                                  {configPinSourceClock, true},
@@ -164,19 +229,27 @@ public:
                                    true }};
     if (!PinManager::allocateMultiplePins(pins, 4, PinOwner::UM_SdCard)) {
       DEBUG_PRINTF("[%s] SPI pin allocation failed!\n", FPSTR(_name));
-      return;
+      SDManager::suspend(false);
+      return true;
     }
+    mountedPins[0] = configPinSourceSelect;
+    mountedPins[1] = configPinSourceClock;
+    mountedPins[2] = configPinPoci;
+    mountedPins[3] = configPinPico;
 
     // Reinit SPI with new pins
     spiPort.begin(configPinSourceClock, configPinPoci, configPinPico,
                   configPinSourceSelect);
 
     // Try to begin SD again
-    if (!SD_ADAPTER.begin(configPinSourceSelect, spiPort)) {
+    if (!SD_ADAPTER.begin(configPinSourceSelect, spiPort, 4000000, "/sd",
+                          FSEQ_SD_MAX_FILES)) {
       DEBUG_PRINTF("[%s] SPI begin failed!\n", FPSTR(_name));
     } else {
       DEBUG_PRINTF("[%s] SD SPI reinitialized with new pins\n", FPSTR(_name));
     }
+    SDManager::suspend(false);
+    return true;
   }
 
   // Getter methods and static variables for SD pins
@@ -1,11 +1,22 @@
 #include "web_ui_manager.h"
+#include "fseq_cache.h"
+#include "fseq_flash.h"
+#include "fseq_index.h"
+#include "fseq_io.h"
+#include "fseq_manager.h"
+#include "fseq_metrics.h"
 #include "fseq_player.h"
+#include "fseq_recorder.h"
+#include "fseq_remote.h"
+#include "fseq_sync.h"
+#include "fseq_upload.h"
 #include "sd_manager.h"
 #include "usermod_fseq.h"
 
 struct UploadContext {
-  File* file;
+  bool busy;  // another upload is still being written
   bool error;
+  char path[FSEQ_CACHE_PATH_LEN]; // for the result of the writer
 };
 
 static const char PAGE_HTML[] PROGMEM = R"rawliteral(
@@ -302,6 +313,27 @@ function deleteFile(name){
 
 /* ---------------- UPLOAD ---------------- */
 
+function uploadDone(text){
+  statusText.innerText=text;
+  loadSDList();
+  loadFseqList();
+  setTimeout(()=>{
+    progressBar.style.width="0%";
+    statusText.innerText="";
+  },2000);
+}
+
+// the SD card may still be written after the request was answered
+function waitUpload(name){
+  fetch('/api/sd/upload/status?file='+encodeURIComponent(name))
+    .then(r=>r.json())
+    .then(s=>{
+      if(s.writing){setTimeout(()=>waitUpload(name),500);return;}
+      uploadDone(s.failed?"Upload failed":"Upload complete");
+    })
+    .catch(()=>uploadDone("Upload status unknown"));
+}
+
 function uploadFile(){
   let fileInput=document.getElementById("fileInput");
   if(!fileInput.files.length)return;
@@ -321,13 +353,12 @@ function uploadFile(){
   };
 
   xhr.onload=function(){
-    statusText.innerText="Upload complete";
-    loadSDList();
-    loadFseqList();
-    setTimeout(()=>{
-      progressBar.style.width="0%";
-      statusText.innerText="";
-    },2000);
+    if(xhr.status==202){
+      statusText.innerText="Writing...";
+      waitUpload(fileInput.files[0].name);
+      return;
+    }
+    uploadDone(xhr.status==200?"Upload complete":"Upload failed");
   };
 
   xhr.send(formData);
@@ -393,6 +424,93 @@ document.addEventListener("DOMContentLoaded",()=>{
 )rawliteral";
 
 
+// compression of the sequence at filepath, FSEQ_COMPRESSION_NONE if it cannot
+// be read (loop() reports that)
+static uint8_t compressionOf(const String &filepath) {
+  File file;
+  if (SD_ADAPTER.cardType() != CARD_NONE && SD_ADAPTER.exists(filepath))
+    file = SD_ADAPTER.open(filepath, "r");
+  else if (WLED_FS.exists(filepath))
+    file = WLED_FS.open(filepath, "r");
+  FSEQFileHeader header;
+  if (!file || !FSEQHeader::readFixed(file, header))
+    header.compression_type = FSEQ_COMPRESSION_NONE;
+  if (file)
+    file.close();
+  return header.compression_type;
+}
+
+// Start a file on the player given by the optional "player" argument
+// (default 0), bound to the optional "segment" (default main segment).
+// The sequence is opened by loop(), see FSEQControlQueue.
+static void startFromRequest(AsyncWebServerRequest *request, bool loop) {
+  if (!request->hasArg("file")) {
+    request->send(400, "text/plain", "Missing file param");
+    return;
+  }
+  long player = request->hasArg("player") ? request->arg("player").toInt() : 0;
+  if (!FSEQPlayerManager::get(player)) {
+    request->send(400, "text/plain", "Invalid player");
+    return;
+  }
+  uint16_t startLed = uint16_t(-1), stopLed = uint16_t(-1);
+  if (request->hasArg("segment")) {
+    int id = request->arg("segment").toInt();
+    if (id < 0 || id >= strip.getSegmentsNum()) {
+      request->send(400, "text/plain", "Invalid segment");
+      return;
+    }
+    Segment &seg = strip.getSegment(id);
+    startLed = seg.start;
+    stopLed = seg.stop;
+  }
+  String filepath = request->arg("file");
+  if (!filepath.startsWith("/"))
+    filepath = "/" + filepath;
+  // e.g. zstd without a zstd library in the build
+  uint8_t compression = compressionOf(filepath);
+  if (!FSEQBlockDecoder::isSupported(compression)) {
+    request->send(415, "text/plain",
+                  String("Unsupported compression: ") +
+                      FSEQHeader::compressionName(compression));
+    return;
+  }
+  if (!FSEQControlQueue::pushStart(player, filepath.c_str(), startLed, stopLed,
+                                  loop)) {
+    request->send(503, "text/plain", "FSEQ busy or path too long");
+    return;
+  }
+  request->send(200, "text/plain", loop ? "FSEQ loop started" : "FSEQ started");
+}
+
+// target of a resumable upload, from the file argument
+static String uploadPath(AsyncWebServerRequest *request) {
+  String filepath = request->arg("file");
+  if (!filepath.startsWith("/"))
+    filepath = "/" + filepath;
+  return filepath;
+}
+
+static void addPlayerStatus(JsonObject obj, FSEQPlayer &player) {
+  obj["playing"] = player.isPlaying();
+  obj["file"]    = player.getFileName();
+  obj["start"]   = player.getLedStart();
+  obj["stop"]    = player.getLedStop();
+  obj["source"]  = player.getSourceName();
+  obj["fps"]     = player.getFps();
+  obj["target_fps"] = player.getTargetFps();
+  obj["elapsed"]   = player.getElapsedSeconds();
+  obj["remaining"] = player.getRemainingSeconds();
+  obj["seek_anchors"] = player.getSeekAnchors();
+
+  const FSEQPlayer::TimingStats &timing = player.getTimingStats();
+  obj["jitter_us"]      = timing.jitterAvgUs;
+  obj["jitter_max_us"]  = timing.jitterMaxUs;
+  obj["dropped_frames"] = timing.droppedFrames;
+  obj["drift_ms"]       = timing.driftUs / 1000.0f;
+  obj["rate_ppm"]       = timing.ratePpm;
+}
+
 void WebUIManager::registerEndpoints() {
 
   // Main UI page (navigation, SD and FSEQ tabs)
@@ -400,90 +518,93 @@ void WebUIManager::registerEndpoints() {
     request->send_P(200, "text/html", PAGE_HTML);
   });
 
-	// API - List SD files (size in KB + storage info)
+	// API - List SD files (size in KB + storage info), paged by offset/limit
 	server.on("/api/sd/list", HTTP_GET, [](AsyncWebServerRequest *request) {
 
-	  File root = SD_ADAPTER.open("/");
-
 	  uint64_t totalBytes = SD_ADAPTER.totalBytes();
 	  uint64_t usedBytes  = SD_ADAPTER.usedBytes();
 
-	  // Adjust size if needed (depends on max file count)
-	  DynamicJsonDocument doc(8192);
-
-	  JsonObject rootObj = doc.to<JsonObject>();
-	  JsonArray files = rootObj.createNestedArray("files");
-
-	  if (root && root.isDirectory()) {
-
-		File file = root.openNextFile();
-		while (file) {
-			
-		  String name = file.name();
-
-		  JsonObject obj = files.createNestedObject();
-		  obj["name"] = name;
-		  obj["size"] = (float)file.size() / 1024.0;
-
-		  file.close();
-		  file = root.openNextFile();
-		}
-	  }
-
-	  root.close();
-
-	  rootObj["usedKB"]  = (float)usedBytes / 1024.0;
-	  rootObj["totalKB"] = (float)totalBytes / 1024.0;
-
-	  String output;
-	  serializeJson(doc, output);
-	  
-	  if (doc.overflowed()) {
-      request->send(507, "text/plain", "JSON buffer too small; file list may be truncated");
-      return;
-      }
-
-	  request->send(200, "application/json", output);
+	  String suffix = "],\"usedKB\":" + String((float)usedBytes / 1024.0) +
+	                  ",\"totalKB\":" + String((float)totalBytes / 1024.0) +
+	                  ",\"total\":" + String(FSEQFileIndex::getCount(false)) +
+	                  ",\"complete\":" +
+	                  (FSEQFileIndex::isComplete() ? "true" : "false") + "}";
+
+	  FSEQFileIndex::sendList(request, false, "{\"files\":[", suffix,
+		[](const FSEQFileIndex::Entry &entry, JsonObject obj) {
+		  obj["name"] = entry.name;
+		  obj["size"] = (float)entry.size / 1024.0;
+		  obj["mtime"] = entry.mtime;
+		});
 	});
 
 
-  // API - List FSEQ files
+  // API - List FSEQ files, paged by offset/limit
   server.on("/api/fseq/list", HTTP_GET, [](AsyncWebServerRequest *request) {
-
-	  File root = SD_ADAPTER.open("/");
-
-	  DynamicJsonDocument doc(4096);
-	  JsonArray files = doc.to<JsonArray>();
-
-	  if (root && root.isDirectory()) {
-
-		File file = root.openNextFile();
-		while (file) {
-
-		  String name = file.name();
-
-		  if (name.endsWith(".fseq") || name.endsWith(".FSEQ")) {
-			JsonObject obj = files.createNestedObject();
-			obj["name"] = name;
+	  FSEQFileIndex::sendList(request, true, "[", "]",
+		[](const FSEQFileIndex::Entry &entry, JsonObject obj) {
+		  obj["name"] = entry.name;
+		  obj["size"] = entry.size;
+		  obj["mtime"] = entry.mtime;
+		  if (!entry.stepTime)
+			return; // not a valid sequence
+		  obj["version"] = entry.majorVersion;
+		  obj["channels"] = entry.channelCount;
+		  obj["frames"] = entry.frameCount;
+		  obj["step_ms"] = entry.stepTime;
+		  obj["fps"] = 1000.0f / entry.stepTime;
+		  obj["duration"] = (float)entry.frameCount * entry.stepTime / 1000.0f;
+		  obj["compression"] =
+			  FSEQHeader::compressionName(entry.compressionType);
+		  if (entry.mediaFile[0])
+			obj["media"] = entry.mediaFile;
+		  if (entry.sparseRangeCount) {
+			JsonArray ranges = obj.createNestedArray("sparse_ranges");
+			uint8_t kept = min(entry.sparseRangeCount, (uint8_t)FSEQ_INDEX_RANGES);
+			for (uint8_t i = 0; i < kept; i++) {
+			  JsonArray range = ranges.createNestedArray();
+			  range.add(entry.ranges[i].start);
+			  range.add(entry.ranges[i].length);
+			}
+			obj["sparse_range_count"] = entry.sparseRangeCount;
 		  }
+		});
+	});
 
-		  file.close();
-		  file = root.openNextFile();
-		}
-	  }
-
-	  root.close();
+  // API - Rebuild the file index after files were copied onto the card
+  server.on("/api/sd/rescan", HTTP_POST, [](AsyncWebServerRequest *request) {
+    FSEQFileIndex::rescan();
+    request->send(200, "text/plain", "SD rescan started");
+  });
 
-	  String output;
-	  serializeJson(doc, output);
-	  
-	  if (doc.overflowed()) {
-	    request->send(507, "text/plain", "JSON buffer too small; file list may be truncated");
-	    return;
-	  }
+  // API - Resumable upload, one chunk per request (registered before
+  // /api/sd/upload, which would also match these paths)
+  server.on(
+      "/api/sd/upload/chunk", HTTP_POST,
+      [](AsyncWebServerRequest *request) {
+        if (!request->hasArg("file")) {
+          request->send(400, "text/plain", "Missing file param");
+          return;
+        }
+        FSEQUploadSession::sendChunkResult(request, uploadPath(request));
+      },
+      NULL,
+      [](AsyncWebServerRequest *request, uint8_t *data, size_t len,
+         size_t index, size_t total) {
+        if (request->hasArg("file"))
+          FSEQUploadSession::handleChunk(request, uploadPath(request), data,
+                                         len, index, total);
+      });
 
-	  request->send(200, "application/json", output);
-	});
+  // API - Resume query of an upload
+  server.on("/api/sd/upload/status", HTTP_GET,
+            [](AsyncWebServerRequest *request) {
+              if (!request->hasArg("file")) {
+                request->send(400, "text/plain", "Missing file param");
+                return;
+              }
+              FSEQUploadSession::sendStatus(request, uploadPath(request));
+            });
 
   // API - File Upload
 	server.on(
@@ -494,18 +615,22 @@ void WebUIManager::registerEndpoints() {
 
 		UploadContext* ctx = static_cast<UploadContext*>(request->_tempObject);
 
-		if (!ctx || ctx->error || !ctx->file || !*(ctx->file)) {
-		  request->send(500, "text/plain", "Failed to open file for writing");
+		if (ctx && ctx->busy) {
+		  request->send(409, "text/plain", "Another upload is in progress");
+		} else if (!ctx || ctx->error ||
+				   FSEQUploadWriter::getResult(ctx->path) ==
+					   FSEQUploadWriter::FAILED) {
+		  request->send(500, "text/plain", "Failed to write file");
+		} else if (FSEQUploadWriter::getResult(ctx->path) ==
+				   FSEQUploadWriter::WRITING) {
+		  // the writer task still closes the file, see /api/sd/upload/status
+		  request->send(202, "text/plain", "Upload received, writing");
 		} else {
 		  request->send(200, "text/plain", "Upload complete");
 		}
 
 		// Cleanup
 		if (ctx) {
-		  if (ctx->file) {
-			if (*(ctx->file)) ctx->file->close();
-			delete ctx->file;
-		  }
 		  delete ctx;
 		  request->_tempObject = nullptr;
 		}
@@ -522,26 +647,31 @@ void WebUIManager::registerEndpoints() {
 			filename = "/" + filename;
 
 		  ctx = new UploadContext();
-		  ctx->error = false;
-		  ctx->file = new File(SD_ADAPTER.open(filename.c_str(), FILE_WRITE));
-
-		  if (!*(ctx->file)) {
-			ctx->error = true;
-		  }
+		  ctx->busy = FSEQUploadWriter::isBusy();
+		  ctx->error = filename.length() >= sizeof(ctx->path);
+		  strlcpy(ctx->path, filename.c_str(), sizeof(ctx->path));
+		  if (!ctx->busy && !ctx->error)
+			ctx->error = !FSEQUploadWriter::begin(filename.c_str(), request);
 
 		  request->_tempObject = ctx;
 		}
 
 		ctx = static_cast<UploadContext*>(request->_tempObject);
 
-		if (!ctx || ctx->error || !ctx->file || !*(ctx->file))
+		if (!ctx || ctx->busy || ctx->error)
 		  return;
 
-		ctx->file->write(data, len);
-		
+		// queued for the writer task, SD latency does not stall the TCP task
+		if (!FSEQUploadWriter::write(data, len))
+		  ctx->error = true;
+		// a complete upload replaces the file, on error it is left as it was;
+		// the writer task finishes it without holding up this callback
+		if ((final || ctx->error) && !FSEQUploadWriter::end())
+		  ctx->error = true;
 	  }
 	);
 
+
   // API - File Delete
   server.on("/api/sd/delete", HTTP_POST, [](AsyncWebServerRequest *request) {
     if (!request->hasArg("path")) {
@@ -551,12 +681,26 @@ void WebUIManager::registerEndpoints() {
     String path = request->arg("path");
     if (!path.startsWith("/"))
       path = "/" + path;
+    FSEQSequenceCache::invalidate(path.c_str());
     bool res = SD_ADAPTER.remove(path.c_str());
+    if (res)
+      FSEQFileIndex::remove(path.c_str());
     request->send(200, "text/plain", res ? "File deleted" : "Delete failed");
   });
 
   // API - Start FSEQ (normal playback)
   server.on("/api/fseq/start", HTTP_POST, [](AsyncWebServerRequest *request) {
+    startFromRequest(request, false);
+  });
+
+  // API - Start FSEQ in loop mode
+  server.on(
+      "/api/fseq/startloop", HTTP_POST, [](AsyncWebServerRequest *request) {
+        startFromRequest(request, true);
+      });
+
+  // API - Cache the start of the sequence that is played next
+  server.on("/api/fseq/cache", HTTP_POST, [](AsyncWebServerRequest *request) {
     if (!request->hasArg("file")) {
       request->send(400, "text/plain", "Missing file param");
       return;
@@ -564,45 +708,163 @@ void WebUIManager::registerEndpoints() {
     String filepath = request->arg("file");
     if (!filepath.startsWith("/"))
       filepath = "/" + filepath;
-    FSEQPlayer::loadRecording(filepath.c_str(), 0, uint16_t(-1), 0.0f, false);
-    request->send(200, "text/plain", "FSEQ started");
+    if (!FSEQSequenceCache::warm(filepath.c_str())) {
+      request->send(409, "text/plain", "FSEQ cache disabled or busy");
+      return;
+    }
+    request->send(200, "text/plain", "FSEQ cache warming");
   });
 
-  // API - Start FSEQ in loop mode
-  server.on(
-      "/api/fseq/startloop", HTTP_POST, [](AsyncWebServerRequest *request) {
-        if (!request->hasArg("file")) {
-          request->send(400, "text/plain", "Missing file param");
-          return;
-        }
-        String filepath = request->arg("file");
-        if (!filepath.startsWith("/"))
-          filepath = "/" + filepath;
-        FSEQPlayer::loadRecording(filepath.c_str(), 0, uint16_t(-1), 0.0f, true);
-        request->send(200, "text/plain", "FSEQ loop started");
-      });
+  // API - Copy a sequence into the flash partition for playback from flash
+  server.on("/api/fseq/flash", HTTP_POST, [](AsyncWebServerRequest *request) {
+    if (!request->hasArg("file")) {
+      request->send(400, "text/plain", "Missing file param");
+      return;
+    }
+    if (!FSEQFlashStore::store(request->arg("file").c_str())) {
+      request->send(409, "text/plain", "No FSEQ flash partition or path too long");
+      return;
+    }
+    request->send(200, "text/plain", "FSEQ flash copy queued");
+  });
 
   // API - Stop FSEQ
   server.on("/api/fseq/stop", HTTP_POST, [](AsyncWebServerRequest *request) {
-    FSEQPlayer::clearLastPlayback();
-    if (realtimeOverride == REALTIME_OVERRIDE_ONCE)
-      realtimeOverride = REALTIME_OVERRIDE_NONE;
-    if (realtimeMode)
-      exitRealtime();
-    else {
-      realtimeMode = REALTIME_MODE_INACTIVE;
-      strip.trigger();
+    if (request->hasArg("player")) {
+      // stop a single player, the others keep running
+      long player = request->arg("player").toInt();
+      if (!FSEQPlayerManager::get(player)) {
+        request->send(400, "text/plain", "Invalid player");
+        return;
+      }
+      if (!FSEQControlQueue::pushStop(player)) {
+        request->send(503, "text/plain", "FSEQ busy");
+        return;
+      }
+      request->send(200, "text/plain", "FSEQ stopped");
+      return;
+    }
+    // also leaves realtime mode, see FSEQControlQueue::apply()
+    if (!FSEQControlQueue::pushStopAll()) {
+      request->send(503, "text/plain", "FSEQ busy");
+      return;
     }
     request->send(200, "text/plain", "FSEQ stopped");
   });
 
+  // API - Jump to a frame of the playing sequence (player 0 by default)
+  server.on("/api/fseq/seek", HTTP_POST, [](AsyncWebServerRequest *request) {
+    if (!request->hasArg("frame")) {
+      request->send(400, "text/plain", "Missing frame param");
+      return;
+    }
+    FSEQPlayer *player = FSEQPlayerManager::get(
+        request->hasArg("player") ? request->arg("player").toInt() : 0);
+    if (!player) {
+      request->send(400, "text/plain", "Invalid player");
+      return;
+    }
+    long frame = request->arg("frame").toInt();
+    if (frame < 0 || !player->requestSeek(frame)) {
+      request->send(409, "text/plain", "Not playing or frame out of range");
+      return;
+    }
+    request->send(200, "text/plain", "FSEQ seeking");
+  });
+
+  // API - Record live E1.31 / Art-Net / DDP input into a sequence
+  // (registered before /api/fseq/record, which also matches sub paths)
+  server.on("/api/fseq/record/start", HTTP_POST,
+            [](AsyncWebServerRequest *request) {
+              if (!request->hasArg("file")) {
+                request->send(400, "text/plain", "Missing file param");
+                return;
+              }
+              String filepath = request->arg("file");
+              if (!filepath.startsWith("/"))
+                filepath = "/" + filepath;
+              if (FSEQRecorder::isRecording()) {
+                request->send(409, "text/plain", "Already recording");
+                return;
+              }
+              if (!FSEQRecorder::start(filepath.c_str())) {
+                request->send(500, "text/plain", "Recording failed to start");
+                return;
+              }
+              request->send(200, "text/plain", "Recording " + filepath);
+            });
+
+  server.on("/api/fseq/record/stop", HTTP_POST,
+            [](AsyncWebServerRequest *request) {
+              if (!FSEQRecorder::isRecording()) {
+                request->send(409, "text/plain", "Not recording");
+                return;
+              }
+              // finishing until the writer task saved the file, clients
+              // poll /api/fseq/record for the result
+              FSEQRecorder::stop();
+              DynamicJsonDocument doc(512);
+              FSEQRecorder::toJSON(doc.to<JsonObject>());
+              String output;
+              serializeJson(doc, output);
+              request->send(202, "application/json", output);
+            });
+
+  server.on("/api/fseq/record", HTTP_GET, [](AsyncWebServerRequest *request) {
+    DynamicJsonDocument doc(512);
+    FSEQRecorder::toJSON(doc.to<JsonObject>());
+    String output;
+    serializeJson(doc, output);
+    request->send(200, "application/json", output);
+  });
+
+	// API - FSEQ playback performance counters
+	server.on("/api/fseq/metrics", HTTP_GET, [](AsyncWebServerRequest *request) {
+	  DynamicJsonDocument doc(1792);
+	  FSEQMetrics::toJSON(doc.to<JsonObject>());
+	  doc["upload_bytes_per_s"] = FSEQUploadWriter::getLastRate();
+	  doc["sync_dropped"] = FSEQSyncQueue::getDropped();
+	  FSEQIOArbiter::toJSON(doc.createNestedObject("sd_arbiter"));
+	  FSEQRemoteBuffer::toJSON(doc.createNestedObject("remote"));
+	  String output;
+	  serializeJson(doc, output);
+	  request->send(200, "application/json", output);
+	});
+
+	server.on(
+	    "/api/fseq/metrics/reset", HTTP_POST,
+	    [](AsyncWebServerRequest *request) {
+	      FSEQMetrics::reset();
+	      request->send(200, "text/plain", "FSEQ metrics reset");
+	    });
+
 	// API - FSEQ Status
 	server.on("/api/fseq/status", HTTP_GET, [](AsyncWebServerRequest *request) {
 
-	  DynamicJsonDocument doc(512);
-
-	  doc["playing"] = FSEQPlayer::isPlaying();
-	  doc["file"]    = FSEQPlayer::getFileName();
+	  DynamicJsonDocument doc(512 + 416 * FSEQ_MAX_PLAYERS);
+
+	  // top level fields describe player 0 (FPP controlled)
+	  JsonObject root = doc.to<JsonObject>();
+	  addPlayerStatus(root, FSEQPlayerManager::primary());
+
+	  JsonArray players = doc.createNestedArray("players");
+	  for (uint8_t i = 0; i < FSEQPlayerManager::count(); i++)
+		addPlayerStatus(players.createNestedObject(), *FSEQPlayerManager::get(i));
+
+	  JsonObject cache = doc.createNestedObject("cache");
+	  cache["file"]   = FSEQSequenceCache::getFileName();
+	  cache["bytes"]  = FSEQSequenceCache::getCachedBytes();
+	  cache["ready"]  = FSEQSequenceCache::isReady();
+	  cache["hits"]   = FSEQSequenceCache::getHits();
+	  cache["misses"] = FSEQSequenceCache::getMisses();
+
+	  if (FSEQFlashStore::isAvailable()) {
+		JsonObject flash = doc.createNestedObject("flash");
+		flash["file"]     = FSEQFlashStore::getFileName();
+		flash["size"]     = FSEQFlashStore::getFileSize();
+		flash["copying"]  = FSEQFlashStore::isCopying();
+		flash["progress"] = FSEQFlashStore::getCopyProgress();
+	  }
 
 	  String output;
 	  serializeJson(doc, output);
@@ -487,6 +487,20 @@ class Segment {
         bool    _manualW  : 1;
       };
     };
+    mutable bool _dirty;              // pixels changed since the segment was last blended into the frame (see WS2812FX::show())
+    // parameters the segment was last blended with, any change requires composing the whole frame again
+    struct BlendState {
+      uint16_t start, stop, startY, stopY, offset;
+      uint16_t options;               // only options that move pixels (reverse, mirror, transpose)
+      uint8_t  grouping, spacing, opacity, cct, blendMode;
+      bool     transition;
+      uint8_t  index;                 // position in segment list, 255 if not blended
+      bool operator==(const BlendState &o) const {
+        return start == o.start && stop == o.stop && startY == o.startY && stopY == o.stopY && offset == o.offset && options == o.options
+            && grouping == o.grouping && spacing == o.spacing && opacity == o.opacity && cct == o.cct && blendMode == o.blendMode
+            && transition == o.transition && index == o.index;
+      }
+    } _blendState;
 
     // static variables are use to speed up effect calculations by stashing common pre-calculated values
     static unsigned      _usedSegmentData;    // amount of data used by all segments
@@ -539,11 +553,11 @@ class Segment {
 
     inline static void     addUsedSegmentData(int len)     { Segment::_usedSegmentData += len; }
 
-    inline uint32_t *getPixels() const                              { return pixels; }
-    inline void     setPixelColorRaw(unsigned i, uint32_t c) const  { pixels[i] = c; }
+    inline uint32_t *getPixels() const                              { _dirty = true; return pixels; } // caller may write to the buffer
+    inline void     setPixelColorRaw(unsigned i, uint32_t c) const  { if (pixels[i] != c) { pixels[i] = c; _dirty = true; } }
     inline uint32_t getPixelColorRaw(unsigned i) const              { return pixels[i]; };
   #ifndef WLED_DISABLE_2D
-    inline void     setPixelColorXYRaw(unsigned x, unsigned y, uint32_t c) const  { auto XY = [](unsigned X, unsigned Y){ return X + Y*Segment::vWidth(); }; pixels[XY(x,y)] = c; }
+    inline void     setPixelColorXYRaw(unsigned x, unsigned y, uint32_t c) const  { auto XY = [](unsigned X, unsigned Y){ return X + Y*Segment::vWidth(); }; setPixelColorRaw(XY(x,y), c); }
     inline uint32_t getPixelColorXYRaw(unsigned x, unsigned y) const              { auto XY = [](unsigned X, unsigned Y){ return X + Y*Segment::vWidth(); }; return pixels[XY(x,y)]; };
   #endif
     void resetIfRequired();         // sets all SEGENV variables to 0 and clears data buffer
@@ -599,6 +613,8 @@ class Segment {
     , _dataLen(0)
     , _default_palette(6)
     , _capabilities(0)
+    , _dirty(true)
+    , _blendState{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, false, 255}
     , _t(nullptr)
     {
       DEBUGFX_PRINTF_P(PSTR("-- Creating segment: %p [%d,%d:%d,%d]\n"), this, (int)start, (int)stop, (int)startY, (int)stopY);
@@ -858,6 +874,10 @@ class WS2812FX {
       _isOffRefreshRequired(false),
       _hasWhiteChannel(false),
       _triggered(false),
+      _pixelCCTUsed(false),
+      _segmentCCT(false),
+      _compositeValid(false),
+      _compositeSegments(0),
       _segment_index(0),
       _mainSegment(0),
       _modeCount(MODE_COUNT),
@@ -875,7 +895,7 @@ class WS2812FX {
 
     ~WS2812FX() {
       p_free(_pixels);
-      p_free(_pixelCCT); // just in case
+      p_free(_pixelCCT);
       d_free(customMappingTable);
       _mode.clear();
       _modeData.clear();
@@ -906,7 +926,8 @@ class WS2812FX {
       waitForIt();                                // wait until frame is over (service() has finished or time for 1 frame has passed)
 
     void setRealtimePixelColor(unsigned i, uint32_t c);
-    inline void setPixelColor(unsigned n, uint32_t c) const   { if (n < getLengthTotal()) _pixels[n] = c; }  // paints absolute strip pixel with index n and color c
+    void setRealtimePixels(unsigned i, const uint8_t *data, unsigned count, unsigned bytesPerPixel = 3); // paints count RGB(W) byte triplets (quads) starting at pixel i
+    inline void setPixelColor(unsigned n, uint32_t c) const   { if (n < getLengthTotal()) { _pixels[n] = c; _compositeValid = false; } }  // paints absolute strip pixel with index n and color c
     inline void resetTimebase()                               { timebase = 0UL - millis(); }
     inline void setPixelColor(unsigned n, uint8_t r, uint8_t g, uint8_t b, uint8_t w = 0) const
                                                               { setPixelColor(n, RGBW32(r,g,b,w)); }
@@ -926,6 +947,8 @@ class WS2812FX {
     bool checkSegmentAlignment() const;
     bool hasRGBWBus() const;
     bool hasCCTBus() const;
+    // segment CCT is used by CCT buses or for white balance correction, and not replaced by CCT from RGB
+    inline bool usesSegmentCCT() const { return (hasCCTBus() || correctWB) && !cctFromRgb; }
     bool deserializeMap(unsigned n = 0);
 
     inline bool isUpdating() const           { return !BusManager::canAllShow(); } // return true if the strip is being sent pixel updates
@@ -1043,7 +1066,11 @@ class WS2812FX {
       bool _isOffRefreshRequired : 1; //periodic refresh is required for the strip to remain off.
       bool _hasWhiteChannel      : 1;
       bool _triggered            : 1;
+      bool _pixelCCTUsed         : 1; // segments differ in CCT, _pixelCCT is filled while blending
+      bool _segmentCCT           : 1; // segment CCT reaches the LEDs, see usesSegmentCCT()
+      mutable bool _compositeValid : 1; // _pixels hold the blended segments of the last frame and nothing else
     };
+    uint8_t _compositeSegments;         // number of segments blended into the last frame
 
     uint8_t _segment_index;
     uint8_t _mainSegment;
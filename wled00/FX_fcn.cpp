@@ -11,6 +11,8 @@
 */
 #include "wled.h"
 #include "FXparticleSystem.h"  // TODO: better define the required function (mem service) in FX.h?
+#include "blend_modes.h"
+#include "pixel_runs.h"
 
 /*
   Custom per-LED mapping has moved!
@@ -64,6 +66,8 @@ Segment::Segment(const Segment &orig) {
   data = nullptr;
   _dataLen = 0;
   pixels = nullptr;
+  _dirty = true;
+  _blendState.index = 255; // not part of the frame composite
   if (!stop) return;  // nothing to do if segment is inactive/invalid
   if (orig.pixels) {
     // allocate pixel buffer: prefer IRAM/PSRAM
@@ -106,6 +110,8 @@ Segment& Segment::operator= (const Segment &orig) {
     // erase pointers to allocated data
     data = nullptr;
     _dataLen = 0;
+    _dirty = true;
+    _blendState.index = 255; // segment replaced, frame needs to be composed again
     if (!stop) return *this;  // nothing to do if segment is inactive/invalid
     // copy source data
     if (orig.pixels) {
@@ -135,6 +141,8 @@ Segment& Segment::operator= (Segment &&orig) noexcept {
     p_free(pixels);   // free old pixel buffer
     // move source data
     memcpy((void*)this, (void*)&orig, sizeof(Segment));
+    _dirty = true;
+    _blendState.index = 255; // segment replaced, frame needs to be composed again
     orig.name = nullptr;
     orig.data = nullptr;
     orig._dataLen = 0;
@@ -217,6 +225,7 @@ void Segment::resetIfRequired() {
     DEBUG_PRINTF_P(PSTR("-- Segment %p reset, data cleared\n"), this);
   }
   if (pixels) for (size_t i = 0; i < length(); i++) pixels[i] = BLACK; // clear pixel buffer
+  _dirty = true;
   step = 0; call = 0; aux0 = 0; aux1 = 0;
   reset = false;
   #ifdef WLED_ENABLE_GIF
@@ -1261,6 +1270,16 @@ void WS2812FX::finalizeInit() {
   // use PSRAM if available: there is no measurable perfomance impact between PSRAM and DRAM on S2/S3 with QSPI PSRAM for this buffer
   _pixels = static_cast<uint32_t*>(allocate_buffer(getLengthTotal() * sizeof(uint32_t), BFRALLOC_ENFORCE_PSRAM | BFRALLOC_NOBYTEACCESS | BFRALLOC_CLEAR));
   DEBUG_PRINTF_P(PSTR("strip buffer size: %uB\n"), getLengthTotal() * sizeof(uint32_t));
+  _compositeValid = false;
+  // WARNING: as WLED doesn't handle CCT on pixel level but on Segment level instead
+  // we need to keep track of each pixel's CCT when blending segments (if CCT is present)
+  // and then set appropriate CCT from that pixel during paint (see show())
+  p_free(_pixelCCT);
+  _pixelCCT = nullptr;
+  _pixelCCTUsed = false;
+  _segmentCCT = usesSegmentCCT();
+  if (_segmentCCT)
+    _pixelCCT = static_cast<uint8_t*>(allocate_buffer(getLengthTotal() * sizeof(uint8_t), BFRALLOC_PREFER_PSRAM)); // prefer PSRAM
   DEBUG_PRINTF_P(PSTR("Heap after strip init: %uB\n"), getFreeHeapSize());
 }
 
@@ -1336,45 +1355,10 @@ void WS2812FX::service() {
   _isServicing = false;
 }
 
-// https://en.wikipedia.org/wiki/Blend_modes but using a for top layer & b for bottom layer
-static uint8_t _top       (uint8_t a, uint8_t b) { return a; }
-static uint8_t _bottom    (uint8_t a, uint8_t b) { return b; }
-static uint8_t _add       (uint8_t a, uint8_t b) { unsigned t = a + b; return t > 255 ? 255 : t; }
-static uint8_t _subtract  (uint8_t a, uint8_t b) { return b > a ? (b - a) : 0; }
-static uint8_t _difference(uint8_t a, uint8_t b) { return b > a ? (b - a) : (a - b); }
-static uint8_t _average   (uint8_t a, uint8_t b) { return (a + b) >> 1; }
-#if defined(ESP8266) || defined(CONFIG_IDF_TARGET_ESP32C3)
-static uint8_t _multiply  (uint8_t a, uint8_t b) { return ((a * b) + 255) >> 8; } // faster than division on C3 but slightly less accurate
-#else
-static uint8_t _multiply  (uint8_t a, uint8_t b) { return (a * b) / 255; } // origianl uses a & b in range [0,1]
-#endif
-static uint8_t _divide    (uint8_t a, uint8_t b) { return a > b ? (b * 255) / a : 255; }
-static uint8_t _lighten   (uint8_t a, uint8_t b) { return a > b ? a : b; }
-static uint8_t _darken    (uint8_t a, uint8_t b) { return a < b ? a : b; }
-static uint8_t _screen    (uint8_t a, uint8_t b) { return 255 - _multiply(~a,~b); } // 255 - (255-a)*(255-b)/255
-static uint8_t _overlay   (uint8_t a, uint8_t b) { return b < 128 ? 2 * _multiply(a,b) : (255 - 2 * _multiply(~a,~b)); }
-static uint8_t _hardlight (uint8_t a, uint8_t b) { return a < 128 ? 2 * _multiply(a,b) : (255 - 2 * _multiply(~a,~b)); }
-#if defined(ESP8266) || defined(CONFIG_IDF_TARGET_ESP32C3)
-static uint8_t _softlight (uint8_t a, uint8_t b) { return (((b * b * (255 - 2 * a))) + ((2 * a * b + 256) << 8)) >> 16; } // Pegtop's formula (1 - 2a)b^2
-#else
-static uint8_t _softlight (uint8_t a, uint8_t b) { return (b * b * (255 - 2 * a) + 255 * 2 * a * b) / (255 * 255); } // Pegtop's formula (1 - 2a)b^2 + 2ab
-#endif
-static uint8_t _dodge     (uint8_t a, uint8_t b) { return _divide(~a,b); }
-static uint8_t _burn      (uint8_t a, uint8_t b) { return ~_divide(a,~b); }
-
 void WS2812FX::blendSegment(const Segment &topSegment) const {
 
-  typedef uint8_t(*FuncType)(uint8_t, uint8_t);
-  FuncType funcs[] = {
-    _top, _bottom,
-    _add, _subtract, _difference, _average,
-    _multiply, _divide, _lighten, _darken, _screen, _overlay,
-    _hardlight, _softlight, _dodge, _burn
-  };
-
-  const size_t blendMode = topSegment.blendMode < (sizeof(funcs) / sizeof(FuncType)) ? topSegment.blendMode : 0;
-  const auto func  = funcs[blendMode]; // blendMode % (sizeof(funcs) / sizeof(FuncType))
-  const auto blend = [&](uint32_t top, uint32_t bottom){ return RGBW32(func(R(top),R(bottom)), func(G(top),G(bottom)), func(B(top),B(bottom)), func(W(top),W(bottom))); };
+  const size_t blendMode = topSegment.blendMode < (sizeof(blendFuncs) / sizeof(BlendFunc)) ? topSegment.blendMode : 0;
+  const BlendFunc blend  = blendFuncs[blendMode];
 
   const int     length     = topSegment.length();     // physical segment length (counts all pixels in 2D segment)
   const int     width      = topSegment.width();
@@ -1387,10 +1371,37 @@ void WS2812FX::blendSegment(const Segment &topSegment) const {
   const unsigned progInv   = 0xFFFFU - progress;
   uint8_t       opacity    = topSegment.currentBri(); // returns transitioned opacity for style FADE
   uint8_t       cct        = topSegment.currentCCT();
+  uint8_t      *pixelCCT   = _pixelCCTUsed ? _pixelCCT : nullptr; // all segments share one CCT otherwise (see show())
   if (gammaCorrectCol) opacity = gamma8inv(opacity); // use inverse gamma on brightness for correct color scaling after gamma correction (see #5343 for details)
 
   Segment::setClippingRect(0, 0);             // disable clipping by default
 
+  // segments that are not in transition and map 1:1 onto the frame (no grouping, spacing, mirroring, transposing or offset)
+  // are blended a row at a time; everything else goes pixel by pixel below
+  if (!topSegment.isInTransition() && (blendingStyle == BLEND_STYLE_FADE || bri == briT) && topSegment.groupLength() == 1
+    && !topSegment.mirror && !topSegment.mirror_y && !topSegment.transpose && topSegment.offset == 0) {
+    const BlendRowFunc blendRow = blendRowFuncs[blendMode];
+    const uint32_t *segPixels = topSegment.pixels;
+    if (isMatrix && stopIndx <= matrixSize) {
+#ifndef WLED_DISABLE_2D
+      const int nCols = topSegment.virtualWidth();
+      const int nRows = topSegment.virtualHeight();
+      const int step  = topSegment.reverse ? -1 : 1;
+      for (int r = 0; r < nRows; r++) {
+        const int y = topSegment.reverse_y ? nRows - r - 1 : r;
+        const size_t indx = XY(topSegment.start, topSegment.startY + y);
+        blendRow(&_pixels[indx], segPixels + r*nCols + (topSegment.reverse ? nCols - 1 : 0), step, nCols, opacity);
+        if (pixelCCT) memset(&pixelCCT[indx], cct, nCols);
+      }
+#endif
+    } else {
+      const int nLen = topSegment.virtualLength();
+      blendRow(&_pixels[topSegment.start], segPixels + (topSegment.reverse ? nLen - 1 : 0), topSegment.reverse ? -1 : 1, nLen, opacity);
+      if (pixelCCT) memset(&pixelCCT[topSegment.start], cct, nLen);
+    }
+    return;
+  }
+
   const unsigned dw = (blendingStyle==BLEND_STYLE_OUTSIDE_IN ? progInv : progress) * width / 0xFFFFU + 1;
   const unsigned dh = (blendingStyle==BLEND_STYLE_OUTSIDE_IN ? progInv : progress) * height / 0xFFFFU + 1;
   const unsigned orgBS = blendingStyle;
@@ -1460,7 +1471,7 @@ void WS2812FX::blendSegment(const Segment &topSegment) const {
       const int baseY = topSegment.startY + y;
       size_t indx = XY(baseX, baseY); // absolute address on strip
       _pixels[indx] = color_blend(_pixels[indx], blend(c, _pixels[indx]), o);
-      if (_pixelCCT) _pixelCCT[indx] = cct;
+      if (pixelCCT) pixelCCT[indx] = cct;
       // Apply mirroring
       if (topSegment.mirror || topSegment.mirror_y) {
         const int mirrorX = topSegment.start  + width  - x - 1;
@@ -1471,10 +1482,10 @@ void WS2812FX::blendSegment(const Segment &topSegment) const {
         if (topSegment.mirror)                        _pixels[idxMX] = color_blend(_pixels[idxMX], blend(c, _pixels[idxMX]), o);
         if (topSegment.mirror_y)                      _pixels[idxMY] = color_blend(_pixels[idxMY], blend(c, _pixels[idxMY]), o);
         if (topSegment.mirror && topSegment.mirror_y) _pixels[idxMM] = color_blend(_pixels[idxMM], blend(c, _pixels[idxMM]), o);
-        if (_pixelCCT) {
-          if (topSegment.mirror)                        _pixelCCT[idxMX] = cct;
-          if (topSegment.mirror_y)                      _pixelCCT[idxMY] = cct;
-          if (topSegment.mirror && topSegment.mirror_y) _pixelCCT[idxMM] = cct;
+        if (pixelCCT) {
+          if (topSegment.mirror)                        pixelCCT[idxMX] = cct;
+          if (topSegment.mirror_y)                      pixelCCT[idxMY] = cct;
+          if (topSegment.mirror && topSegment.mirror_y) pixelCCT[idxMM] = cct;
         }
       }
     };
@@ -1550,12 +1561,12 @@ void WS2812FX::blendSegment(const Segment &topSegment) const {
         indxM += topSegment.offset; // offset/phase
         if (indxM >= topSegment.stop) indxM -= length; // wrap
         _pixels[indxM] = color_blend(_pixels[indxM], blend(c, _pixels[indxM]), o);
-        if (_pixelCCT) _pixelCCT[indxM] = cct;
+        if (pixelCCT) pixelCCT[indxM] = cct;
       }
       indx += topSegment.offset; // offset/phase
       if (indx >= topSegment.stop) indx -= length; // wrap
       _pixels[indx] = color_blend(_pixels[indx], blend(c, _pixels[indx]), o);
-      if (_pixelCCT) _pixelCCT[indx] = cct;
+      if (pixelCCT) pixelCCT[indx] = cct;
     };
 
     // if we blend using "push" style we need to "shift" canvas to left/right/
@@ -1610,21 +1621,91 @@ void WS2812FX::show() {
   size_t diff = showNow - _lastShow;
 
   size_t totalLen = getLengthTotal();
-  // WARNING: as WLED doesn't handle CCT on pixel level but on Segment level instead
-  // we need to keep track of each pixel's CCT when blending segments (if CCT is present)
-  // and then set appropriate CCT from that pixel during paint (see below).
-  if ((hasCCTBus() || correctWB) && !cctFromRgb)
-    _pixelCCT = static_cast<uint8_t*>(allocate_buffer(totalLen * sizeof(uint8_t), BFRALLOC_PREFER_PSRAM)); // allocate CCT buffer if necessary, prefer PSRAM
-  if (_pixelCCT) memset(_pixelCCT, 127, totalLen); // set neutral (50:50) CCT
-
-  if (realtimeMode == REALTIME_MODE_INACTIVE || useMainSegmentOnly || realtimeOverride > REALTIME_OVERRIDE_NONE) {
-    // clear frame buffer
-    for (size_t i = 0; i < totalLen; i++) _pixels[i] = BLACK; // memset(_pixels, 0, sizeof(uint32_t) * getLengthTotal());
-    // blend all segments into (cleared) buffer
-    for (Segment &seg : _segments) if (seg.isActive() && (seg.on || seg.isInTransition())) {
-      blendSegment(seg);              // blend segment's buffer into frame buffer
+  const bool blendSegments = realtimeMode == REALTIME_MODE_INACTIVE || useMainSegmentOnly || realtimeOverride > REALTIME_OVERRIDE_NONE;
+
+  // correctWB and cctFromRgb are changed by the settings without finalizeInit() (see set.cpp, cfg.cpp),
+  // the CCT plane is allocated or freed when they decide differently whether segment CCT is used
+  const bool segmentCCT = usesSegmentCCT();
+  if (segmentCCT != _segmentCCT) {
+    _segmentCCT = segmentCCT;
+    p_free(_pixelCCT);
+    _pixelCCT = segmentCCT ? static_cast<uint8_t*>(allocate_buffer(totalLen * sizeof(uint8_t), BFRALLOC_PREFER_PSRAM)) : nullptr;
+  }
+
+  // the CCT plane is only filled when the blended segments differ in CCT, otherwise the whole frame uses one
+  // CCT (pixels not covered by any segment are black)
+  uint8_t frameCCT = 127; // neutral (50:50) CCT
+  bool pixelCCTUsed = false;
+  if (segmentCCT && blendSegments) {
+    bool first = true;
+    for (const Segment &seg : _segments) if (seg.isActive() && (seg.on || seg.isInTransition())) {
+      const uint8_t cct = seg.currentCCT();
+      if (first) frameCCT = cct;
+      else if (cct != frameCCT && _pixelCCT) pixelCCTUsed = true;
+      first = false;
     }
   }
+  const bool cctPlaneChanged = pixelCCTUsed != _pixelCCTUsed;
+  _pixelCCTUsed = pixelCCTUsed;
+  const uint8_t *pixelCCT = _pixelCCTUsed ? _pixelCCT : nullptr;
+
+  if (blendSegments) {
+    // _pixels still hold the previous frame: only segments whose pixels changed (see Segment::setPixelColorRaw()) or
+    // that are in transition are blended again, into their (cleared) area; the whole frame is composed again if
+    // something else drew into it, a segment was added, removed or changed how it is blended, or if a changed
+    // segment overlaps another one
+    bool compose = !_compositeValid || cctPlaneChanged || (blendingStyle != BLEND_STYLE_FADE && bri != briT); // see blendSegment()
+    unsigned blended = 0;
+    for (size_t i = 0; i < _segments.size(); i++) {
+      Segment &seg = _segments[i];
+      Segment::BlendState state = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, false, 255};
+      if (seg.isActive() && (seg.on || seg.isInTransition())) {
+        uint8_t opacity = seg.currentBri();
+        if (gammaCorrectCol) opacity = gamma8inv(opacity); // as in blendSegment()
+        state = {seg.start, seg.stop, seg.startY, seg.stopY, seg.offset, uint16_t(seg.options & (REVERSE | MIRROR | REVERSE_Y_2D | MIRROR_Y_2D | TRANSPOSED)),
+                 seg.grouping, seg.spacing, opacity, seg.currentCCT(), seg.blendMode, seg.isInTransition(), uint8_t(i)};
+        blended++;
+      }
+      if (!(state == seg._blendState)) compose = true;
+      seg._blendState = state;
+    }
+    if (blended != _compositeSegments) compose = true; // segment removed
+    _compositeSegments = blended;
+
+    const auto isChanged = [](const Segment &seg) { return seg._blendState.index != 255 && (seg._dirty || seg.isInTransition()); };
+    for (const Segment &seg : _segments) if (!compose && isChanged(seg)) {
+      for (const Segment &other : _segments) if (&other != &seg && other._blendState.index != 255
+          && seg.start < other.stop && other.start < seg.stop && seg.startY < other.stopY && other.startY < seg.stopY) {
+        compose = true;
+        break;
+      }
+    }
+
+    if (compose) {
+      // clear frame buffer
+      for (size_t i = 0; i < totalLen; i++) _pixels[i] = BLACK; // memset(_pixels, 0, sizeof(uint32_t) * getLengthTotal());
+      if (_pixelCCTUsed) memset(_pixelCCT, 127, totalLen); // set neutral (50:50) CCT
+      // blend all segments into (cleared) buffer
+      for (Segment &seg : _segments) if (seg._blendState.index != 255) {
+        blendSegment(seg);              // blend segment's buffer into frame buffer
+        seg._dirty = false;
+      }
+    } else {
+      for (Segment &seg : _segments) if (isChanged(seg)) {
+        // a segment only draws within its bounds (2D rows, or a run of 1D strip pixels with startY 0)
+        for (unsigned y = seg.startY; y < seg.stopY; y++) {
+          const size_t indx = seg.start + y * Segment::maxWidth;
+          for (size_t i = indx; i < indx + seg.width(); i++) _pixels[i] = BLACK;
+          if (_pixelCCTUsed) memset(&_pixelCCT[indx], 127, seg.width());
+        }
+        blendSegment(seg);
+        seg._dirty = false;
+      }
+    }
+    _compositeValid = true;
+  } else {
+    _compositeValid = false; // realtime data is written to _pixels directly
+  }
 
   // avoid race condition, capture _callback value
   show_callback callback = _callback;
@@ -1634,22 +1715,45 @@ void WS2812FX::show() {
   int oldCCT = Bus::getCCT(); // store original CCT value (since it is global)
   // when cctFromRgb is true we implicitly calculate WW and CW from RGB values (cct==-1)
   if (cctFromRgb) BusManager::setSegmentCCT(-1);
-  for (size_t i = 0; i < totalLen; i++) {
-    // when correctWB is true setSegmentCCT() will convert CCT into K with which we can then
-    // correct/adjust RGB value according to desired CCT value, it will still affect actual WW/CW ratio
-    if (_pixelCCT) { // cctFromRgb already exluded at allocation
-      if (i == 0 || _pixelCCT[i-1] != _pixelCCT[i]) BusManager::setSegmentCCT(_pixelCCT[i], correctWB);
+  // pixels are handed to the buses in runs that are consecutive after mapping (ascending, or descending as in
+  // serpentine rows) and share one CCT, so the bus lookup and virtual call happen per run instead of per pixel
+  constexpr unsigned maxRun = 64;
+  uint32_t run[maxRun]; // need a copy, do not modify _pixels directly (no byte access allowed on ESP32)
+  const bool applyGamma = !(realtimeMode && arlsDisableGammaCorrection);
+  if (segmentCCT && !pixelCCT) BusManager::setSegmentCCT(frameCCT, correctWB); // one CCT for the whole frame
+  // with ABL the buses first only sum the frame up to estimate current, the resulting brightness limit is then
+  // applied when the frame is written (the bus buffers are never read back and repainted); the estimate takes the
+  // gamma corrected pixels in logical order without building runs, skips black ones, and white balance and
+  // brightness are applied to the channel sums of each bus (see BusDigital::foldColorSum()) instead of to each pixel
+  if (BusManager::usesABL()) {
+    for (size_t i = 0; i < totalLen; i++) {
+      if (pixelCCT && (i == 0 || pixelCCT[i-1] != pixelCCT[i])) {
+        BusManager::foldColorSums(); // sums so far use the previous CCT
+        BusManager::setSegmentCCT(pixelCCT[i], correctWB);
+      }
+      uint32_t c = _pixels[i];
+      if (c == 0) continue; // standby current is added per LED in estimateCurrent()
+      if (applyGamma) c = gamma32(c);
+      BusManager::sumPixel(getMappedPixelIndex(i), c);
     }
-
-    uint32_t c = _pixels[i]; // need a copy, do not modify _pixels directly (no byte access allowed on ESP32)
-    if(c > 0 && !(realtimeMode && arlsDisableGammaCorrection))
-        c = gamma32(c); // apply gamma correction if enabled note: applying gamma after brightness has too much color loss
-    BusManager::setPixelColor(getMappedPixelIndex(i), c);
-  }
-  Bus::setCCT(oldCCT);  // restore old CCT for ABL adjustments
-
-  p_free(_pixelCCT);
-  _pixelCCT = nullptr;
+    BusManager::applyABL(); // updates _gMilliAmpsUsed
+  }
+  forEachPixelRun(totalLen, maxRun, [this](size_t i) { return getMappedPixelIndex(i); },
+    [pixelCCT](size_t i) { return pixelCCT && pixelCCT[i-1] != pixelCCT[i]; },
+    [&](size_t i, unsigned first, unsigned len, int dir) {
+      // when correctWB is true setSegmentCCT() will convert CCT into K with which we can then
+      // correct/adjust RGB value according to desired CCT value, it will still affect actual WW/CW ratio
+      if (pixelCCT && (i == 0 || pixelCCT[i-1] != pixelCCT[i])) BusManager::setSegmentCCT(pixelCCT[i], correctWB);
+      for (unsigned n = 0; n < len; n++) {
+        uint32_t c = _pixels[i + n];
+        if (c > 0 && applyGamma)
+          c = gamma32(c); // apply gamma correction if enabled note: applying gamma after brightness has too much color loss
+        if (len == 1) BusManager::setPixelColor(first, c); // no run (shuffled ledmap), skip the run buffer
+        else run[dir < 0 ? len - 1 - n : n] = c;
+      }
+      if (len > 1) BusManager::setPixels(dir < 0 ? first - (len - 1) : first, run, len);
+    });
+  Bus::setCCT(oldCCT);  // restore old CCT
 
   // some buses send asynchronously and this method will return before
   // all of the data has been sent.
@@ -1672,6 +1776,28 @@ void WS2812FX::setRealtimePixelColor(unsigned i, uint32_t c) {
   }
 }
 
+// bulk version of setRealtimePixelColor(): bounds and target buffer are resolved once for the whole run
+void WS2812FX::setRealtimePixels(unsigned i, const uint8_t *data, unsigned count, unsigned bytesPerPixel) {
+  uint32_t *dst = _pixels;
+  unsigned len = getLengthTotal();
+  if (useMainSegmentOnly) {
+    const Segment &seg = getMainSegment();
+    if (!seg.isActive()) return;
+    dst = seg.getPixels(); // marks segment as changed
+    len = seg.length();
+  } else {
+    _compositeValid = false;
+  }
+  if (!dst || i >= len) return;
+  count = std::min(count, len - i);
+  dst += i;
+  if (bytesPerPixel > 3) {
+    for (unsigned n = 0; n < count; n++, data += bytesPerPixel) dst[n] = RGBW32(data[0], data[1], data[2], data[3]);
+  } else {
+    for (unsigned n = 0; n < count; n++, data += 3) dst[n] = RGBW32(data[0], data[1], data[2], 0);
+  }
+}
+
 // reset all segments
 void WS2812FX::restartRuntime() {
   suspend();
@@ -0,0 +1,80 @@
+#pragma once
+#ifndef WLED_BLEND_MODES_H
+#define WLED_BLEND_MODES_H
+
+/*
+ * Segment blend modes: channel functions, RGBW32 kernels and the row loops used by WS2812FX::blendSegment()
+ * included after wled.h (RGBW32(), color_blend(), WLED_O2_ATTR); kept apart so the kernels can be tested on the host (test/test_blend_modes)
+ */
+
+// https://en.wikipedia.org/wiki/Blend_modes but using a for top layer & b for bottom layer
+#if defined(ESP8266) || defined(CONFIG_IDF_TARGET_ESP32C3)
+static uint8_t _multiply  (uint8_t a, uint8_t b) { return ((a * b) + 255) >> 8; } // faster than division on C3 but slightly less accurate
+#else
+static uint8_t _multiply  (uint8_t a, uint8_t b) { return (a * b) / 255; } // origianl uses a & b in range [0,1]
+#endif
+static uint8_t _divide    (uint8_t a, uint8_t b) { return a > b ? (b * 255) / a : 255; }
+static uint8_t _screen    (uint8_t a, uint8_t b) { return 255 - _multiply(~a,~b); } // 255 - (255-a)*(255-b)/255
+static uint8_t _overlay   (uint8_t a, uint8_t b) { return b < 128 ? 2 * _multiply(a,b) : (255 - 2 * _multiply(~a,~b)); }
+static uint8_t _hardlight (uint8_t a, uint8_t b) { return a < 128 ? 2 * _multiply(a,b) : (255 - 2 * _multiply(~a,~b)); }
+#if defined(ESP8266) || defined(CONFIG_IDF_TARGET_ESP32C3)
+static uint8_t _softlight (uint8_t a, uint8_t b) { return (((b * b * (255 - 2 * a))) + ((2 * a * b + 256) << 8)) >> 16; } // Pegtop's formula (1 - 2a)b^2
+#else
+static uint8_t _softlight (uint8_t a, uint8_t b) { return (b * b * (255 - 2 * a) + 255 * 2 * a * b) / (255 * 255); } // Pegtop's formula (1 - 2a)b^2 + 2ab
+#endif
+static uint8_t _dodge     (uint8_t a, uint8_t b) { return _divide(~a,b); }
+static uint8_t _burn      (uint8_t a, uint8_t b) { return ~_divide(a,~b); }
+
+// blend kernels working on whole RGBW32 pixels, one per blend mode
+// simple modes use byte-parallel math (poorman's SIMD, see color_blend()), the others apply the channel function above
+template<uint8_t (*FUNC)(uint8_t, uint8_t)>
+static uint32_t _channels(uint32_t a, uint32_t b) { return RGBW32(FUNC(R(a),R(b)), FUNC(G(a),G(b)), FUNC(B(a),B(b)), FUNC(W(a),W(b))); }
+static inline uint32_t _subtractRGBW(uint32_t a, uint32_t b) { // per channel b > a ? b - a : 0
+  const uint32_t d   = ((b | 0x80808080) - (a & 0x7F7F7F7F)) ^ ((b ^ ~a) & 0x80808080); // b - a per channel (modulo 256)
+  const uint32_t neg = ((~b & a) | (~(b ^ a) & d)) & 0x80808080;                           // channels where b < a
+  return d & ~((neg >> 7) * 0xFF);
+}
+static uint32_t _topRGBW       (uint32_t a, uint32_t b) { return a; }
+static uint32_t _bottomRGBW    (uint32_t a, uint32_t b) { return b; }
+static uint32_t _addRGBW       (uint32_t a, uint32_t b) { // per channel min(a + b, 255)
+  const uint32_t s = (a & 0x7F7F7F7F) + (b & 0x7F7F7F7F);
+  const uint32_t h = (a ^ b) & 0x80808080;
+  const uint32_t c = ((a & b) | (h & s)) & 0x80808080; // channels that overflow
+  return (s ^ h) | ((c >> 7) * 0xFF);
+}
+static uint32_t _differenceRGBW(uint32_t a, uint32_t b) { return _subtractRGBW(a,b) | _subtractRGBW(b,a); } // |a - b|
+static uint32_t _averageRGBW   (uint32_t a, uint32_t b) { return (a & b) + (((a ^ b) >> 1) & 0x7F7F7F7F); } // (a + b) / 2
+static uint32_t _lightenRGBW   (uint32_t a, uint32_t b) { return a + _subtractRGBW(a,b); } // max(a, b), channels do not overflow
+static uint32_t _darkenRGBW    (uint32_t a, uint32_t b) { return b - _subtractRGBW(a,b); } // min(a, b), channels do not underflow
+
+typedef uint32_t (*BlendFunc)(uint32_t, uint32_t);
+// indexed by Segment::blendMode
+static const BlendFunc blendFuncs[] = {
+  _topRGBW, _bottomRGBW,
+  _addRGBW, _subtractRGBW, _differenceRGBW, _averageRGBW,
+  _channels<_multiply>, _channels<_divide>, _lightenRGBW, _darkenRGBW, _channels<_screen>, _channels<_overlay>,
+  _channels<_hardlight>, _channels<_softlight>, _channels<_dodge>, _channels<_burn>
+};
+
+// blends a row of segment pixels (src, stepping by srcStep) onto the frame buffer (dst)
+// the kernel is a template argument so each mode gets its own loop without a call per pixel
+template<BlendFunc BLEND>
+static void WLED_O2_ATTR _blendRow(uint32_t *dst, const uint32_t *src, int srcStep, unsigned count, uint8_t opacity) {
+  if (opacity == 255) {
+    for (unsigned i = 0; i < count; i++, src += srcStep) dst[i] = BLEND(*src, dst[i]); // color_blend(x, y, 255) == y
+  } else {
+    for (unsigned i = 0; i < count; i++, src += srcStep) dst[i] = color_blend(dst[i], BLEND(*src, dst[i]), opacity);
+  }
+}
+
+typedef void (*BlendRowFunc)(uint32_t *, const uint32_t *, int, unsigned, uint8_t);
+// indexed by Segment::blendMode
+static const BlendRowFunc blendRowFuncs[] = {
+  _blendRow<_topRGBW>, _blendRow<_bottomRGBW>,
+  _blendRow<_addRGBW>, _blendRow<_subtractRGBW>, _blendRow<_differenceRGBW>, _blendRow<_averageRGBW>,
+  _blendRow<_channels<_multiply>>, _blendRow<_channels<_divide>>, _blendRow<_lightenRGBW>, _blendRow<_darkenRGBW>,
+  _blendRow<_channels<_screen>>, _blendRow<_channels<_overlay>>,
+  _blendRow<_channels<_hardlight>>, _blendRow<_channels<_softlight>>, _blendRow<_channels<_dodge>>, _blendRow<_channels<_burn>>
+};
+
+#endif
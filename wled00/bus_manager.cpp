@@ -15,6 +15,7 @@
 #endif
 #include "bus_manager.h"
 #include "bus_wrapper.h"
+#include "pixel_runs.h"
 #include "wled.h"
 
 // functions to get/set bits in an array - based on functions created by Brandon for GOL
@@ -112,6 +113,7 @@ BusDigital::BusDigital(const BusConfig &bc)
 , _milliAmpsPerLed(bc.milliAmpsPerLed)
 , _milliAmpsMax(bc.milliAmpsMax)
 , _driverType(bc.driverType) // Store driver preference (0=RMT, 1=I2S)
+, _ablBri(255)
 {
   DEBUGBUS_PRINTLN(F("Bus: Creating digital bus."));
   if (!isDigital(bc.type) || !bc.count) { DEBUGBUS_PRINTLN(F("Not digial or empty bus!")); return; }
@@ -121,6 +123,7 @@ BusDigital::BusDigital(const BusConfig &bc)
   if (!PinManager::allocatePin(bc.pins[0], true, PinOwner::BusDigital)) { DEBUGBUS_PRINTLN(F("Pin 0 allocated!")); return; }
   _frequencykHz = 0U;
   _colorSum = 0;
+  memset(_channelSum, 0, sizeof(_channelSum));
   _pins[0] = bc.pins[0];
   if (is2Pin(bc.type)) {
     if (!PinManager::allocatePin(bc.pins[1], true, PinOwner::BusDigital)) {
@@ -167,12 +170,15 @@ BusDigital::BusDigital(const BusConfig &bc)
 
 // note on ABL implementation:
 // ABL is set up in finalizeInit()
-// scaled color channels are summed in BusDigital::setPixelColor()
-// the used current is estimated and limited in BusManager::show()
+// color channels are summed in BusDigital::sumColor() in a pass over the frame before it is written, white balance
+// correction and brightness are applied to the channel sums in BusDigital::foldColorSum() instead of to each pixel
+// the used current is estimated and limited in BusManager::applyABL()
+// the limit is applied while the frame is written in BusDigital::setPixelColor(), the bus is never repainted
 // if limit is set too low, brightness is limited to 1 to at least show some light
 // to disable brightness limiter for a bus, set LED current to 0
 
 void BusDigital::estimateCurrent() {
+  foldColorSum();
   uint32_t actualMilliampsPerLed = _milliAmpsPerLed;
   if (_milliAmpsPerLed == 255) {
     // use wacky WS2815 power model, see WLED issue #549
@@ -184,11 +190,47 @@ void BusDigital::estimateCurrent() {
   _milliAmpsTotal = ((uint64_t)_colorSum * actualMilliampsPerLed) / clrUnitsPerChannel + getLength(); // add 1mA standby current per LED to total (WS2812: ~0.7mA, WS2815: ~2mA)
 }
 
+inline uint32_t BusDigital::scaleColor(uint32_t c) const {
+  if (hasWhite()) c = autoWhiteCalc(c);
+  if (Bus::_cct >= 1900) c = colorBalanceFromKelvin(Bus::_cct, c); //color correction from CCT
+  return color_fade(c, _bri, true); // apply brightness
+}
+
+void IRAM_ATTR BusDigital::sumColor(uint32_t c) {
+  if (!_valid || _milliAmpsPerLed == 0) return;
+  if (hasWhite()) c = autoWhiteCalc(c);
+  if (_milliAmpsPerLed < 255) { // normal ABL
+    _channelSum[0] += R(c);
+    _channelSum[1] += G(c);
+    _channelSum[2] += B(c);
+    _channelSum[3] += W(c);
+  } else { // wacky WS2815 power model, ignore white channel, use max of RGB (issue #549)
+    if (Bus::_cct >= 1900) c = colorBalanceFromKelvin(Bus::_cct, c); // max of RGB does not commute with the correction
+    uint8_t r = R(c), g = G(c), b = B(c);
+    _channelSum[0] += ((r > g) ? ((r > b) ? r : b) : ((g > b) ? g : b));
+  }
+}
+
+// scaling the sums equals scaling each pixel (up to rounding), as colorBalanceFromKelvin() and color_fade() in
+// scaleColor() multiply each channel by a constant factor
+void BusDigital::foldColorSum() {
+  uint64_t r = _channelSum[0], g = _channelSum[1], b = _channelSum[2];
+  if (_milliAmpsPerLed < 255 && Bus::_cct >= 1900) {
+    const uint32_t k = colorBalanceFromKelvin(Bus::_cct, RGBW32(255, 255, 255, 0)); // correction factor per channel
+    r = r * R(k) / 255;
+    g = g * G(k) / 255;
+    b = b * B(k) / 255;
+  }
+  _colorSum += (r + g + b + _channelSum[3]) * _bri / 255;
+  memset(_channelSum, 0, sizeof(_channelSum));
+}
+
 void BusDigital::applyBriLimit(uint8_t newBri) {
   // a newBri of 0 means calculate per-bus brightness limit
   _NPBbri = 255; // reset, intermediate value is set below, final value is calculated in bus::show()
+  _ablBri = 255;
   if (newBri == 0) {
-    if (_milliAmpsLimit == 0 || _milliAmpsTotal == 0) return; // ABL not used for this bus
+    if (_milliAmpsLimit == 0 || _milliAmpsTotal == 0) { _colorSum = 0; memset(_channelSum, 0, sizeof(_channelSum)); return; } // ABL not used for this bus
     newBri = 255;
 
     if (_milliAmpsLimit > getLength()) { // each LED uses about 1mA in standby
@@ -205,19 +247,11 @@ void BusDigital::applyBriLimit(uint8_t newBri) {
 
   if (newBri < 255) {
     _NPBbri = newBri; // store value so it can be updated in show() (must be updated even if ABL is not used)
-    uint8_t cctWW = 0, cctCW = 0;
-    unsigned hwLen = _len;
-    if (_type == TYPE_WS2812_1CH_X3) hwLen = NUM_ICS_WS2812_1CH_3X(_len); // only needs a third of "RGB" LEDs for NeoPixelBus
-    for (unsigned i = 0; i < hwLen; i++) {
-      uint8_t co = _colorOrderMap.getPixelColorOrder(i+_start, _colorOrder); // need to revert color order for correct color scaling and CCT calc in case white is swapped
-      uint32_t c = PolyBus::getPixelColor(_busPtr, _iType, i, co);
-      c = color_fade(c, newBri, true); // apply additional dimming  note: using inline version is a bit faster but overhead of getPixelColor() dominates the speed impact by far
-      if (hasCCT()) Bus::calculateCCT(c, cctWW, cctCW);
-      PolyBus::setPixelColor(_busPtr, _iType, i, c, co, (cctCW<<8) | cctWW); // repaint all pixels with new brightness
-    }
+    _ablBri = newBri; // applied by setPixelColor() when the frame is written
   }
 
   _colorSum = 0; // reset for next frame
+  memset(_channelSum, 0, sizeof(_channelSum));
 }
 
 void BusDigital::show() {
@@ -242,19 +276,8 @@ void BusDigital::setStatusPixel(uint32_t c) {
 
 void IRAM_ATTR BusDigital::setPixelColor(unsigned pix, uint32_t c) {
   if (!_valid) return;
-  if (hasWhite()) c = autoWhiteCalc(c);
-  if (Bus::_cct >= 1900) c = colorBalanceFromKelvin(Bus::_cct, c); //color correction from CCT
-  c = color_fade(c, _bri, true); // apply brightness
-
-  if (BusManager::_useABL) {
-    // if using ABL, sum all color channels to estimate current and limit brightness in show()
-    uint8_t r = R(c), g = G(c), b = B(c);
-    if (_milliAmpsPerLed < 255) { // normal ABL
-      _colorSum += r + g + b + W(c);
-    } else { // wacky WS2815 power model, ignore white channel, use max of RGB (issue #549)
-      _colorSum += ((r > g) ? ((r > b) ? r : b) : ((g > b) ? g : b));
-    }
-  }
+  c = scaleColor(c);
+  if (_ablBri < 255) c = color_fade(c, _ablBri, true); // brightness limit from ABL
 
   if (_reversed) pix = _len - pix -1;
   pix += _skip;
@@ -279,6 +302,11 @@ void IRAM_ATTR BusDigital::setPixelColor(unsigned pix, uint32_t c) {
   PolyBus::setPixelColor(_busPtr, _iType, pix, c, co, wwcw);
 }
 
+void IRAM_ATTR BusDigital::setPixels(unsigned pix, const uint32_t *c, unsigned count) {
+  if (!_valid) return;
+  for (unsigned i = 0; i < count; i++) BusDigital::setPixelColor(pix + i, c[i]); // qualified call, no virtual dispatch
+}
+
 // returns lossly restored color from bus
 uint32_t IRAM_ATTR BusDigital::getPixelColor(unsigned pix) const {
   if (!_valid) return 0;
@@ -690,6 +718,11 @@ void BusNetwork::setPixelColor(unsigned pix, uint32_t c) {
   if (_hasWhite) _data[offset+3] = W(c);
 }
 
+void BusNetwork::setPixels(unsigned pix, const uint32_t *c, unsigned count) {
+  if (!_valid) return;
+  for (unsigned i = 0; i < count; i++) BusNetwork::setPixelColor(pix + i, c[i]);
+}
+
 uint32_t BusNetwork::getPixelColor(unsigned pix) const {
   if (!_valid || pix >= _len) return 0;
   unsigned offset = pix * _UDPchannels;
@@ -1024,6 +1057,11 @@ void IRAM_ATTR BusHub75Matrix::setPixelColor(unsigned pix, uint32_t c) {
   }
 }
 
+void IRAM_ATTR BusHub75Matrix::setPixels(unsigned pix, const uint32_t *c, unsigned count) {
+  if (!_valid) return;
+  for (unsigned i = 0; i < count; i++) BusHub75Matrix::setPixelColor(pix + i, c[i]);
+}
+
 uint32_t BusHub75Matrix::getPixelColor(unsigned pix) const {
   if (!_valid) return IS_BLACK; // note: no need to check pix >= _len as that is checked in containsPixel()
   if (_ledBuffer)
@@ -1287,7 +1325,6 @@ void BusManager::off() {
 }
 
 void BusManager::show() {
-  applyABL(); // apply brightness limit, updates _gMilliAmpsUsed
   for (auto &bus : busses) {
     bus->show();
   }
@@ -1300,6 +1337,22 @@ void IRAM_ATTR BusManager::setPixelColor(unsigned pix, uint32_t c) {
   }
 }
 
+void IRAM_ATTR BusManager::setPixels(unsigned pix, const uint32_t *c, unsigned count) {
+  setPixelsOnBusses(busses, pix, c, count);
+}
+
+// a pixel shown by several (overlapping) buses counts towards the current of each of them, like setPixelColor() writes it to each
+void IRAM_ATTR BusManager::sumPixel(unsigned pix, uint32_t c) {
+  for (auto &bus : busses) {
+    if (!bus->isDigital() || !bus->containsPixel(pix)) continue;
+    static_cast<BusDigital&>(*bus).sumColor(c); // skips buses without LED current
+  }
+}
+
+void BusManager::foldColorSums() {
+  for (auto &bus : busses) if (bus->isDigital() && bus->isOk()) static_cast<BusDigital&>(*bus).foldColorSum();
+}
+
 void BusManager::setSegmentCCT(int16_t cct, bool allowWBCorrection) {
   if (cct > 255) cct = 255;
   if (cct >= 0) {
@@ -1324,6 +1377,7 @@ bool BusManager::canAllShow() {
 
 void BusManager::initializeABL() {
   _useABL = false; // reset
+  for (auto &bus : busses) if (bus->isDigital() && bus->isOk()) static_cast<BusDigital&>(*bus).applyBriLimit(255); // clear limit of a previous setup
   if (_gMilliAmpsMax > 0) {
     // check global brightness limit
     for (auto &bus : busses) {
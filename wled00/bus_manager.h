@@ -129,6 +129,8 @@ class Bus {
     virtual bool     canShow() const                            { return true; }
     virtual void     setStatusPixel(uint32_t c)                 {}
     virtual void     setPixelColor(unsigned pix, uint32_t c)    = 0;
+    // count consecutive pixels starting at pix, buses override this to set them without a virtual call per pixel
+    virtual void     setPixels(unsigned pix, const uint32_t *c, unsigned count) { for (unsigned i = 0; i < count; i++) setPixelColor(pix + i, c[i]); }
     virtual void     setBrightness(uint8_t b)                   { _bri = b; };
     virtual void     setColorOrder(uint8_t co)                  {}
     virtual uint32_t getPixelColor(unsigned pix) const          { return 0; }
@@ -251,6 +253,7 @@ class BusDigital : public Bus {
     bool canShow() const override;
     void setStatusPixel(uint32_t c) override;
     [[gnu::hot]] void setPixelColor(unsigned pix, uint32_t c) override;
+    [[gnu::hot]] void setPixels(unsigned pix, const uint32_t *c, unsigned count) override;
     void setColorOrder(uint8_t colorOrder) override;
     [[gnu::hot]] uint32_t getPixelColor(unsigned pix) const override;
     uint8_t  getColorOrder() const override  { return _colorOrder; }
@@ -262,6 +265,8 @@ class BusDigital : public Bus {
     uint16_t getMaxCurrent() const override  { return _milliAmpsMax; }
     uint8_t  getDriverType() const override  { return _driverType; }
     void     setCurrentLimit(uint16_t milliAmps) { _milliAmpsLimit = milliAmps; }
+    [[gnu::hot]] void sumColor(uint32_t c); // add a pixel to the current estimate before the frame is written
+    void     foldColorSum();    // add the channel sums, white balanced and dimmed as they would be written, to _colorSum
     void     estimateCurrent(); // estimate used current from summed colors
     void     applyBriLimit(uint8_t newBri);
     size_t   getBusSize() const override;
@@ -281,11 +286,15 @@ class BusDigital : public Bus {
     uint16_t _milliAmpsMax;
     uint8_t  _milliAmpsPerLed;
     uint16_t _milliAmpsLimit;
-    uint32_t _colorSum; // total color value for the bus, updated in setPixelColor(), used to estimate current
+    uint8_t  _ablBri;   // ABL brightness limit, applied in setPixelColor() on top of _bri
+    uint32_t _colorSum; // total color value for the bus, updated in foldColorSum(), used to estimate current
+    uint32_t _channelSum[4]; // R, G, B, W summed by sumColor() since the last foldColorSum()
     void    *_busPtr;
 
     static uint16_t _milliAmpsTotal; // is overwitten/recalculated on each show()
 
+    inline uint32_t scaleColor(uint32_t c) const; // color as it is written to the bus, before the ABL limit
+
     inline uint32_t restoreColorLossy(uint32_t c, uint8_t restoreBri) const {
       if (restoreBri < 255) {
         uint8_t* chan = (uint8_t*) &c;
@@ -354,6 +363,7 @@ class BusNetwork : public Bus {
 
     bool canShow() const override  { return !_broadcastLock; } // this should be a return value from UDP routine if it is still sending data out
     [[gnu::hot]] void setPixelColor(unsigned pix, uint32_t c) override;
+    [[gnu::hot]] void setPixels(unsigned pix, const uint32_t *c, unsigned count) override;
     [[gnu::hot]] uint32_t getPixelColor(unsigned pix) const override;
     size_t getPins(uint8_t* pinArray = nullptr) const override;
     size_t getBusSize() const override  { return sizeof(BusNetwork) + (isOk() ? _len * _UDPchannels : 0); }
@@ -386,6 +396,7 @@ class BusPlaceholder : public Bus {
 
     // Actual calls are stubbed out
     void setPixelColor(unsigned pix, uint32_t c) override {};
+    void setPixels(unsigned pix, const uint32_t *c, unsigned count) override {};
     void show() override {};
 
     // Accessors
@@ -417,6 +428,7 @@ class BusHub75Matrix : public Bus {
   public:
     BusHub75Matrix(const BusConfig &bc);
     [[gnu::hot]] void setPixelColor(unsigned pix, uint32_t c) override;
+    [[gnu::hot]] void setPixels(unsigned pix, const uint32_t *c, unsigned count) override;
     [[gnu::hot]] uint32_t getPixelColor(unsigned pix) const override;
     void show() override;
     void setBrightness(uint8_t b) override;
@@ -544,7 +556,8 @@ namespace BusManager {
   inline uint16_t ablMilliampsMax()             { return _gMilliAmpsMax; }  // used for compatibility reasons (and enabling virtual global ABL)
   inline void     setMilliampsMax(uint16_t max) { _gMilliAmpsMax = max;}
   void            initializeABL();              // setup automatic brightness limiter parameters, call once after buses are initialized
-  void            applyABL();                   // apply automatic brightness limiter, global or per bus
+  void            applyABL();                   // apply automatic brightness limiter, global or per bus, call after sumPixel() and before setPixels()
+  inline bool     usesABL()                     { return _useABL; }
 
   uint8_t getI(uint8_t busType, const uint8_t* pins, uint8_t driverPreference); // workaround for access to PolyBus function from FX_fcn.cpp
 
@@ -556,6 +569,11 @@ namespace BusManager {
   void off();
 
   [[gnu::hot]] void     setPixelColor(unsigned pix, uint32_t c);
+  // count consecutive pixels starting at pix, each bus gets the part it covers in one call
+  [[gnu::hot]] void     setPixels(unsigned pix, const uint32_t *c, unsigned count);
+  // add one (gamma corrected) pixel to the current estimate of its bus for applyABL(), pixels may come in any order
+  [[gnu::hot]] void     sumPixel(unsigned pix, uint32_t c);
+  void                  foldColorSums(); // call before the CCT changes while pixels are summed
   [[gnu::hot]] uint32_t getPixelColor(unsigned pix);
   void        show();
   bool        canAllShow();
@@ -0,0 +1,44 @@
+#pragma once
+#ifndef WLED_PIXEL_RUNS_H
+#define WLED_PIXEL_RUNS_H
+
+/*
+ * Runs of frame pixels handed to the buses by WS2812FX::show() and BusManager::setPixels()
+ * no WLED dependencies, so show() can be benchmarked on the host (test/test_bus_show)
+ */
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+// splits logical pixels 0..total-1 into runs that are consecutive after mapping (ascending, or descending as in
+// serpentine rows) and at most maxRun long; split(i) starts a new run at pixel i (e.g. a CCT change)
+// emit(i, first, len, dir) gets pixels i..i+len-1, which map to first, first+dir, ... (dir 0 for a single pixel)
+template<typename Map, typename Split, typename Emit>
+inline void forEachPixelRun(size_t total, unsigned maxRun, Map map, Split split, Emit emit) {
+  for (size_t i = 0; i < total; ) {
+    const unsigned first = map(i);
+    // most pixels of a shuffled ledmap start no run, they skip the run loop
+    const int dir = maxRun > 1 && i + 1 < total && !split(i + 1) ? (int)map(i + 1) - (int)first : 0; // +1 ascending, -1 descending run
+    if (dir != 1 && dir != -1) { emit(i, first, 1u, 0); i++; continue; }
+    unsigned len = 2;
+    for (unsigned prev = first + dir; len < maxRun && i + len < total; len++, prev += dir) {
+      if (split(i + len) || (int)map(i + len) - (int)prev != dir) break;
+    }
+    emit(i, first, len, dir);
+    i += len;
+  }
+}
+
+// count consecutive pixels starting at pix, each bus (pointer to Bus) gets the part it covers in one setPixels() call
+template<typename Busses>
+inline void setPixelsOnBusses(Busses &busses, unsigned pix, const uint32_t *c, unsigned count) {
+  const unsigned end = pix + count;
+  for (auto &bus : busses) {
+    const unsigned busStart = bus->getStart();
+    const unsigned from = std::max(pix, busStart);
+    const unsigned to   = std::min(end, busStart + bus->getLength());
+    if (from < to) bus->setPixels(from - busStart, c + (from - pix), to - from);
+  }
+}
+
+#endif
@@ -224,6 +224,10 @@ class ESPAsyncE131 {
  public:
     ESPAsyncE131(e131_packet_callback_function callback);
 
+    // Replace the packet callback, e.g. to let a usermod take over a port
+    void setCallback(e131_packet_callback_function callback) { _callback = callback; }
+    e131_packet_callback_function getCallback() const { return _callback; }
+
     // Generic UDP listener, no physical or IP configuration
     bool begin(bool multicast, uint16_t port = E131_DEFAULT_PORT, uint16_t universe = 1, uint8_t n = 1);
 };
@@ -669,6 +669,20 @@ void setRealtimePixel(uint16_t i, byte r, byte g, byte b, byte w)
   strip.setRealtimePixelColor(pix, RGBW32(r,g,b,w));
 }
 
+// bulk variant of setRealtimePixel() for contiguous RGB or RGBW data
+void setRealtimePixels(uint16_t i, const byte* data, unsigned count, unsigned bytesPerPixel)
+{
+  int pix = i + arlsOffset;
+  if (pix < 0) { // skip pixels shifted before the start of the strip
+    unsigned skip = -pix;
+    if (count <= skip) return;
+    data  += skip * bytesPerPixel;
+    count -= skip;
+    pix = 0;
+  }
+  strip.setRealtimePixels(pix, data, count, bytesPerPixel);
+}
+
 /*********************************************************************************************\
    Refresh aging for remote units, drop if too old...
 \*********************************************************************************************/